@@ -3,25 +3,41 @@ INCLUDEPATH += $$PWD
 
 LIBS += -lutil
 
-CONFIG += c++11
+CONFIG += c++14
 
 MOC_DIR = .moc
 OBJECTS_DIR = .obj
 
 HEADERS += \
            $$PWD/yat_pty.h \
+           $$PWD/ring_buffer.h \
            $$PWD/text.h \
            $$PWD/controll_chars.h \
            $$PWD/parser.h \
+           $$PWD/command_buffer.h \
+           $$PWD/csi_parameters.h \
            $$PWD/screen.h \
            $$PWD/block.h \
            $$PWD/color_palette.h \
            $$PWD/text_style.h \
            $$PWD/screen_data.h \
+           $$PWD/block_ring.h \
+           $$PWD/block_pool.h \
+           $$PWD/cell_grid.h \
            $$PWD/cursor.h \
            $$PWD/nrc_text_codec.h \
            $$PWD/scrollback.h \
+           $$PWD/frozen_lines.h \
+           $$PWD/chunk_codec.h \
+           $$PWD/spill_file.h \
+           $$PWD/memory_governor.h \
+           $$PWD/trigram_index.h \
+           $$PWD/search.h \
+           $$PWD/line_index.h \
+           $$PWD/style_table.h \
            $$PWD/utf8_decoder.h \
+           $$PWD/utf8_transcoder.h \
+           $$PWD/text_scanner.h \
            $$PWD/selection.h
 
 SOURCES += \
@@ -31,11 +47,21 @@ SOURCES += \
            $$PWD/parser.cpp \
            $$PWD/screen.cpp \
            $$PWD/block.cpp \
+           $$PWD/cell_grid.cpp \
+           $$PWD/block_pool.cpp \
+           $$PWD/style_table.cpp \
            $$PWD/color_palette.cpp \
            $$PWD/text_style.cpp \
            $$PWD/screen_data.cpp \
            $$PWD/cursor.cpp \
            $$PWD/nrc_text_codec.cpp \
            $$PWD/scrollback.cpp \
+           $$PWD/frozen_lines.cpp \
+           $$PWD/chunk_codec.cpp \
+           $$PWD/spill_file.cpp \
+           $$PWD/memory_governor.cpp \
+           $$PWD/trigram_index.cpp \
+           $$PWD/search.cpp \
+           $$PWD/utf8_decoder.cpp \
            $$PWD/selection.cpp
 
@@ -25,10 +25,12 @@
 
 #include "text.h"
 #include "screen.h"
+#include "block_pool.h"
 
 #include <QtQuick/QQuickView>
 #include <QtQuick/QQuickItem>
 
+#include <QtCore/QBitArray>
 #include <QtCore/QDebug>
 
 #include <algorithm>
@@ -38,6 +40,7 @@ Block::Block(Screen *screen)
     , m_line(0)
     , m_new_line(-1)
     , m_screen_index(0)
+    , m_style_hint(0)
     , m_width(m_screen->width())
     , m_visible(true)
     , m_changed(true)
@@ -58,28 +61,48 @@ Screen *Block::screen() const
     return m_screen;
 }
 
+// Brings a block coming from the BlockPool back to the state of a new one
+void Block::reset()
+{
+    m_line = 0;
+    m_new_line = -1;
+    m_screen_index = 0;
+    m_width = m_screen->width();
+    m_visible = true;
+    clear();
+}
+
 void Block::clear()
 {
-    m_text_line.clear();
+    // resize keeps the capacity for the next line written to the block
+    m_text_line.resize(0);
 
     for (int i = 0; i < m_style_list.size(); i++) {
         m_style_list[i].releaseTextSegment(m_screen);
     }
 
-    m_style_list.clear();
+    m_style_list.resize(0);
+    m_style_hint = 0;
 
     m_only_latin = true;
     m_changed = true;
 }
 
+// Gives back the capacity beyond what the block holds now
+void Block::squeeze()
+{
+    m_text_line.squeeze();
+    m_style_list.squeeze();
+}
+
 void Block::clearToEnd(int from)
 {
-    clearCharacters(from, m_text_line.size() - 1);
+    clearCharacters(from, textSize() - 1);
 }
 
 void Block::clearCharacters(int from, int to)
 {
-    if (from > m_text_line.size())
+    if (from > textSize())
         return;
 
     QString empty(to+1-from, QChar(' '));
@@ -95,9 +118,9 @@ void Block::deleteCharacters(int from, int to)
     const int size = (to + 1) - from;
     bool found = false;
 
-    int last_index = -1;
+    int last_index = m_style_list.size() - 1;
 
-    for (int i = 0; i < m_style_list.size(); i++) {
+    for (int i = style_index_at(from); i < m_style_list.size(); i++) {
         TextStyleLine &current_style = m_style_list[i];
         last_index = i;
         if (found) {
@@ -133,6 +156,8 @@ void Block::deleteCharacters(int from, int to)
         }
     }
 
+    // The last run might have been removed by the loop
+    last_index = std::min(last_index, m_style_list.size() - 1);
     if (last_index >= 0) {
         TextStyleLine &last_modified = m_style_list[last_index];
         TextStyle defaultStyle = m_screen->defaultTextStyle();
@@ -150,7 +175,7 @@ void Block::deleteCharacters(int from, int to)
 
 void Block::deleteToEnd(int from)
 {
-    deleteCharacters(from, m_text_line.size() - 1);
+    deleteCharacters(from, textSize() - 1);
 }
 
 void Block::deleteLines(int from)
@@ -171,89 +196,105 @@ void Block::replaceAtPos(int pos, const QString &text, const TextStyle &style, b
             m_text_line.append(filling);
             m_style_list.append(TextStyleLine(m_screen->defaultTextStyle(), old_size, old_size + filling.size() -1));
         }
-        m_text_line.append(text);
+        // Copy the characters, text might be a buffer that is reused by the caller
+        m_text_line.append(text.constData(), text.size());
         m_style_list.append(TextStyleLine(style, pos, pos + text.size()-1));
+        m_style_hint = m_style_list.size() - 1;
         return;
     } else if (pos + text.size() > m_text_line.size()) {
         m_style_list.append(TextStyleLine(m_screen->defaultTextStyle(), pos + text.size() - m_text_line.size(), pos + text.size() -1));
     }
 
     m_text_line.replace(pos,text.size(),text);
-    bool found = false;
-    for (int i = 0; i < m_style_list.size(); i++) {
-        TextStyleLine &current_style = m_style_list[i];
-        if (found) {
-            if (current_style.end_index <= pos + text.size() - 1) {
-                current_style.releaseTextSegment(m_screen);
-                m_style_list.remove(i);
-                i--;
-            } else if (current_style.start_index <= pos + text.size()) {
-                current_style.start_index = pos + text.size();
+
+    const int last = pos + text.size() - 1;
+    int i = style_index_at(pos);
+    if (i >= m_style_list.size() || m_style_list.at(i).start_index > pos)
+        return;
+
+    TextStyleLine &current_style = m_style_list[i];
+    if (last <= current_style.end_index) {
+        if (current_style.isCompatible(style)) {
+            current_style.text_dirty = true;
+        } else {
+            if (current_style.start_index == pos && current_style.end_index == last) {
+                current_style.setStyle(style);
+                current_style.text_dirty = true;
                 current_style.style_dirty = true;
+            } else if (current_style.start_index == pos) {
+                current_style.start_index = pos + text.size();
                 current_style.text_dirty = true;
-                current_style.index_dirty = true;
+                m_style_list.insert(i, TextStyleLine(style,pos, last));
+            } else if (current_style.end_index == last) {
+                current_style.end_index = pos - 1;
+                current_style.text_dirty = true;
+                m_style_list.insert(i+1, TextStyleLine(style,pos, last));
+                i++;
             } else {
-                break;
-            }
-        } else if (pos >= current_style.start_index && pos <= current_style.end_index) {
-            found = true;
-            if (pos + text.size() -1 <= current_style.end_index) {
-                if (current_style.isCompatible(style)) {
-                    current_style.text_dirty = true;
-                } else {
-                    if (current_style.start_index == pos && current_style.end_index == pos + text.size() - 1) {
-                        current_style.setStyle(style);
-                        current_style.text_dirty = true;
-                        current_style.style_dirty = true;
-                    } else if (current_style.start_index == pos) {
-                        current_style.start_index = pos + text.size();
-                        current_style.text_dirty = true;
-                        m_style_list.insert(i, TextStyleLine(style,pos, pos+text.size() -1));
-                    } else if (current_style.end_index == pos + text.size() - 1) {
-                        current_style.end_index = pos - 1;
-                        current_style.text_dirty = true;
-                        m_style_list.insert(i+1, TextStyleLine(style,pos, pos + text.size() - 1));
-                    } else {
-                        int old_end = current_style.end_index;
-                        current_style.end_index = pos - 1;
-                        current_style.text_dirty = true;
-                        m_style_list.insert(i+1, TextStyleLine(style,pos, pos + text.size() - 1));
-                        if (pos + text.size() < m_text_line.size()) {
-                            m_style_list.insert(i+2, TextStyleLine(current_style,pos + text.size(), old_end));
-                        }
-                    }
+                int old_end = current_style.end_index;
+                current_style.end_index = pos - 1;
+                current_style.text_dirty = true;
+                m_style_list.insert(i+1, TextStyleLine(style,pos, last));
+                if (pos + text.size() < m_text_line.size()) {
+                    m_style_list.insert(i+2, TextStyleLine(m_style_list.at(i),pos + text.size(), old_end));
                 }
-                break;
+                i++;
+            }
+        }
+        m_style_hint = i;
+        return;
+    }
+
+    if (current_style.isCompatible(style)) {
+        current_style.end_index = last;
+        current_style.text_dirty = true;
+    } else {
+        if (current_style.start_index == pos) {
+            if (i > 0 && m_style_list.at(i-1).isCompatible(style)) {
+                TextStyleLine &previous_style = m_style_list[i -1];
+                previous_style.end_index+= text.size();
+                previous_style.text_dirty = true;
+                current_style.releaseTextSegment(m_screen);
+                m_style_list.remove(i);
+                i--;
             } else {
-                if (current_style.isCompatible(style)) {
-                    current_style.end_index = pos + text.size() - 1;
-                    current_style.text_dirty = true;
-                } else {
-                    if (current_style.start_index == pos) {
-                        if (i > 0 && m_style_list.at(i-1).isCompatible(style)) {
-                            TextStyleLine &previous_style = m_style_list[i -1];
-                            previous_style.end_index+= text.size();
-                            previous_style.text_dirty = true;
-                            current_style.releaseTextSegment(m_screen);
-                            m_style_list.remove(i);
-                            i--;
-                        } else {
-                            current_style.end_index = pos + text.size() - 1;
-                            current_style.style = style.style;
-                            current_style.foreground = style.foreground;
-                            current_style.background = style.background;
-                            current_style.text_dirty = true;
-                            current_style.style_dirty = true;
-                            current_style.index_dirty = true;
-                        }
-                    } else {
-                        current_style.end_index = pos - 1;
-                        current_style.text_dirty = true;
-                        m_style_list.insert(i+1, TextStyleLine(style, pos, pos + text.size() -1));
-                        i++;
-                    }
-                }
+                current_style.end_index = last;
+                current_style.setStyle(style);
+                current_style.text_dirty = true;
+                current_style.style_dirty = true;
+                current_style.index_dirty = true;
             }
+        } else {
+            current_style.end_index = pos - 1;
+            current_style.text_dirty = true;
+            m_style_list.insert(i+1, TextStyleLine(style, pos, last));
+            i++;
+        }
+    }
+    m_style_hint = i;
+
+    // Drop the runs that are completely overwritten in one go, and trim the
+    // one that is partly overwritten
+    int covered_end = i + 1;
+    while (covered_end < m_style_list.size() && m_style_list.at(covered_end).end_index <= last) {
+        m_style_list[covered_end].releaseTextSegment(m_screen);
+        covered_end++;
+    }
+    m_style_list.remove(i + 1, covered_end - (i + 1));
+
+    for (i = i + 1; i < m_style_list.size(); i++) {
+        TextStyleLine &next_style = m_style_list[i];
+        if (next_style.end_index <= last) {
+            next_style.releaseTextSegment(m_screen);
+            m_style_list.remove(i);
+            i--;
+        } else if (next_style.start_index <= pos + text.size()) {
+            next_style.start_index = pos + text.size();
+            next_style.style_dirty = true;
+            next_style.text_dirty = true;
+            next_style.index_dirty = true;
+        } else {
+            break;
         }
     }
 }
@@ -266,7 +307,7 @@ void Block::insertAtPos(int pos, const QString &text, const TextStyle &style, bo
     m_text_line.insert(pos,text);
     bool found = false;
 
-    for (int i = 0; i < m_style_list.size(); i++) {
+    for (int i = style_index_at(pos); i < m_style_list.size(); i++) {
         TextStyleLine &current_style = m_style_list[i];
         if (found) {
             current_style.start_index += text.size();
@@ -299,7 +340,7 @@ void Block::insertAtPos(int pos, const QString &text, const TextStyle &style, bo
                 m_style_list.insert(i+1, TextStyleLine(style, pos, pos + text.size() - 1));
                 if (pos + text.size() < m_text_line.size()) {
                     int segment_end = std::min(m_text_line.size() -1, old_end + text.size());
-                    m_style_list.insert(i+2, TextStyleLine(current_style, pos + text.size(), segment_end));
+                    m_style_list.insert(i+2, TextStyleLine(m_style_list.at(i), pos + text.size(), segment_end));
                     i+=2;
                 } else {
                     i++;
@@ -309,16 +350,57 @@ void Block::insertAtPos(int pos, const QString &text, const TextStyle &style, bo
     }
 }
 
+// Replaces the text and the style runs of a single line block while keeping
+// the text segments of the runs that are already there
+void Block::setContent(const QString &text, const QVector<TextStyleLine> &styles, bool only_latin,
+                       int changed_start, int changed_end)
+{
+    m_changed = true;
+    m_only_latin = only_latin;
+    m_text_line.resize(text.size());
+    std::copy(text.constData(), text.constData() + text.size(), m_text_line.data());
+
+    const int reused = std::min(m_style_list.size(), styles.size());
+    for (int i = 0; i < reused; i++) {
+        TextStyleLine &current_style = m_style_list[i];
+        const TextStyleLine &new_style = styles.at(i);
+        if (!current_style.isCompatible(new_style)) {
+            current_style.setStyle(new_style);
+            current_style.style_dirty = true;
+        }
+        if (current_style.start_index != new_style.start_index
+                || current_style.end_index != new_style.end_index) {
+            current_style.start_index = new_style.start_index;
+            current_style.end_index = new_style.end_index;
+            current_style.index_dirty = true;
+        }
+        if (current_style.start_index <= changed_end && current_style.end_index >= changed_start)
+            current_style.text_dirty = true;
+    }
+    for (int i = reused; i < m_style_list.size(); i++) {
+        m_style_list[i].releaseTextSegment(m_screen);
+    }
+    m_style_list.resize(reused);
+    for (int i = reused; i < styles.size(); i++) {
+        m_style_list.append(TextStyleLine(styles.at(i), styles.at(i).start_index, styles.at(i).end_index));
+    }
+}
+
 const QString &Block::textLine() const
 {
     return m_text_line;
 }
 
+QString Block::textMid(int position, int n) const
+{
+    return m_text_line.mid(position, n);
+}
+
 void Block::setWidth(int width)
 {
     m_width = width;
 
-    if (width > m_text_line.size())
+    if (width > textSize())
         return;
 
     releaseTextObjects();
@@ -347,7 +429,7 @@ Block *Block::split(int line)
     if (line >= lineCount())
         return nullptr;
     m_changed = true;
-    Block *to_return = new Block(m_screen);
+    Block *to_return = m_screen->blockPool()->acquire();
     int start_index = line * m_width;
     for (int i = 0; i < m_style_list.size(); i++) {
         ensureStyleAlignWithLines(i);
@@ -375,7 +457,7 @@ Block *Block::takeLine(int line)
     if (line >= lineCount())
         return nullptr;
     m_changed = true;
-    Block *to_return = new Block(m_screen);
+    Block *to_return = m_screen->blockPool()->acquire();
     int start_index = line * m_width;
     int end_index = start_index + (m_width - 1);
     for (int i = 0; i < m_style_list.size(); i++) {
@@ -478,7 +560,7 @@ void Block::dispatchEvents()
          }
 
         if (current_style.style_dirty) {
-            current_style.text_segment->setTextStyle(current_style);
+            current_style.text_segment->setTextStyle(m_screen->styleTable()->style(current_style.style_id));
             current_style.style_dirty = false;
         }
 
@@ -513,6 +595,12 @@ QVector<TextStyleLine> Block::style_list()
     return m_style_list;
 }
 
+void Block::markStyles(QBitArray *live) const
+{
+    for (const TextStyleLine &style : m_style_list)
+        live->setBit(style.style_id);
+}
+
 void Block::printStyleList() const
 {
     QDebug debug = qDebug();
@@ -521,8 +609,8 @@ void Block::printStyleList() const
 
 void Block::printStyleList(QDebug &debug) const
 {
-    QString text_line = m_text_line;
-    debug << "  " << m_line << lineCount() << m_text_line.size() << (void *) this << text_line << "\n"; debug << "\t";
+    QString text_line = textMid(0);
+    debug << "  " << m_line << lineCount() << textSize() << (void *) this << text_line << "\n"; debug << "\t";
     for (int i= 0; i < m_style_list.size(); i++) {
         debug << m_style_list.at(i);
     }
@@ -530,11 +618,10 @@ void Block::printStyleList(QDebug &debug) const
 
 void Block::printStyleListWidthText() const
 {
-    QString text_line = m_text_line;
     for (int i= 0; i < m_style_list.size(); i++) {
         const TextStyleLine &currentStyle = m_style_list.at(i);
         QDebug debug = qDebug();
-        debug << m_text_line.mid(currentStyle.start_index, (currentStyle.end_index + 1) - currentStyle.start_index) << currentStyle;
+        debug << textMid(currentStyle.start_index, (currentStyle.end_index + 1) - currentStyle.start_index) << currentStyle;
     }
 }
 
@@ -554,6 +641,21 @@ void Block::mergeCompatibleStyles()
     }
 }
 
+// Returns the index of the first run ending at or after pos, or the size of
+// the style list if there is none
+int Block::style_index_at(int pos)
+{
+    const int count = m_style_list.size();
+    for (int i = m_style_hint; i < count && i <= m_style_hint + 1; i++) {
+        if (m_style_list.at(i).end_index >= pos && (i == 0 || m_style_list.at(i - 1).end_index < pos))
+            return i;
+    }
+
+    auto it = std::lower_bound(m_style_list.cbegin(), m_style_list.cend(), pos,
+                               [](const TextStyleLine &style, int pos) { return style.end_index < pos; });
+    return int(it - m_style_list.cbegin());
+}
+
 void Block::ensureStyleAlignWithLines(int i)
 {
     int start_line = m_style_list[i].start_index / m_width;
@@ -30,6 +30,7 @@
 
 class Text;
 class Screen;
+class QBitArray;
 
 class Block
 {
@@ -39,7 +40,9 @@ public:
 
     Q_INVOKABLE Screen *screen() const;
 
+    void reset();
     void clear();
+    void squeeze();
     void clearToEnd(int from);
     void clearCharacters(int from, int to);
     void deleteCharacters(int from, int to);
@@ -48,6 +51,8 @@ public:
 
     void replaceAtPos(int i, const QString &text, const TextStyle &style, bool only_latin = true);
     void insertAtPos(int i, const QString &text, const TextStyle &style, bool only_latin = true);
+    void setContent(const QString &text, const QVector<TextStyleLine> &styles, bool only_latin,
+                    int changed_start, int changed_end);
 
     void setScreenIndex(int index) { m_screen_index = index; }
     int screenIndex() const { return m_screen_index; }
@@ -60,14 +65,18 @@ public:
     }
 
     const QString &textLine() const;
-    int textSize() { return m_text_line.size(); }
+    int textSize() const { return m_text_line.size(); }
+    int textCapacity() const { return m_text_line.capacity(); }
+    QChar characterAt(int index) const;
+    QString textMid(int position, int n = -1) const;
+    bool onlyLatin() const { return m_only_latin; }
 
     int width() const { return m_width; }
     void setWidth(int width);
-    int lineCount() const { return (std::max((m_text_line.size() - 1),0) / m_width) + 1; }
+    int lineCount() const { return (std::max((textSize() - 1),0) / m_width) + 1; }
     int lineCountAfterModified(int from_char, int text_size, bool replace) {
-        int new_size = replace ? std::max(from_char + text_size, m_text_line.size())
-            : std::max(from_char, m_text_line.size()) + text_size;
+        int new_size = replace ? std::max(from_char + text_size, textSize())
+            : std::max(from_char, textSize()) + text_size;
         return ((new_size - 1) / m_width) + 1;
     }
 
@@ -84,6 +93,8 @@ public:
     void releaseTextObjects();
 
     QVector<TextStyleLine> style_list();
+    // Sets the bits of the style ids used by the runs
+    void markStyles(QBitArray *live) const;
 
     void printStyleList() const;
     void printStyleList(QDebug &debug) const;
@@ -92,12 +103,16 @@ public:
 private:
     void mergeCompatibleStyles();
     void ensureStyleAlignWithLines(int i);
+    int style_index_at(int pos);
     Screen *m_screen;
     QString m_text_line;
+    // Sorted, non overlapping runs covering m_text_line
     QVector<TextStyleLine> m_style_list;
     size_t m_line;
     size_t m_new_line;
     int m_screen_index;
+    // Run written last, where the next sequential write most likely lands
+    int m_style_hint;
 
     int m_width;
 
@@ -106,4 +121,9 @@ private:
     bool m_only_latin;
 };
 
+inline QChar Block::characterAt(int index) const
+{
+    return m_text_line.at(index);
+}
+
 #endif // BLOCK_H
@@ -0,0 +1,78 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#include "block_pool.h"
+
+#include "block.h"
+
+#include <algorithm>
+
+BlockPool::BlockPool(Screen *screen)
+    : m_screen(screen)
+    , m_max_free(DefaultMaxFree)
+{
+}
+
+BlockPool::~BlockPool()
+{
+    trim();
+}
+
+Block *BlockPool::acquire()
+{
+    if (m_free.isEmpty())
+        return new Block(m_screen);
+    Block *block = m_free.takeLast();
+    block->reset();
+    return block;
+}
+
+void BlockPool::release(Block *block)
+{
+    if (!block)
+        return;
+    if (m_free.size() >= m_max_free) {
+        delete block;
+        return;
+    }
+    // Gives the text segments back to the screen right away
+    block->clear();
+    if (block->textCapacity() > MaxKeptWidths * block->width())
+        block->squeeze();
+    m_free.append(block);
+}
+
+void BlockPool::setMaxFree(int max_free)
+{
+    m_max_free = std::max(max_free, 0);
+    trim(m_max_free);
+}
+
+// Deletes free blocks until at most keep are left
+void BlockPool::trim(int keep)
+{
+    while (m_free.size() > keep)
+        delete m_free.takeLast();
+    m_free.squeeze();
+}
@@ -0,0 +1,60 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <QtCore/QVector>
+
+class Block;
+class Screen;
+
+// Free list of blocks for a Screen. Released blocks are cleared but keep the
+// capacity of their text and style buffers, so once the scrollback is full a
+// steady stream of output reuses the blocks falling out of it instead of
+// going through the allocator for every line. Blocks that held a line many
+// times the screen width are squeezed, so the pool does not pin that memory.
+class BlockPool
+{
+public:
+    enum { DefaultMaxFree = 1024, MaxKeptWidths = 4 };
+
+    BlockPool(Screen *screen);
+    ~BlockPool();
+
+    Block *acquire();
+    void release(Block *block);
+
+    int freeCount() const { return m_free.size(); }
+    int maxFree() const { return m_max_free; }
+    void setMaxFree(int max_free);
+    void trim(int keep = 0);
+
+private:
+    Screen *m_screen;
+    QVector<Block *> m_free;
+    int m_max_free;
+};
+
+#endif // BLOCK_POOL_H
@@ -0,0 +1,240 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef BLOCK_RING_H
+#define BLOCK_RING_H
+
+#include <QtCore/qglobal.h>
+
+#include <utility>
+#include <vector>
+
+class Block;
+
+// Contiguous circular array of blocks. Pushing and popping at either end
+// only moves the ring start, and any position is reached with a mask instead
+// of walking a list. Inserting or erasing in the middle moves the shorter
+// side of the ring.
+class BlockRing
+{
+public:
+    class iterator
+    {
+    public:
+        iterator() : m_ring(nullptr), m_index(0) { }
+        iterator(BlockRing *ring, int index) : m_ring(ring), m_index(index) { }
+
+        Block *&operator*() const { return m_ring->at(m_index); }
+        iterator &operator++() { ++m_index; return *this; }
+        iterator &operator--() { --m_index; return *this; }
+        iterator operator+(int n) const { return iterator(m_ring, m_index + n); }
+        iterator operator-(int n) const { return iterator(m_ring, m_index - n); }
+        int operator-(const iterator &other) const { return m_index - other.m_index; }
+        bool operator==(const iterator &other) const { return m_index == other.m_index; }
+        bool operator!=(const iterator &other) const { return m_index != other.m_index; }
+
+        int index() const { return m_index; }
+    private:
+        BlockRing *m_ring;
+        int m_index;
+    };
+
+    BlockRing();
+
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    inline Block *&at(int index);
+    inline Block *at(int index) const;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_size); }
+
+    inline void push_front(Block *block);
+    inline void push_back(Block *block);
+    inline Block *take_front();
+    inline Block *take_back();
+
+    inline iterator insert(iterator before, Block *block);
+    inline iterator erase(iterator it);
+    inline void move(int from, int to);
+    inline void rotate(int first, int middle, int last);
+
+private:
+    inline int physical(int index) const;
+    inline void grow();
+
+    std::vector<Block *> m_data;
+    int m_start;
+    int m_size;
+};
+
+inline BlockRing::BlockRing()
+    : m_data(16, nullptr)
+    , m_start(0)
+    , m_size(0)
+{
+}
+
+int BlockRing::physical(int index) const
+{
+    return (m_start + index) & int(m_data.size() - 1);
+}
+
+Block *&BlockRing::at(int index)
+{
+    Q_ASSERT(index >= 0 && index < m_size);
+    return m_data[physical(index)];
+}
+
+Block *BlockRing::at(int index) const
+{
+    Q_ASSERT(index >= 0 && index < m_size);
+    return m_data[physical(index)];
+}
+
+void BlockRing::push_front(Block *block)
+{
+    if (m_size == int(m_data.size()))
+        grow();
+    m_start = (m_start - 1) & int(m_data.size() - 1);
+    m_size++;
+    m_data[m_start] = block;
+}
+
+void BlockRing::push_back(Block *block)
+{
+    if (m_size == int(m_data.size()))
+        grow();
+    m_data[physical(m_size)] = block;
+    m_size++;
+}
+
+Block *BlockRing::take_front()
+{
+    Q_ASSERT(m_size);
+    Block *block = m_data[m_start];
+    m_start = physical(1);
+    m_size--;
+    return block;
+}
+
+Block *BlockRing::take_back()
+{
+    Q_ASSERT(m_size);
+    m_size--;
+    return m_data[physical(m_size)];
+}
+
+BlockRing::iterator BlockRing::insert(iterator before, Block *block)
+{
+    const int index = before.index();
+    Q_ASSERT(index >= 0 && index <= m_size);
+    if (index < m_size / 2) {
+        push_front(nullptr);
+        for (int i = 0; i < index; i++)
+            at(i) = at(i + 1);
+    } else {
+        push_back(nullptr);
+        for (int i = m_size - 1; i > index; i--)
+            at(i) = at(i - 1);
+    }
+    at(index) = block;
+    return iterator(this, index);
+}
+
+BlockRing::iterator BlockRing::erase(iterator it)
+{
+    const int index = it.index();
+    Q_ASSERT(index >= 0 && index < m_size);
+    if (index < m_size / 2) {
+        for (int i = index; i > 0; i--)
+            at(i) = at(i - 1);
+        take_front();
+        return iterator(this, index);
+    }
+    for (int i = index; i < m_size - 1; i++)
+        at(i) = at(i + 1);
+    take_back();
+    return iterator(this, index);
+}
+
+// Moves the block at from so that it ends up at index to, shifting the
+// blocks in between by one
+void BlockRing::move(int from, int to)
+{
+    Q_ASSERT(from >= 0 && from < m_size && to >= 0 && to < m_size);
+    Block *block = at(from);
+    if (from < to) {
+        for (int i = from; i < to; i++)
+            at(i) = at(i + 1);
+    } else {
+        for (int i = from; i > to; i--)
+            at(i) = at(i - 1);
+    }
+    at(to) = block;
+}
+
+// Same as std::rotate on [first, last), the block at middle becomes the
+// first one. Rotating the whole ring only moves the shorter part across the
+// ring start.
+void BlockRing::rotate(int first, int middle, int last)
+{
+    Q_ASSERT(first <= middle && middle <= last && last <= m_size);
+    if (first == middle || middle == last)
+        return;
+    if (first == 0 && last == m_size) {
+        if (middle <= m_size / 2) {
+            for (int i = 0; i < middle; i++)
+                push_back(take_front());
+        } else {
+            for (int i = middle; i < m_size; i++)
+                push_front(take_back());
+        }
+        return;
+    }
+    iterator first_it(this, first);
+    iterator middle_it(this, middle);
+    iterator next_it = middle_it;
+    iterator last_it(this, last);
+    while (first_it != next_it) {
+        std::swap(*first_it, *next_it);
+        ++first_it;
+        ++next_it;
+        if (next_it == last_it)
+            next_it = middle_it;
+        else if (first_it == middle_it)
+            middle_it = next_it;
+    }
+}
+
+void BlockRing::grow()
+{
+    std::vector<Block *> data(m_data.size() * 2, nullptr);
+    for (int i = 0; i < m_size; i++)
+        data[i] = at(i);
+    m_data.swap(data);
+    m_start = 0;
+}
+
+#endif // BLOCK_RING_H
@@ -0,0 +1,195 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#include "cell_grid.h"
+
+#include "block.h"
+#include "screen.h"
+
+#include <QtCore/QBitArray>
+
+#include <algorithm>
+
+CellGrid::CellGrid(Screen *screen)
+    : m_screen(screen)
+    , m_width(0)
+    , m_height(0)
+{
+}
+
+void CellGrid::resize(int width, int height)
+{
+    Q_ASSERT(!hasLoadedRows());
+    m_width = width;
+    m_height = height;
+    m_cells.resize(width * height);
+    m_rows.fill(Row{ nullptr, 0, 0, -1, true }, height);
+}
+
+void CellGrid::loadRow(int row, Block *block)
+{
+    Q_ASSERT(!isRowLoaded(row));
+    const QString &text = block->textLine();
+    Q_ASSERT(text.size() <= m_width);
+    const quint16 default_style = m_screen->defaultTextStyle().id;
+    Cell *row_cells = cells(row);
+
+    // All of the text is copied, the cells of a gap between the style runs
+    // would otherwise keep what the last row loaded here left in them
+    for (int column = 0; column < text.size(); column++) {
+        row_cells[column].character = text.at(column).unicode();
+        row_cells[column].style = default_style;
+    }
+    const QVector<TextStyleLine> style_list = block->style_list();
+    for (int i = 0; i < style_list.size(); i++) {
+        const TextStyleLine &current_style = style_list.at(i);
+        const int end = std::min(current_style.end_index, text.size() - 1);
+        for (int column = current_style.start_index; column <= end; column++)
+            row_cells[column].style = current_style.style_id;
+    }
+
+    m_rows[row] = Row{ block, text.size(), m_width, -1, block->onlyLatin() };
+    m_loaded_rows.append(row);
+}
+
+bool CellGrid::replace(int row, int column, const QString &text, const TextStyle &style, bool only_latin)
+{
+    if (column + text.size() > m_width)
+        return false;
+    Q_ASSERT(style.id != TextStyle::InvalidId);
+    padTo(row, column);
+
+    Row &current_row = m_rows[row];
+    Cell *cell = cells(row) + column;
+    const ushort *characters = reinterpret_cast<const ushort *>(text.constData());
+    for (int i = 0; i < text.size(); i++) {
+        cell[i].character = characters[i];
+        cell[i].style = style.id;
+    }
+    current_row.length = std::max(current_row.length, column + text.size());
+    current_row.only_latin = current_row.only_latin && only_latin;
+    markDirty(current_row, column, column + text.size() - 1);
+    return true;
+}
+
+// Same result as Block::clearCharacters, the characters are replaced by
+// spaces in the default style
+bool CellGrid::clearCharacters(int row, int from, int to)
+{
+    if (from > m_width || to >= m_width)
+        return false;
+    // Nothing is cleared past the end of the line, it is not padded either
+    if (from > m_rows[row].length)
+        return true;
+    padTo(row, from);
+
+    const quint16 default_style = m_screen->defaultTextStyle().id;
+    Row &current_row = m_rows[row];
+    Cell *row_cells = cells(row);
+    for (int column = from; column <= to; column++) {
+        row_cells[column].character = ' ';
+        row_cells[column].style = default_style;
+    }
+    if (to >= from) {
+        current_row.length = std::max(current_row.length, to + 1);
+        markDirty(current_row, from, to);
+    }
+    return true;
+}
+
+bool CellGrid::clearToEnd(int row, int from)
+{
+    return clearCharacters(row, from, m_rows.at(row).length - 1);
+}
+
+void CellGrid::clearRow(int row)
+{
+    Row &current_row = m_rows[row];
+    current_row.length = 0;
+    current_row.only_latin = true;
+    markDirty(current_row, 0, m_width - 1);
+}
+
+void CellGrid::flush()
+{
+    for (int row : m_loaded_rows) {
+        flushRow(m_rows[row], cells(row));
+        m_rows[row] = Row{ nullptr, 0, 0, -1, true };
+    }
+    m_loaded_rows.resize(0);
+}
+
+void CellGrid::markStyles(QBitArray *live) const
+{
+    for (int row : m_loaded_rows) {
+        const Cell *row_cells = m_cells.constData() + row * m_width;
+        for (int column = 0; column < m_rows.at(row).length; column++)
+            live->setBit(row_cells[column].style);
+    }
+}
+
+// Writing past the end of the text fills the gap with default styled spaces
+void CellGrid::padTo(int row, int column)
+{
+    Row &current_row = m_rows[row];
+    if (column <= current_row.length)
+        return;
+    const quint16 default_style = m_screen->defaultTextStyle().id;
+    Cell *row_cells = cells(row);
+    for (int i = current_row.length; i < column; i++) {
+        row_cells[i].character = ' ';
+        row_cells[i].style = default_style;
+    }
+    markDirty(current_row, current_row.length, column - 1);
+    current_row.length = column;
+}
+
+void CellGrid::markDirty(Row &row, int start, int end)
+{
+    row.dirty_start = std::min(row.dirty_start, start);
+    row.dirty_end = std::max(row.dirty_end, end);
+}
+
+void CellGrid::flushRow(Row &row, const Cell *row_cells)
+{
+    if (row.dirty_end < row.dirty_start)
+        return;
+
+    m_text.resize(row.length);
+    ushort *text = reinterpret_cast<ushort *>(m_text.data());
+    m_runs.resize(0);
+    int run_style = -1;
+    for (int column = 0; column < row.length; column++) {
+        const Cell &cell = row_cells[column];
+        text[column] = cell.character;
+        if (cell.style == run_style) {
+            m_runs.last().end_index = column;
+        } else {
+            run_style = cell.style;
+            m_runs.append(TextStyleLine(cell.style, column, column));
+        }
+    }
+
+    row.block->setContent(m_text, m_runs, row.only_latin, row.dirty_start, row.dirty_end);
+}
@@ -0,0 +1,100 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#ifndef CELL_GRID_H
+#define CELL_GRID_H
+
+#include "text_style.h"
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class Block;
+class Screen;
+class QBitArray;
+
+// Write combining overlay for single line rows on the screen. A row is loaded
+// from its block on the first write, after which cursor addressed writes and
+// clears only touch the packed cells. The text and the style runs are given
+// back to the block when the grid is flushed, which ScreenData does before
+// dispatching and before any operation that changes the blocks.
+class CellGrid
+{
+public:
+    struct Cell
+    {
+        ushort character;
+        // Id in the StyleTable of the screen
+        quint16 style;
+    };
+
+    CellGrid(Screen *screen);
+
+    void resize(int width, int height);
+
+    bool isRowLoaded(int row) const;
+    bool hasLoadedRows() const { return !m_loaded_rows.isEmpty(); }
+    void loadRow(int row, Block *block);
+
+    bool replace(int row, int column, const QString &text, const TextStyle &style, bool only_latin);
+    bool clearCharacters(int row, int from, int to);
+    bool clearToEnd(int row, int from);
+    void clearRow(int row);
+
+    void flush();
+    // Sets the bits of the style ids used by the loaded rows
+    void markStyles(QBitArray *live) const;
+
+private:
+    struct Row
+    {
+        Block *block;
+        int length;
+        int dirty_start;
+        int dirty_end;
+        bool only_latin;
+    };
+
+    Cell *cells(int row) { return m_cells.data() + row * m_width; }
+    void padTo(int row, int column);
+    void markDirty(Row &row, int start, int end);
+    void flushRow(Row &row, const Cell *row_cells);
+
+    Screen *m_screen;
+    int m_width;
+    int m_height;
+    QVector<Cell> m_cells;
+    QVector<Row> m_rows;
+    QVector<int> m_loaded_rows;
+
+    QString m_text;
+    QVector<TextStyleLine> m_runs;
+};
+
+inline bool CellGrid::isRowLoaded(int row) const
+{
+    return m_rows.at(row).block;
+}
+
+#endif // CELL_GRID_H
@@ -0,0 +1,168 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#include "chunk_codec.h"
+
+#include <algorithm>
+#include <string.h>
+
+static inline quint32 read32(const uchar *data)
+{
+    quint32 value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline int hash32(quint32 sequence, int hash_log)
+{
+    return int((sequence * 2654435761u) >> (32 - hash_log));
+}
+
+QByteArray ChunkCodec::compress(const QByteArray &data)
+{
+    const int size = data.size();
+    // Worst case is all literals: one extra length byte per 255 of them
+    QByteArray result(size + size / 255 + 16, Qt::Uninitialized);
+    const uchar *src = reinterpret_cast<const uchar *>(data.constData());
+    char *out = result.data();
+
+    int table[1 << HashLog];
+    for (int &entry : table)
+        entry = -1;
+
+    int anchor = 0;
+    int pos = 0;
+    const int match_limit = size - MatchStartLimit;
+    while (pos < match_limit) {
+        const quint32 sequence = read32(src + pos);
+        const int hash = hash32(sequence, HashLog);
+        const int ref = table[hash];
+        table[hash] = pos;
+        if (ref < 0 || pos - ref > MaxOffset || read32(src + ref) != sequence) {
+            pos++;
+            continue;
+        }
+
+        int match_length = MinMatch;
+        while (pos + match_length < size - LastLiterals && src[ref + match_length] == src[pos + match_length])
+            match_length++;
+
+        const int literals = pos - anchor;
+        char *token = out++;
+        *token = char((std::min(literals, 15) << 4) | std::min(match_length - MinMatch, 15));
+        if (literals >= 15)
+            out = write_length(out, literals - 15);
+        memcpy(out, src + anchor, literals);
+        out += literals;
+        const int offset = pos - ref;
+        *out++ = char(offset & 0xff);
+        *out++ = char(offset >> 8);
+        if (match_length - MinMatch >= 15)
+            out = write_length(out, match_length - MinMatch - 15);
+
+        pos += match_length;
+        anchor = pos;
+    }
+
+    const int literals = size - anchor;
+    *out++ = char(std::min(literals, 15) << 4);
+    if (literals >= 15)
+        out = write_length(out, literals - 15);
+    memcpy(out, src + anchor, literals);
+    out += literals;
+
+    result.resize(int(out - result.constData()));
+    return result;
+}
+
+QByteArray ChunkCodec::decompress(const QByteArray &data, int raw_size)
+{
+    QByteArray result(raw_size, Qt::Uninitialized);
+    const uchar *in = reinterpret_cast<const uchar *>(data.constData());
+    const uchar *in_end = in + data.size();
+    uchar *out = reinterpret_cast<uchar *>(result.data());
+    uchar *const out_begin = out;
+    uchar *const out_end = out + raw_size;
+
+    while (in < in_end) {
+        const int token = *in++;
+        int literals = token >> 4;
+        if (literals == 15) {
+            int extra;
+            do {
+                if (in >= in_end)
+                    return QByteArray();
+                extra = *in++;
+                literals += extra;
+            } while (extra == 255);
+        }
+        if (literals > in_end - in || literals > out_end - out)
+            return QByteArray();
+        memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+
+        // The last sequence has no match
+        if (in == in_end)
+            break;
+
+        if (in_end - in < 2)
+            return QByteArray();
+        const int offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out - out_begin)
+            return QByteArray();
+
+        int match_length = token & 15;
+        if (match_length == 15) {
+            int extra;
+            do {
+                if (in >= in_end)
+                    return QByteArray();
+                extra = *in++;
+                match_length += extra;
+            } while (extra == 255);
+        }
+        match_length += MinMatch;
+        if (match_length > out_end - out)
+            return QByteArray();
+        // Byte by byte, the match may overlap the bytes it produces
+        const uchar *match = out - offset;
+        for (int i = 0; i < match_length; i++)
+            out[i] = match[i];
+        out += match_length;
+    }
+
+    if (out != out_end)
+        return QByteArray();
+    return result;
+}
+
+char *ChunkCodec::write_length(char *out, int length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = char(255);
+    *out++ = char(length);
+    return out;
+}
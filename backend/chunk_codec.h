@@ -0,0 +1,55 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#ifndef CHUNK_CODEC_H
+#define CHUNK_CODEC_H
+
+#include <QtCore/QByteArray>
+
+// Byte oriented LZ77 compression in the LZ4 block format, used for the
+// scrollback chunks that are not close to anything visible. Favours speed
+// over ratio, lines of terminal output repeat a lot so it still does well.
+class ChunkCodec
+{
+public:
+    static QByteArray compress(const QByteArray &data);
+    // Returns a null QByteArray if data is not a valid block that
+    // decompresses to exactly raw_size bytes
+    static QByteArray decompress(const QByteArray &data, int raw_size);
+
+private:
+    enum {
+        HashLog = 12,
+        MinMatch = 4,
+        // Matches may not start in the last 12 bytes and the last 5 bytes are
+        // always literals, as in LZ4
+        MatchStartLimit = 12,
+        LastLiterals = 5,
+        MaxOffset = 0xffff
+    };
+
+    static char *write_length(char *out, int length);
+};
+
+#endif // CHUNK_CODEC_H
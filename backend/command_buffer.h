@@ -0,0 +1,204 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QVector>
+
+class QTextCodec;
+
+namespace ScreenCommand {
+enum ScreenCommand {
+    Print,
+    InsertBlanks,
+    LineFeed,
+    ReverseLineFeed,
+    CarriageReturn,
+    MoveUp,
+    MoveDown,
+    MoveLeft,
+    MoveRight,
+    Move,
+    MoveToLine,
+    MoveToCharacter,
+    MoveOrigin,
+    MoveToNextTab,
+    SetTabStop,
+    RemoveTabStop,
+    ClearTabStops,
+    ClearToBeginningOfLine,
+    ClearToEndOfLine,
+    ClearLine,
+    ClearToBeginningOfScreen,
+    ClearToEndOfScreen,
+    ClearScreen,
+    DeleteCharacters,
+    InsertLines,
+    DeleteLines,
+    ScrollUp,
+    ScrollDown,
+    SetScrollArea,
+    ResetScrollArea,
+    ResetStyle,
+    SetTextStyle,
+    SetForegroundColor,
+    SetBackgroundColor,
+    SetForegroundColorIndex,
+    SetBackgroundColorIndex,
+    SetTextCodec,
+    SetInsertMode,
+    SetOriginAtMargin,
+    SetWrapAround,
+    SetCursorVisible,
+    SetCursorBlinking,
+    SetColumnMode,
+    SetFastScroll,
+    SetInverseDefaultColors,
+    SetApplicationCursorKeys,
+    UseAlternateScreenBuffer,
+    UseNormalScreenBuffer,
+    SaveCursor,
+    RestoreCursor,
+    Fill,
+    Flash,
+    SendPrimaryDA,
+    SendSecondaryDA,
+    SetTitle
+};
+}
+
+// Batch of operations produced by the Parser and applied by Screen::execute.
+// Text for Print and SetTitle is copied into a side buffer and referenced by
+// offset and length, so a buffer is self contained and can be applied after
+// the data it was parsed from is gone. Both buffers keep their capacity when
+// cleared.
+class CommandBuffer
+{
+public:
+    struct Command
+    {
+        ScreenCommand::ScreenCommand type;
+        union {
+            int arguments[3];
+            QTextCodec *codec;
+        };
+    };
+
+    inline CommandBuffer();
+
+    inline void clear();
+
+    inline void append(ScreenCommand::ScreenCommand type, int first = 0, int second = 0);
+    inline void appendText(ScreenCommand::ScreenCommand type, const char *data, int length, bool only_latin = false);
+    inline void appendTextCodec(QTextCodec *codec);
+    inline void appendLineFeed();
+
+    inline int size() const;
+    inline const Command &at(int index) const;
+    inline QByteArray text(const Command &command) const;
+
+private:
+    inline Command &add(ScreenCommand::ScreenCommand type);
+
+    QVector<Command> m_commands;
+    QByteArray m_text;
+};
+
+CommandBuffer::CommandBuffer()
+{
+    m_commands.reserve(64);
+    m_text.reserve(4096);
+}
+
+void CommandBuffer::clear()
+{
+    m_commands.resize(0);
+    m_text.resize(0);
+}
+
+void CommandBuffer::append(ScreenCommand::ScreenCommand type, int first, int second)
+{
+    Command &command = add(type);
+    command.arguments[0] = first;
+    command.arguments[1] = second;
+    command.arguments[2] = 0;
+}
+
+void CommandBuffer::appendText(ScreenCommand::ScreenCommand type, const char *data, int length, bool only_latin)
+{
+    Command &command = add(type);
+    command.arguments[0] = m_text.size();
+    command.arguments[1] = length;
+    command.arguments[2] = only_latin;
+    m_text.append(data, length);
+}
+
+void CommandBuffer::appendTextCodec(QTextCodec *codec)
+{
+    add(ScreenCommand::SetTextCodec).codec = codec;
+}
+
+// Runs of line feeds are merged into one command with a count. A carriage
+// return between two line feeds does not change the outcome, since line feed
+// keeps the column, so LF CR LF is stored as LF(2) CR.
+void CommandBuffer::appendLineFeed()
+{
+    const int size = m_commands.size();
+    if (size && m_commands.at(size - 1).type == ScreenCommand::LineFeed) {
+        m_commands[size - 1].arguments[0]++;
+        return;
+    }
+    if (size > 1 && m_commands.at(size - 1).type == ScreenCommand::CarriageReturn
+            && m_commands.at(size - 2).type == ScreenCommand::LineFeed) {
+        m_commands[size - 2].arguments[0]++;
+        return;
+    }
+    append(ScreenCommand::LineFeed, 1);
+}
+
+int CommandBuffer::size() const
+{
+    return m_commands.size();
+}
+
+const CommandBuffer::Command &CommandBuffer::at(int index) const
+{
+    return m_commands.at(index);
+}
+
+QByteArray CommandBuffer::text(const Command &command) const
+{
+    return QByteArray::fromRawData(m_text.constData() + command.arguments[0], command.arguments[1]);
+}
+
+CommandBuffer::Command &CommandBuffer::add(ScreenCommand::ScreenCommand type)
+{
+    m_commands.append(Command());
+    Command &command = m_commands.last();
+    command.type = type;
+    return command;
+}
+
+#endif // COMMAND_BUFFER_H
@@ -0,0 +1,142 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef CSI_PARAMETERS_H
+#define CSI_PARAMETERS_H
+
+#include <QtCore/qglobal.h>
+
+// Fixed capacity storage for the numeric parameters of a control sequence.
+// Parameters are accumulated one digit at a time, so a sequence never touches
+// the allocator. Parameters separated by ':' are stored as sub parameters of
+// the preceding one. Omitted parameters are stored as Default.
+class CsiParameters
+{
+public:
+    enum {
+        MaxParameters = 32,
+        MaxValue = 0xffff,
+        Default = -1
+    };
+
+    inline CsiParameters();
+
+    inline void clear();
+    inline void addDigit(uchar digit);
+    inline void addSeparator(bool sub_parameter);
+    inline void append(int value, bool sub_parameter = false);
+    inline void replaceDefaults(int value);
+
+    inline int size() const;
+    inline int at(int index) const;
+    inline bool isSubParameter(int index) const;
+    inline int subParameterCount(int index) const;
+
+private:
+    int m_values[MaxParameters];
+    bool m_sub_parameters[MaxParameters];
+    int m_size;
+    bool m_accumulating;
+    bool m_expecting_more;
+    bool m_next_is_sub_parameter;
+};
+
+CsiParameters::CsiParameters()
+{
+    clear();
+}
+
+void CsiParameters::clear()
+{
+    m_size = 0;
+    m_accumulating = false;
+    m_expecting_more = false;
+    m_next_is_sub_parameter = false;
+}
+
+void CsiParameters::addDigit(uchar digit)
+{
+    if (!m_accumulating) {
+        if (m_size == MaxParameters)
+            return;
+        append(0, m_next_is_sub_parameter);
+        m_accumulating = true;
+    }
+    int &value = m_values[m_size - 1];
+    value = qMin(value * 10 + (digit - '0'), int(MaxValue));
+}
+
+void CsiParameters::addSeparator(bool sub_parameter)
+{
+    if (!m_accumulating)
+        append(Default, m_next_is_sub_parameter);
+    m_accumulating = false;
+    m_expecting_more = true;
+    m_next_is_sub_parameter = sub_parameter;
+}
+
+void CsiParameters::append(int value, bool sub_parameter)
+{
+    if (m_size == MaxParameters)
+        return;
+    m_values[m_size] = value;
+    m_sub_parameters[m_size] = sub_parameter;
+    m_size++;
+    m_expecting_more = false;
+}
+
+void CsiParameters::replaceDefaults(int value)
+{
+    for (int i = 0; i < m_size; i++) {
+        if (m_values[i] == Default)
+            m_values[i] = value;
+    }
+    if (m_expecting_more && !m_accumulating)
+        append(value, m_next_is_sub_parameter);
+}
+
+int CsiParameters::size() const
+{
+    return m_size;
+}
+
+int CsiParameters::at(int index) const
+{
+    Q_ASSERT(index >= 0 && index < m_size);
+    return m_values[index];
+}
+
+bool CsiParameters::isSubParameter(int index) const
+{
+    return m_sub_parameters[index];
+}
+
+int CsiParameters::subParameterCount(int index) const
+{
+    int count = 0;
+    while (index + count + 1 < m_size && m_sub_parameters[index + count + 1])
+        count++;
+    return count;
+}
+
+#endif // CSI_PARAMETERS_H
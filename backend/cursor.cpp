@@ -25,6 +25,7 @@
 
 #include "block.h"
 #include "screen_data.h"
+#include "utf8_transcoder.h"
 
 #include <QtCore/QLoggingCategory>
 #include <QTextCodec>
@@ -50,6 +51,7 @@ Cursor::Cursor(Screen* screen)
     , m_new_blinking(false)
     , m_wrap_around(true)
     , m_content_height_changed(false)
+    , m_gl_is_utf8(true)
     , m_insert_mode(Replace)
     , m_resize_block(0)
     , m_current_pos_in_block(0)
@@ -71,7 +73,8 @@ Cursor::Cursor(Screen* screen)
 
 Cursor::~Cursor()
 {
-
+    delete m_gl_text_codec;
+    delete m_gr_text_codec;
 }
 
 void Cursor::setScreenWidthAboutToChange(int width)
@@ -153,6 +156,7 @@ void Cursor::setTextStyle(TextStyle::Style style, bool add)
     } else {
         m_current_text_style.style &= !style;
     }
+    update_style_id();
 }
 
 void Cursor::resetStyle()
@@ -160,29 +164,40 @@ void Cursor::resetStyle()
     m_current_text_style.background = colorPalette()->defaultBackground().rgb();
     m_current_text_style.foreground = colorPalette()->defaultForeground().rgb();
     m_current_text_style.style = TextStyle::Normal;
+    update_style_id();
 }
 
-void Cursor::scrollUp(int lines)
+void Cursor::insertLines(int lines)
 {
     if (new_y() < top() || new_y() > bottom())
-            return;
-    for (int i = 0; i < lines; i++) {
-        screen_data()->moveLine(bottom(), top());
-    }
+        return;
+    screen_data()->insertBlankLines(new_y(), bottom(), lines);
 }
 
-void Cursor::scrollDown(int lines)
+void Cursor::deleteLines(int lines)
 {
     if (new_y() < top() || new_y() > bottom())
         return;
-    for (int i = 0; i < lines; i++) {
-        screen_data()->moveLine(top(), bottom());
-    }
+    screen_data()->deleteLines(new_y(), bottom(), lines);
+}
+
+void Cursor::scrollUp(int lines)
+{
+    screen_data()->deleteLines(top(), bottom(), lines);
+}
+
+void Cursor::scrollDown(int lines)
+{
+    screen_data()->insertBlankLines(top(), bottom(), lines);
 }
 
 void Cursor::setTextCodec(QTextCodec *codec)
 {
+    delete m_gl_text_codec;
     m_gl_text_codec = codec->makeDecoder();
+    // utf-8 and ascii are decoded by Utf8Transcoder, the codec is only used
+    // for the national replacement character sets
+    m_gl_is_utf8 = codec->mibEnum() == 106;
 }
 
 void Cursor::setInsertMode(InsertMode mode)
@@ -198,11 +213,13 @@ TextStyle Cursor::currentTextStyle() const
 void Cursor::setTextForegroundColor(QRgb color)
 {
     m_current_text_style.foreground = color;
+    update_style_id();
 }
 
 void Cursor::setTextBackgroundColor(QRgb color)
 {
     m_current_text_style.background = color;
+    update_style_id();
 }
 
 void Cursor::setTextForegroundColorIndex(ColorPalette::Color color)
@@ -452,7 +469,7 @@ void Cursor::addAtCursor(const QByteArray &data, bool only_latin)
 
 void Cursor::replaceAtCursor(const QByteArray &data, bool only_latin)
 {
-    const QString text = m_gl_text_codec->toUnicode(data);
+    const QString &text = decodeText(data);
 
     if (!m_wrap_around && new_x() + text.size() > m_screen->width()) {
         const int size = m_screen_width - new_x();
@@ -475,7 +492,7 @@ void Cursor::replaceAtCursor(const QByteArray &data, bool only_latin)
 
 void Cursor::insertAtCursor(const QByteArray &data, bool only_latin)
 {
-    const QString text = m_gl_text_codec->toUnicode(data);
+    const QString &text = decodeText(data);
     auto diff = screen_data()->insert(m_new_position, text, m_current_text_style, only_latin);
     new_rx() += diff.character;
     new_ry() += diff.line;
@@ -485,20 +502,38 @@ void Cursor::insertAtCursor(const QByteArray &data, bool only_latin)
         new_rx() = m_screen_width - 1;
 }
 
-void Cursor::lineFeed()
+const QString &Cursor::decodeText(const QByteArray &data)
 {
-    if(new_y() >= bottom()) {
-        screen_data()->insertLine(bottom(), top());
-    } else {
-        new_ry()++;
+    if (!m_gl_is_utf8) {
+        m_text_buffer = m_gl_text_codec->toUnicode(data);
+        return m_text_buffer;
+    }
+
+    // The buffer keeps its capacity between runs, so this only allocates when
+    // a run is longer than any previous one
+    m_text_buffer.resize(data.size());
+    const uchar *begin = reinterpret_cast<const uchar *>(data.constData());
+    const int size = Utf8Transcoder::toUtf16(begin, begin + data.size(), reinterpret_cast<ushort *>(m_text_buffer.data()));
+    m_text_buffer.resize(size);
+    return m_text_buffer;
+}
+
+void Cursor::lineFeed(int lines)
+{
+    if (new_y() < bottom()) {
+        const int move = std::min(lines, bottom() - new_y());
+        new_ry() += move;
+        lines -= move;
         notifyChanged();
     }
+    if (lines > 0)
+        screen_data()->insertLines(bottom(), top(), lines);
 }
 
 void Cursor::reverseLineFeed()
 {
     if (new_y() == top()) {
-        scrollUp(1);
+        scrollDown(1);
     } else {
         new_ry()--;
         notifyChanged();
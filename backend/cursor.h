@@ -96,13 +96,15 @@ public:
     void insertAtCursor(const QByteArray &text, bool only_latin = true);
     void replaceAtCursor(const QByteArray &text, bool only_latin = true);
 
-    void lineFeed();
+    void lineFeed(int lines = 1);
     void reverseLineFeed();
 
     void setOriginAtMargin(bool atMargin);
     void setScrollArea(int from, int to);
     void resetScrollArea();
 
+    void insertLines(int lines);
+    void deleteLines(int lines);
     void scrollUp(int lines);
     void scrollDown(int lines);
 
@@ -139,6 +141,7 @@ private:
     int adjusted_bottom() const { return m_origin_at_margin ? m_bottom_margin : m_screen_height - 1; }
     int top() const { return m_scroll_margins_set ? m_top_margin : 0; }
     int bottom() const { return m_scroll_margins_set ? m_bottom_margin : m_screen_height - 1; }
+    void update_style_id() { m_current_text_style.id = m_screen->internStyle(m_current_text_style); }
     Screen *m_screen;
     TextStyle m_current_text_style;
     QPoint m_position;
@@ -164,6 +167,8 @@ private:
 
     QTextDecoder *m_gl_text_codec;
     QTextDecoder *m_gr_text_codec;
+    bool m_gl_is_utf8;
+    QString m_text_buffer;
 
     InsertMode m_insert_mode;
 
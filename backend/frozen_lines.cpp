@@ -0,0 +1,436 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#include "frozen_lines.h"
+
+#include "block.h"
+#include "chunk_codec.h"
+#include "style_table.h"
+
+#include <algorithm>
+#include <string.h>
+
+FrozenLines::FrozenLines(StyleTable *style_table)
+    : m_style_table(style_table)
+    , m_byte_size(0)
+    , m_record_size(0)
+    , m_memory_limit(DefaultMemoryLimit)
+    , m_first_chunk(0)
+    , m_hot_first_chunk(0)
+    , m_hot_end_chunk(0)
+    , m_palette_chunk(~quint64(0))
+    , m_palette_generation(0)
+{
+}
+
+// The only latin flag of a block comes from the bytes read from the pty,
+// which does not hold for text mapped through a character set, so the text
+// itself decides if it can be stored as Latin-1
+static bool isLatin1(const QString &text)
+{
+    const QChar *characters = text.constData();
+    for (int i = 0; i < text.size(); i++) {
+        if (characters[i].unicode() > 0xff)
+            return false;
+    }
+    return true;
+}
+
+void FrozenLines::push_back(Block *block)
+{
+    const QString &text = block->textLine();
+    const QVector<TextStyleLine> styles = block->style_list();
+    const bool only_latin = isLatin1(text);
+    const int text_size = text.size();
+
+    // Runs are stored as lengths, so overlaps and gaps between the runs of
+    // the block are resolved here
+    m_runs.resize(0);
+    int covered = 0;
+    for (const TextStyleLine &style : styles) {
+        const int end = std::min(style.end_index, text_size - 1);
+        if (end < covered)
+            continue;
+        if (m_runs.size() && m_runs.last().style == style.style_id)
+            m_runs.last().length += quint32(end + 1 - covered);
+        else
+            m_runs.append(Run{ quint32(end + 1 - covered), style.style_id });
+        covered = end + 1;
+    }
+    // A block without runs is kept without them
+    if (covered < text_size && m_runs.size())
+        m_runs.last().length += quint32(text_size - covered);
+
+    const Header header = { quint32(text_size), quint32(m_runs.size()), only_latin };
+    const int record_size = text_offset(header) + text_size * (only_latin ? 1 : int(sizeof(QChar)));
+
+    Chunk &chunk = chunk_for_append(record_size);
+    const quint64 chunk_id = m_first_chunk + m_chunks.size() - 1;
+    const int offset = chunk.data.size();
+    chunk.data.resize(offset + record_size);
+    char *out = chunk.data.data() + offset;
+
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    for (const Run &run : m_runs) {
+        const quint16 index = palette_index(chunk_id, chunk, run.style);
+        memcpy(out, &run.length, sizeof(run.length));
+        memcpy(out + sizeof(run.length), &index, sizeof(index));
+        out += RunSize;
+    }
+    if (only_latin) {
+        const QChar *characters = text.constData();
+        for (int i = 0; i < text_size; i++)
+            out[i] = char(characters[i].unicode());
+    } else {
+        memcpy(out, text.constData(), text_size * sizeof(QChar));
+    }
+
+    chunk.records++;
+    m_records.push_back(Record{ chunk_id, offset, text_size, record_size });
+    m_byte_size += record_size;
+    m_record_size += record_size;
+}
+
+void FrozenLines::pop_front()
+{
+    Q_ASSERT(!m_records.empty());
+    const Record record = m_records.front();
+    m_records.pop_front();
+    m_record_size -= record.size;
+    m_chunks.at(record.chunk - m_first_chunk).records--;
+
+    while (!m_chunks.empty() && m_chunks.front().records == 0) {
+        m_byte_size -= m_chunks.front().data.size();
+        drop_chunk_palette(m_chunks.front());
+        release_spilled(m_chunks.front());
+        m_chunks.pop_front();
+        m_first_chunk++;
+    }
+}
+
+void FrozenLines::pop_back()
+{
+    Q_ASSERT(!m_records.empty());
+    const Record record = m_records.back();
+    m_records.pop_back();
+    m_record_size -= record.size;
+
+    // Records are only appended, so the last one is at the end of its chunk
+    Chunk &last = chunk(record.chunk);
+    if (last.data.isEmpty()) {
+        // Could not be read back, the record is dropped from the spilled copy
+        if (!--last.records) {
+            drop_chunk_palette(last);
+            release_spilled(last);
+            m_chunks.pop_back();
+            m_palette_chunk = ~quint64(0);
+        }
+        return;
+    }
+    release_spilled(last);
+    m_byte_size -= last.data.size() - record.offset;
+    last.data.resize(record.offset);
+    last.records--;
+    if (!last.records) {
+        // What is left belongs to records already dropped from the front
+        m_byte_size -= last.data.size();
+        drop_chunk_palette(last);
+        m_chunks.pop_back();
+        // The next chunk gets the same id
+        m_palette_chunk = ~quint64(0);
+    }
+}
+
+void FrozenLines::clear()
+{
+    m_chunks.clear();
+    m_spill.clear();
+    m_decompressed_chunks.clear();
+    m_records.clear();
+    m_first_chunk = 0;
+    m_hot_first_chunk = 0;
+    m_hot_end_chunk = 0;
+    m_byte_size = 0;
+    m_record_size = 0;
+    m_palette_indexes.clear();
+    m_palette_chunk = ~quint64(0);
+}
+
+QString FrozenLines::textMid(int index, int position, int n) const
+{
+    const char *record = record_data(index);
+    const Header header = read_header(record);
+    const int size = int(header.text_size);
+    position = qBound(0, position, size);
+    if (n < 0 || n > size - position)
+        n = size - position;
+
+    const char *text = record + text_offset(header);
+    if (header.only_latin)
+        return QString::fromLatin1(text + position, n);
+    QString result(n, Qt::Uninitialized);
+    memcpy(result.data(), text + position * sizeof(QChar), n * sizeof(QChar));
+    return result;
+}
+
+// Gives the block the text and the style runs of the record. The block is
+// expected to be cleared, as one coming from the BlockPool
+void FrozenLines::thaw(int index, Block *block)
+{
+    const char *record = record_data(index);
+    const Header header = read_header(record);
+    const int size = int(header.text_size);
+    const char *runs = record + sizeof(Header);
+    const char *text = record + text_offset(header);
+    const QVector<TextStyle> &palette = m_chunks.at(m_records.at(index).chunk - m_first_chunk).palette;
+
+    if (header.only_latin) {
+        m_text = QString::fromLatin1(text, size);
+    } else {
+        m_text.resize(size);
+        memcpy(m_text.data(), text, size * sizeof(QChar));
+    }
+
+    m_styles.resize(0);
+    int start = 0;
+    for (quint32 i = 0; i < header.run_count; i++) {
+        Run run;
+        memcpy(&run.length, runs + i * RunSize, sizeof(run.length));
+        memcpy(&run.style, runs + i * RunSize + sizeof(run.length), sizeof(run.style));
+        const int length = int(run.length);
+        const TextStyle &style = palette.at(run.style);
+        quint16 id = m_style_table->intern(style);
+        // The table is full of styles in use, the closest one stands in
+        if (id == TextStyle::InvalidId)
+            id = m_style_table->closest(style);
+        m_styles.append(TextStyleLine(id, start, start + length - 1));
+        start += length;
+    }
+
+    block->setContent(m_text, m_styles, header.only_latin, 0, size - 1);
+}
+
+FrozenLines::Header FrozenLines::read_header(const char *record)
+{
+    Header header;
+    memcpy(&header, record, sizeof(header));
+    return header;
+}
+
+int FrozenLines::text_offset(const Header &header)
+{
+    return int(sizeof(Header) + header.run_count * RunSize);
+}
+
+// Copies the style with the id to the palette of the chunk the first time
+// the chunk uses it
+quint16 FrozenLines::palette_index(quint64 chunk_id, Chunk &chunk, quint16 style_id)
+{
+    if (chunk_id != m_palette_chunk || m_style_table->generation() != m_palette_generation) {
+        m_palette_indexes.clear();
+        m_palette_chunk = chunk_id;
+        m_palette_generation = m_style_table->generation();
+    }
+    auto it = m_palette_indexes.constFind(style_id);
+    if (it != m_palette_indexes.constEnd())
+        return it.value();
+
+    // A chunk holds fewer runs than there are indexes, a record larger
+    // than a chunk gets a chunk of its own
+    Q_ASSERT(chunk.palette.size() < 0xffff);
+    const quint16 index = quint16(chunk.palette.size());
+    chunk.palette.append(m_style_table->style(style_id));
+    m_palette_indexes.insert(style_id, index);
+    m_byte_size += sizeof(TextStyle);
+    return index;
+}
+
+void FrozenLines::drop_chunk_palette(Chunk &chunk)
+{
+    m_byte_size -= chunk.palette.size() * qint64(sizeof(TextStyle));
+    chunk.palette.clear();
+}
+
+// Marks the lines in [first_index, end_index) as the ones in use, and
+// compresses the chunks that were decompressed for lines which are no longer
+// close to them
+void FrozenLines::setHotRange(int first_index, int end_index)
+{
+    if (first_index < end_index && end_index <= size()) {
+        m_hot_first_chunk = m_records.at(first_index).chunk;
+        m_hot_end_chunk = m_records.at(end_index - 1).chunk + 1;
+    } else {
+        m_hot_first_chunk = m_hot_end_chunk = 0;
+    }
+    releaseColdChunks();
+}
+
+void FrozenLines::releaseColdChunks()
+{
+    const quint64 end_chunk = m_first_chunk + m_chunks.size();
+    for (int i = 0; i < m_decompressed_chunks.size(); i++) {
+        const quint64 id = m_decompressed_chunks.at(i);
+        // The last chunk is still written to
+        if (id + 1 == end_chunk || is_hot(id))
+            continue;
+        if (id >= m_first_chunk && id < end_chunk) {
+            Chunk &cold = m_chunks.at(id - m_first_chunk);
+            if (cold.spill_offset >= 0) {
+                // The copy in the spill file is still good
+                m_byte_size -= cold.data.size();
+                cold.data = QByteArray();
+                cold.raw_size = 0;
+            } else {
+                compress_chunk(id);
+            }
+        }
+        m_decompressed_chunks.remove(i);
+        i--;
+    }
+    spill_to_limit(m_memory_limit);
+}
+
+void FrozenLines::setMemoryLimit(qint64 limit)
+{
+    m_memory_limit = limit;
+    spill_to_limit(m_memory_limit);
+}
+
+const char *FrozenLines::record_data(int index) const
+{
+    // Stands in for the records of a chunk that could not be read back
+    static const Header empty_record = { 0, 0, 1 };
+
+    const Record &record = m_records.at(index);
+    const Chunk &chunk = this->chunk(record.chunk);
+    if (chunk.data.isEmpty())
+        return reinterpret_cast<const char *>(&empty_record);
+    return chunk.data.constData() + record.offset;
+}
+
+FrozenLines::Chunk &FrozenLines::chunk(quint64 id) const
+{
+    Chunk &chunk = m_chunks.at(id - m_first_chunk);
+    if (chunk.data.isEmpty() && chunk.spill_offset >= 0) {
+        // On failure the spilled copy is kept to be tried again on the next
+        // access, and the chunk stays empty in the meantime
+        const QByteArray data = m_spill.read(chunk.spill_offset, chunk.spill_size);
+        if (data.size() != chunk.spill_size)
+            return chunk;
+        chunk.data = data;
+        chunk.raw_size = chunk.spill_raw_size;
+        m_byte_size += chunk.data.size();
+        if (!chunk.raw_size)
+            m_decompressed_chunks.append(id);
+    }
+    if (chunk.raw_size) {
+        const QByteArray raw = ChunkCodec::decompress(chunk.data, chunk.raw_size);
+        Q_ASSERT(!raw.isNull());
+        m_byte_size += raw.size() - chunk.data.size();
+        chunk.data = raw;
+        chunk.raw_size = 0;
+        m_decompressed_chunks.append(id);
+    }
+    return chunk;
+}
+
+FrozenLines::Chunk &FrozenLines::chunk_for_append(int record_size)
+{
+    if (!m_chunks.empty()) {
+        // pop_back can make a compressed chunk the last one again
+        const quint64 id = m_first_chunk + m_chunks.size() - 1;
+        Chunk &last = chunk(id);
+        // One that could not be read back is left as it is
+        if (!last.data.isEmpty()) {
+            if (last.data.size() + record_size <= ChunkSize) {
+                release_spilled(last);
+                return last;
+            }
+            // The chunk is full, give back what it did not use
+            last.data.squeeze();
+            if (is_hot(id))
+                m_decompressed_chunks.append(id);
+            else
+                compress_chunk(id);
+        }
+    }
+    m_chunks.push_back(Chunk{ QByteArray(), 0, 0, -1, 0, 0 });
+    m_chunks.back().data.reserve(std::max(int(ChunkSize), record_size));
+    spill_to_limit(m_memory_limit);
+    return m_chunks.back();
+}
+
+bool FrozenLines::is_hot(quint64 id) const
+{
+    return m_hot_first_chunk < m_hot_end_chunk
+            && id + HotMargin >= m_hot_first_chunk && id < m_hot_end_chunk + HotMargin;
+}
+
+void FrozenLines::compress_chunk(quint64 id)
+{
+    Chunk &chunk = m_chunks.at(id - m_first_chunk);
+    if (chunk.raw_size || chunk.data.isEmpty())
+        return;
+    QByteArray packed = ChunkCodec::compress(chunk.data);
+    // Not worth it for data that does not compress
+    if (packed.size() >= chunk.data.size())
+        return;
+    m_byte_size += packed.size() - chunk.data.size();
+    chunk.raw_size = chunk.data.size();
+    chunk.data = packed;
+}
+
+void FrozenLines::release_spilled(Chunk &chunk) const
+{
+    if (chunk.spill_offset < 0)
+        return;
+    m_spill.release(chunk.spill_offset, chunk.spill_size);
+    chunk.spill_offset = -1;
+    chunk.spill_size = 0;
+    chunk.spill_raw_size = 0;
+}
+
+// Moves the oldest chunks that are not in use to the spill file until the
+// chunks in memory fit in the limit again
+void FrozenLines::spill_to_limit(qint64 limit)
+{
+    const quint64 last = m_first_chunk + m_chunks.size() - 1;
+    for (quint64 id = m_first_chunk; id < last && m_byte_size > limit; id++) {
+        Chunk &chunk = m_chunks.at(id - m_first_chunk);
+        if (chunk.data.isEmpty() || is_hot(id))
+            continue;
+        compress_chunk(id);
+        if (chunk.spill_offset < 0) {
+            const qint64 offset = m_spill.append(chunk.data);
+            if (offset < 0)
+                return;
+            chunk.spill_offset = offset;
+            chunk.spill_size = chunk.data.size();
+            chunk.spill_raw_size = chunk.raw_size;
+        }
+        m_byte_size -= chunk.data.size();
+        chunk.data = QByteArray();
+    }
+}
@@ -0,0 +1,161 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#ifndef FROZEN_LINES_H
+#define FROZEN_LINES_H
+
+#include "spill_file.h"
+#include "text_style.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <deque>
+
+class Block;
+class StyleTable;
+
+// Packed, immutable copies of the blocks in the scrollback. Each block is
+// written as one record with its text, as Latin-1 when possible, and the
+// lengths and styles of its style runs. Records are appended to large chunks
+// which are dropped as the lines fall out of the front of the scrollback.
+// Every chunk has a palette with copies of the styles its records use, and
+// the runs refer to the palette, so the ids of the StyleTable can be given to
+// other styles while the records still use them. A Block is only recreated
+// from a record when the line is shown or given back to the screen.
+//
+// Full chunks that are more than HotMargin chunks away from the lines in use
+// are compressed, and decompressed again when one of their records is read.
+// When the chunks take more than the memory limit the oldest ones are moved
+// to a SpillFile and read back from it when needed.
+class FrozenLines
+{
+public:
+    enum { ChunkSize = 64 * 1024, HotMargin = 2 };
+    static const qint64 DefaultMemoryLimit = 32 * 1024 * 1024;
+
+    FrozenLines(StyleTable *style_table);
+
+    int size() const { return int(m_records.size()); }
+    bool isEmpty() const { return m_records.empty(); }
+    // Bytes held in memory, after compression and spilling
+    qint64 byteSize() const { return m_byte_size; }
+    // Bytes of text and style runs in the records, however they are held
+    qint64 recordSize() const { return m_record_size; }
+    qint64 spilledSize() const { return m_spill.liveBytes(); }
+
+    qint64 memoryLimit() const { return m_memory_limit; }
+    void setMemoryLimit(qint64 limit);
+    // Moves all the chunks which are not in use to the spill file
+    void spill() { spill_to_limit(0); }
+
+    void push_back(Block *block);
+    void pop_front();
+    void pop_back();
+    void clear();
+
+    int textSize(int index) const { return m_records.at(index).text_size; }
+    QString textMid(int index, int position, int n = -1) const;
+    void thaw(int index, Block *block);
+
+    void setHotRange(int first_index, int end_index);
+    // Compresses or evicts the chunks read since the hot range was set
+    void releaseColdChunks();
+
+private:
+    struct Header
+    {
+        quint32 text_size;
+        quint32 run_count;
+        quint32 only_latin;
+    };
+    struct Run
+    {
+        quint32 length;
+        // Index in the palette of the chunk while written, id in the
+        // StyleTable while collected from the block
+        quint16 style;
+    };
+    enum { RunSize = sizeof(quint32) + sizeof(quint16) };
+
+    struct Chunk
+    {
+        QByteArray data;
+        int records;
+        // Size of the data when decompressed, 0 if it is not compressed
+        int raw_size;
+        // Copy of the data in the spill file, -1 if there is none. The data
+        // is only kept in memory when it is in use
+        qint64 spill_offset;
+        int spill_size;
+        int spill_raw_size;
+        // Never spilled or compressed
+        QVector<TextStyle> palette;
+    };
+    struct Record
+    {
+        quint64 chunk;
+        int offset;
+        int text_size;
+        int size;
+    };
+
+    static Header read_header(const char *record);
+    static int text_offset(const Header &header);
+    const char *record_data(int index) const;
+    Chunk &chunk(quint64 id) const;
+    Chunk &chunk_for_append(int record_size);
+    bool is_hot(quint64 id) const;
+    void compress_chunk(quint64 id);
+    void release_spilled(Chunk &chunk) const;
+    void spill_to_limit(qint64 limit);
+    quint16 palette_index(quint64 chunk_id, Chunk &chunk, quint16 style_id);
+    void drop_chunk_palette(Chunk &chunk);
+
+    StyleTable *m_style_table;
+    // Reading a record decompresses its chunk
+    mutable std::deque<Chunk> m_chunks;
+    mutable QVector<quint64> m_decompressed_chunks;
+    mutable qint64 m_byte_size;
+    qint64 m_record_size;
+    mutable SpillFile m_spill;
+    qint64 m_memory_limit;
+    std::deque<Record> m_records;
+    quint64 m_first_chunk;
+    quint64 m_hot_first_chunk;
+    quint64 m_hot_end_chunk;
+
+    QVector<Run> m_runs;
+    // Palette indexes of the StyleTable ids written to the last chunk, for
+    // as long as the ids keep their style
+    QHash<quint16, quint16> m_palette_indexes;
+    quint64 m_palette_chunk;
+    quint32 m_palette_generation;
+    QString m_text;
+    QVector<TextStyleLine> m_styles;
+};
+
+#endif // FROZEN_LINES_H
@@ -0,0 +1,217 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/QVector>
+
+// Line counts of a sequence of blocks in a Fenwick tree, so both the first
+// line of a block and the block holding a line are found in O(log n).
+// Blocks are appended at the back and dropped from either end like the
+// scrollback does. Dropping from the front only moves the first position,
+// the tree is rebuilt from position zero when the back reaches its capacity.
+class LineIndex
+{
+public:
+    inline LineIndex();
+
+    inline void clear();
+    inline void reset(QVector<int> lines);
+    int size() const { return m_end - m_first; }
+    qint64 totalLines() const { return m_total; }
+
+    inline void push_back(int lines);
+    inline void pop_front();
+    inline void pop_back();
+    inline void setLines(int index, int lines);
+    inline int lines(int index) const;
+
+    inline qint64 lineForIndex(int index) const;
+    inline int indexForLine(qint64 line, int *line_in_block = nullptr) const;
+
+private:
+    inline void add(int position, qint64 delta);
+    inline qint64 prefix(int position) const;
+    inline void rebuild(int capacity);
+    inline void build_tree();
+    static inline int capacity_for(int size);
+
+    QVector<qint64> m_tree;
+    QVector<int> m_lines;
+    int m_first;
+    int m_end;
+    qint64 m_total;
+};
+
+LineIndex::LineIndex()
+    : m_first(0)
+    , m_end(0)
+    , m_total(0)
+{
+    rebuild(16);
+}
+
+void LineIndex::clear()
+{
+    m_first = 0;
+    m_end = 0;
+    m_total = 0;
+    rebuild(16);
+}
+
+// Replaces all the line counts, in linear time
+void LineIndex::reset(QVector<int> lines)
+{
+    m_first = 0;
+    m_end = lines.size();
+    m_total = 0;
+    for (int i = 0; i < lines.size(); i++)
+        m_total += lines.at(i);
+    lines.resize(capacity_for(m_end));
+    m_lines.swap(lines);
+    build_tree();
+}
+
+void LineIndex::push_back(int lines)
+{
+    if (m_end == m_lines.size())
+        rebuild(capacity_for(size()));
+    m_lines[m_end] = lines;
+    add(m_end, lines);
+    m_end++;
+    m_total += lines;
+}
+
+void LineIndex::pop_front()
+{
+    Q_ASSERT(size());
+    m_total -= m_lines.at(m_first);
+    add(m_first, -m_lines.at(m_first));
+    m_lines[m_first] = 0;
+    m_first++;
+}
+
+void LineIndex::pop_back()
+{
+    Q_ASSERT(size());
+    m_end--;
+    m_total -= m_lines.at(m_end);
+    add(m_end, -m_lines.at(m_end));
+    m_lines[m_end] = 0;
+}
+
+void LineIndex::setLines(int index, int lines)
+{
+    Q_ASSERT(index >= 0 && index < size());
+    const int position = m_first + index;
+    const int delta = lines - m_lines.at(position);
+    if (!delta)
+        return;
+    m_lines[position] = lines;
+    add(position, delta);
+    m_total += delta;
+}
+
+int LineIndex::lines(int index) const
+{
+    Q_ASSERT(index >= 0 && index < size());
+    return m_lines.at(m_first + index);
+}
+
+// First line of the block at index, or the total when index is size()
+qint64 LineIndex::lineForIndex(int index) const
+{
+    Q_ASSERT(index >= 0 && index <= size());
+    return prefix(m_first + index) - prefix(m_first);
+}
+
+// Returns size() when line is past the last block
+int LineIndex::indexForLine(qint64 line, int *line_in_block) const
+{
+    if (line < 0 || line >= m_total)
+        return size();
+    // Descend to the last position where the prefix is still at most line
+    qint64 remaining = line + prefix(m_first);
+    int position = 0;
+    for (int step = m_lines.size(); step; step >>= 1) {
+        const int next = position + step;
+        if (next <= m_lines.size() && m_tree.at(next) <= remaining) {
+            position = next;
+            remaining -= m_tree.at(next);
+        }
+    }
+    if (line_in_block)
+        *line_in_block = int(remaining);
+    return position - m_first;
+}
+
+void LineIndex::add(int position, qint64 delta)
+{
+    for (int i = position + 1; i <= m_lines.size(); i += i & -i)
+        m_tree[i] += delta;
+}
+
+qint64 LineIndex::prefix(int position) const
+{
+    qint64 sum = 0;
+    for (int i = position; i > 0; i -= i & -i)
+        sum += m_tree.at(i);
+    return sum;
+}
+
+void LineIndex::rebuild(int capacity)
+{
+    QVector<int> lines(capacity, 0);
+    for (int i = m_first; i < m_end; i++)
+        lines[i - m_first] = m_lines.at(i);
+    m_end -= m_first;
+    m_first = 0;
+    m_lines.swap(lines);
+    build_tree();
+}
+
+// Linear time construction, each node passes its sum on to its parent
+void LineIndex::build_tree()
+{
+    const int capacity = m_lines.size();
+    m_tree.fill(0, capacity + 1);
+    for (int i = 1; i <= capacity; i++) {
+        m_tree[i] += m_lines.at(i - 1);
+        const int parent = i + (i & -i);
+        if (parent <= capacity)
+            m_tree[parent] += m_tree.at(i);
+    }
+}
+
+int LineIndex::capacity_for(int size)
+{
+    int capacity = 16;
+    while (capacity < size * 2)
+        capacity *= 2;
+    return capacity;
+}
+
+#endif // LINE_INDEX_H
@@ -0,0 +1,112 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#include "memory_governor.h"
+
+#include "screen.h"
+
+#include <algorithm>
+
+MemoryGovernor *MemoryGovernor::instance()
+{
+    static MemoryGovernor governor;
+    return &governor;
+}
+
+MemoryGovernor::MemoryGovernor()
+    : m_budget(DefaultBudget)
+    , m_enforcing(false)
+{
+}
+
+void MemoryGovernor::registerScreen(Screen *screen)
+{
+    if (!m_screens.contains(screen))
+        m_screens.append(screen);
+}
+
+void MemoryGovernor::unregisterScreen(Screen *screen)
+{
+    m_screens.removeOne(screen);
+}
+
+void MemoryGovernor::touch(Screen *screen)
+{
+    if (!m_screens.isEmpty() && m_screens.last() == screen)
+        return;
+    const int index = m_screens.indexOf(screen);
+    if (index < 0)
+        return;
+    m_screens.remove(index);
+    m_screens.append(screen);
+}
+
+void MemoryGovernor::setBudget(qint64 budget)
+{
+    m_budget = std::max(budget, qint64(0));
+    enforce();
+}
+
+qint64 MemoryGovernor::totalUsage() const
+{
+    qint64 usage = 0;
+    for (const Screen *screen : m_screens)
+        usage += screen->memoryUsage();
+    return usage;
+}
+
+void MemoryGovernor::enforce()
+{
+    // Screens giving up memory must not start another round
+    if (m_enforcing)
+        return;
+    qint64 usage = totalUsage();
+    if (usage <= m_budget)
+        return;
+    m_enforcing = true;
+
+    const QVector<Screen *> screens = m_screens;
+    for (int step = 0; step < StepCount && usage > m_budget; step++) {
+        for (Screen *screen : screens) {
+            if (usage <= m_budget)
+                break;
+            const qint64 before = screen->memoryUsage();
+            switch (step) {
+            case ReleaseCaches:
+                screen->releaseCaches();
+                break;
+            case SpillScrollback:
+                screen->spillScrollback();
+                break;
+            case TruncateScrollback:
+                screen->truncateScrollback(usage - m_budget);
+                break;
+            default:
+                break;
+            }
+            usage -= before - screen->memoryUsage();
+        }
+    }
+
+    m_enforcing = false;
+}
@@ -0,0 +1,73 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef MEMORY_GOVERNOR_H
+#define MEMORY_GOVERNOR_H
+
+#include <QtCore/QVector>
+
+class Screen;
+
+// Keeps the memory used by all the screens in the process within one budget.
+// Screens are kept in the order they were last viewed, and when the total is
+// over budget the screens viewed longest ago give up memory first: caches
+// are released, then the scrollback is spilled to disk, and only as a last
+// resort the oldest scrollback is dropped.
+class MemoryGovernor
+{
+public:
+    static const qint64 DefaultBudget = qint64(512) * 1024 * 1024;
+    // Rough cost of a Text and the QML item showing it
+    enum { TextObjectCost = 2048 };
+
+    static MemoryGovernor *instance();
+
+    void registerScreen(Screen *screen);
+    void unregisterScreen(Screen *screen);
+
+    // Marks the screen as the one viewed most recently
+    void touch(Screen *screen);
+
+    qint64 budget() const { return m_budget; }
+    void setBudget(qint64 budget);
+
+    qint64 totalUsage() const;
+    void enforce();
+
+private:
+    enum Step {
+        ReleaseCaches,
+        SpillScrollback,
+        TruncateScrollback,
+        StepCount
+    };
+
+    MemoryGovernor();
+
+    // Least recently viewed first
+    QVector<Screen *> m_screens;
+    qint64 m_budget;
+    bool m_enforcing;
+};
+
+#endif // MEMORY_GOVERNOR_H
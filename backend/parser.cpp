@@ -27,6 +27,7 @@
 #include "screen.h"
 #include "cursor.h"
 #include "nrc_text_codec.h"
+#include "text_scanner.h"
 
 #include <QtCore/QTextCodec>
 #include <QtCore/QDebug>
@@ -122,28 +123,266 @@ static const QByteArray getByteArrayMidNoCopy(const QByteArray &array, int start
     const char *data_at_start = array.data() + start;
     return QByteArray::fromRawData(data_at_start, length);
 }
-static void printParameters(const QVector<int> &parameters, QDebug &debug, bool dec_private = false)
+static void printParameters(const CsiParameters &parameters, QDebug &debug, bool dec_private = false)
 {
     if (dec_private)
         debug << "?";
     for (int i = 0; i < parameters.size(); i++) {
         if (i == 0)
             debug << " ";
+        else if (parameters.isSubParameter(i))
+            debug << ":";
         else
             debug << ";";
         debug << parameters.at(i);
     }
 }
 
+namespace CsiFunction {
+enum CsiFunction {
+    Unhandled,
+    ICH,
+    CUU,
+    CUD,
+    CUF,
+    CUB,
+    CHA,
+    CUP,
+    ED,
+    EL,
+    IL,
+    DL,
+    SU,
+    SD,
+    DCH,
+    PrimaryDA,
+    SecondaryDA,
+    VPA,
+    HVP,
+    TBC,
+    SM,
+    DECSET,
+    RM,
+    DECRST,
+    SGR,
+    DECSTBM
+};
+}
+
+namespace EscFunction {
+enum EscFunction {
+    Unhandled,
+    DECSC,
+    DECRC,
+    DECKPAM,
+    DECKPNM,
+    IND,
+    NEL,
+    HTS,
+    RI,
+    ST,
+    DECALN,
+    SCS_G0,
+    SCS_G1,
+    SCS_G2,
+    SCS_G3
+};
+}
+
+// Each entry holds the action in the low nibble and the next state in the high
+// nibble, NoTransition meaning the parser stays in the current state without
+// running exit and entry actions
+struct ParserTransitionTable
+{
+    uchar entries[Parser::StateCount][256];
+
+    constexpr ParserTransitionTable()
+        : entries()
+    {
+        for (int state = 0; state < Parser::StateCount; state++) {
+            for (int character = 0; character < 256; character++)
+                set(state, character, Parser::Ignore);
+        }
+
+        for (int state = 0; state < Parser::StateCount; state++) {
+            if (state == Parser::DcsEntry || state == Parser::DcsParam || state == Parser::DcsIntermediate
+                    || state == Parser::DcsPassthrough || state == Parser::DcsIgnore
+                    || state == Parser::OscString || state == Parser::SosPmApcString)
+                continue;
+            setC0(state, Parser::Execute);
+        }
+
+        setRange(Parser::Ground, 0x20, 0xff, Parser::Print);
+
+        setRange(Parser::Escape, 0x20, 0x2f, Parser::Collect, Parser::EscapeIntermediate);
+        setRange(Parser::Escape, 0x30, 0x7e, Parser::EscDispatch, Parser::Ground);
+        set(Parser::Escape, 'P', Parser::Ignore, Parser::DcsEntry);
+        set(Parser::Escape, 'X', Parser::Ignore, Parser::SosPmApcString);
+        set(Parser::Escape, '[', Parser::Ignore, Parser::CsiEntry);
+        set(Parser::Escape, ']', Parser::Ignore, Parser::OscString);
+        set(Parser::Escape, '^', Parser::Ignore, Parser::SosPmApcString);
+        set(Parser::Escape, '_', Parser::Ignore, Parser::SosPmApcString);
+
+        setRange(Parser::EscapeIntermediate, 0x20, 0x2f, Parser::Collect);
+        setRange(Parser::EscapeIntermediate, 0x30, 0x7e, Parser::EscDispatch, Parser::Ground);
+
+        // Colon is accepted as a parameter separator since it is used for
+        // sub parameters by SGR
+        setRange(Parser::CsiEntry, 0x20, 0x2f, Parser::Collect, Parser::CsiIntermediate);
+        setRange(Parser::CsiEntry, 0x30, 0x3b, Parser::Param, Parser::CsiParam);
+        setRange(Parser::CsiEntry, 0x3c, 0x3f, Parser::Collect, Parser::CsiParam);
+        setRange(Parser::CsiEntry, 0x40, 0x7e, Parser::CsiDispatch, Parser::Ground);
+
+        setRange(Parser::CsiParam, 0x20, 0x2f, Parser::Collect, Parser::CsiIntermediate);
+        setRange(Parser::CsiParam, 0x30, 0x3b, Parser::Param);
+        setRange(Parser::CsiParam, 0x3c, 0x3f, Parser::Ignore, Parser::CsiIgnore);
+        setRange(Parser::CsiParam, 0x40, 0x7e, Parser::CsiDispatch, Parser::Ground);
+
+        setRange(Parser::CsiIntermediate, 0x20, 0x2f, Parser::Collect);
+        setRange(Parser::CsiIntermediate, 0x30, 0x3f, Parser::Ignore, Parser::CsiIgnore);
+        setRange(Parser::CsiIntermediate, 0x40, 0x7e, Parser::CsiDispatch, Parser::Ground);
+
+        setRange(Parser::CsiIgnore, 0x40, 0x7e, Parser::Ignore, Parser::Ground);
+
+        setRange(Parser::DcsEntry, 0x20, 0x2f, Parser::Collect, Parser::DcsIntermediate);
+        setRange(Parser::DcsEntry, 0x30, 0x39, Parser::Param, Parser::DcsParam);
+        set(Parser::DcsEntry, 0x3a, Parser::Ignore, Parser::DcsIgnore);
+        set(Parser::DcsEntry, 0x3b, Parser::Param, Parser::DcsParam);
+        setRange(Parser::DcsEntry, 0x3c, 0x3f, Parser::Collect, Parser::DcsParam);
+        setRange(Parser::DcsEntry, 0x40, 0x7e, Parser::Ignore, Parser::DcsPassthrough);
+
+        setRange(Parser::DcsParam, 0x20, 0x2f, Parser::Collect, Parser::DcsIntermediate);
+        setRange(Parser::DcsParam, 0x30, 0x39, Parser::Param);
+        set(Parser::DcsParam, 0x3a, Parser::Ignore, Parser::DcsIgnore);
+        set(Parser::DcsParam, 0x3b, Parser::Param);
+        setRange(Parser::DcsParam, 0x3c, 0x3f, Parser::Ignore, Parser::DcsIgnore);
+        setRange(Parser::DcsParam, 0x40, 0x7e, Parser::Ignore, Parser::DcsPassthrough);
+
+        setRange(Parser::DcsIntermediate, 0x20, 0x2f, Parser::Collect);
+        setRange(Parser::DcsIntermediate, 0x30, 0x3f, Parser::Ignore, Parser::DcsIgnore);
+        setRange(Parser::DcsIntermediate, 0x40, 0x7e, Parser::Ignore, Parser::DcsPassthrough);
+
+        setC0(Parser::DcsPassthrough, Parser::Put);
+        setRange(Parser::DcsPassthrough, 0x20, 0x7e, Parser::Put);
+        setRange(Parser::DcsPassthrough, 0x80, 0xff, Parser::Put);
+
+        // BEL terminates OSC strings in xterm. Everything above 0x7f is
+        // passed on since the title is utf-8
+        set(Parser::OscString, C0::BEL, Parser::Ignore, Parser::Ground);
+        setRange(Parser::OscString, 0x20, 0xff, Parser::OscPut);
+
+        for (int state = 0; state < Parser::StateCount; state++) {
+            set(state, 0x7f, state == Parser::Ground ? Parser::Print : Parser::Ignore);
+            set(state, C0::CAN, Parser::Execute, Parser::Ground);
+            set(state, C0::SUB, Parser::Execute, Parser::Ground);
+            set(state, C0::ESC, Parser::Ignore, Parser::Escape);
+        }
+        setRange(Parser::OscString, 0x7f, 0x7f, Parser::OscPut);
+        setRange(Parser::DcsPassthrough, 0x7f, 0x7f, Parser::Ignore);
+    }
+
+    constexpr void set(int state, int character, Parser::Action action, int next = Parser::NoTransition)
+    {
+        entries[state][character] = uchar(action | (next << 4));
+    }
+
+    constexpr void setRange(int state, int first, int last, Parser::Action action, int next = Parser::NoTransition)
+    {
+        for (int character = first; character <= last; character++)
+            set(state, character, action, next);
+    }
+
+    constexpr void setC0(int state, Parser::Action action)
+    {
+        for (int character = 0; character < C0::C0_END; character++)
+            set(state, character, action);
+    }
+};
+
+static constexpr ParserTransitionTable transition_table;
+
+// The dispatch tables are keyed on (private marker, intermediate, final byte).
+// Index 0 of the marker and intermediate dimensions means none was collected
+struct ParserDispatchTable
+{
+    uchar csi[5][17][64];
+    uchar esc[17][80];
+
+    constexpr ParserDispatchTable()
+        : csi()
+        , esc()
+    {
+        csi[0][0][FinalBytesNoIntermediate::ICH - 0x40] = CsiFunction::ICH;
+        csi[0][0][FinalBytesNoIntermediate::CUU - 0x40] = CsiFunction::CUU;
+        csi[0][0][FinalBytesNoIntermediate::CUD - 0x40] = CsiFunction::CUD;
+        csi[0][0][FinalBytesNoIntermediate::CUF - 0x40] = CsiFunction::CUF;
+        csi[0][0][FinalBytesNoIntermediate::CUB - 0x40] = CsiFunction::CUB;
+        csi[0][0][FinalBytesNoIntermediate::CHA - 0x40] = CsiFunction::CHA;
+        csi[0][0][FinalBytesNoIntermediate::CUP - 0x40] = CsiFunction::CUP;
+        csi[0][0][FinalBytesNoIntermediate::ED - 0x40] = CsiFunction::ED;
+        csi[0][0][FinalBytesNoIntermediate::EL - 0x40] = CsiFunction::EL;
+        csi[0][0][FinalBytesNoIntermediate::IL - 0x40] = CsiFunction::IL;
+        csi[0][0][FinalBytesNoIntermediate::DL - 0x40] = CsiFunction::DL;
+        csi[0][0][FinalBytesNoIntermediate::SU - 0x40] = CsiFunction::SU;
+        csi[0][0][FinalBytesNoIntermediate::SD - 0x40] = CsiFunction::SD;
+        csi[0][0][FinalBytesNoIntermediate::DCH - 0x40] = CsiFunction::DCH;
+        csi[0][0][FinalBytesNoIntermediate::DA - 0x40] = CsiFunction::PrimaryDA;
+        csi[0][0][FinalBytesNoIntermediate::VPA - 0x40] = CsiFunction::VPA;
+        csi[0][0][FinalBytesNoIntermediate::HVP - 0x40] = CsiFunction::HVP;
+        csi[0][0][FinalBytesNoIntermediate::TBC - 0x40] = CsiFunction::TBC;
+        csi[0][0][FinalBytesNoIntermediate::SM - 0x40] = CsiFunction::SM;
+        csi[0][0][FinalBytesNoIntermediate::RM - 0x40] = CsiFunction::RM;
+        csi[0][0][FinalBytesNoIntermediate::SGR - 0x40] = CsiFunction::SGR;
+        csi[0][0][FinalBytesNoIntermediate::DECSTBM - 0x40] = CsiFunction::DECSTBM;
+
+        csi[markerIndex('>')][0][FinalBytesNoIntermediate::DA - 0x40] = CsiFunction::SecondaryDA;
+
+        // DECSED and DECSEL are treated as their non selective counterparts
+        csi[markerIndex('?')][0][FinalBytesNoIntermediate::ED - 0x40] = CsiFunction::ED;
+        csi[markerIndex('?')][0][FinalBytesNoIntermediate::EL - 0x40] = CsiFunction::EL;
+        csi[markerIndex('?')][0][FinalBytesNoIntermediate::SM - 0x40] = CsiFunction::DECSET;
+        csi[markerIndex('?')][0][FinalBytesNoIntermediate::RM - 0x40] = CsiFunction::DECRST;
+
+        esc[0][C1_7bit::DECSC - 0x30] = EscFunction::DECSC;
+        esc[0][C1_7bit::DECRC - 0x30] = EscFunction::DECRC;
+        esc[0]['=' - 0x30] = EscFunction::DECKPAM;
+        esc[0]['>' - 0x30] = EscFunction::DECKPNM;
+        esc[0][C1_7bit::IND - 0x30] = EscFunction::IND;
+        esc[0][C1_7bit::NEL - 0x30] = EscFunction::NEL;
+        esc[0][C1_7bit::HTS - 0x30] = EscFunction::HTS;
+        esc[0][C1_7bit::RI - 0x30] = EscFunction::RI;
+        esc[0][C1_7bit::ST - 0x30] = EscFunction::ST;
+
+        esc[intermediateIndex('#')]['8' - 0x30] = EscFunction::DECALN;
+
+        for (int final_byte = 0x30; final_byte < 0x7f; final_byte++) {
+            esc[intermediateIndex(C1_7bit::SCS_G0)][final_byte - 0x30] = EscFunction::SCS_G0;
+            esc[intermediateIndex(C1_7bit::SCS_G1)][final_byte - 0x30] = EscFunction::SCS_G1;
+            esc[intermediateIndex(C1_7bit::SCS_G2)][final_byte - 0x30] = EscFunction::SCS_G2;
+            esc[intermediateIndex(C1_7bit::SCS_G3)][final_byte - 0x30] = EscFunction::SCS_G3;
+        }
+    }
+
+    static constexpr int markerIndex(uchar marker)
+    {
+        return marker ? marker - 0x3b : 0;
+    }
+
+    static constexpr int intermediateIndex(uchar intermediate)
+    {
+        return intermediate ? intermediate - 0x1f : 0;
+    }
+};
+
+static constexpr ParserDispatchTable dispatch_table;
+
 Parser::Parser(Screen *screen)
-    : m_decode_state(PlainText)
-    , m_decode_osc_state(None)
+    : m_state(Ground)
     , m_current_token_start(0)
     , m_current_position(0)
-    , m_intermediate_char(QChar())
-    , m_parameters_expecting_more(false)
-    , m_dec_mode(false)
-    , m_gt_param(false)
+    , m_private_marker(0)
+    , m_intermediate_char(0)
+    , m_intermediate_count(0)
     , m_lnm_mode_set(false)
     , m_contains_only_latin(true)
     , m_screen(screen)
@@ -152,777 +391,623 @@ Parser::Parser(Screen *screen)
         m_graphic_codecs[i] = QTextCodec::codecForName("utf-8");
     }
 
+    // Reserved so that truncating the buffer between strings keeps the allocation
+    m_osc_data.reserve(256);
+
     NrcTextCodec::initialize();
 }
 
 void Parser::addData(const QByteArray &data)
 {
+    m_commands.clear();
+
+    // A utf-8 sequence split by the previous read is completed by this one
+    const int resume_position = m_incomplete_sequence.size();
+    if (resume_position) {
+        m_current_data = m_incomplete_sequence + data;
+        m_incomplete_sequence.clear();
+    } else {
+        m_current_data = data;
+    }
     m_current_token_start = 0;
-    m_current_data = data;
-
-    for (m_current_position = 0; m_current_position < m_current_data.size(); m_current_position++) {
-        uchar character = m_current_data.at(m_current_position);
-        if (character > 127)
-            m_utf8_decoder.addChar(character);
-        switch (m_decode_state) {
-        case PlainText:
-            if (character < C0::C0_END || m_utf8_decoder.isC1()) {
-                if (m_current_position != m_current_token_start) {
-                    const QByteArray to_insert = getByteArrayMidNoCopy(m_current_data, m_current_token_start, m_current_position - m_current_token_start);
-                    qCDebug(lcParser) << "Parser Insert text:" << to_insert;
-                    m_screen->currentCursor()->addAtCursor(to_insert, m_contains_only_latin);
-                    tokenFinished();
-                    m_current_token_start--;
+
+    const uchar *data_begin = reinterpret_cast<const uchar *>(m_current_data.constData());
+    const uchar *data_end = data_begin + m_current_data.size();
+
+    for (m_current_position = resume_position; m_current_position < m_current_data.size(); m_current_position++) {
+        uchar character = data_begin[m_current_position];
+        if (m_state == Ground) {
+            if (character < 0x80 && m_utf8_decoder.isInSequence()) {
+                // Truncated sequence, the cursor will show it as a replacement character
+                m_utf8_decoder.clear();
+                m_contains_only_latin = false;
+            }
+            if (character >= C0::C0_END && character < 0x80) {
+                // Printable ascii is just accumulated into the current token, so jump
+                // straight to the next byte that might end it
+                const uchar *next = TextScanner::findNonPrintable(data_begin + m_current_position + 1, data_end);
+                m_current_position = int(next - data_begin) - 1;
+                continue;
+            }
+            if (character >= 0x80) {
+                switch (m_utf8_decoder.addChar(character)) {
+                case Utf8Decoder::Accept:
+                    if (m_utf8_decoder.isC1()) {
+                        // The lead byte of the encoded C1 control is not part of the text
+                        flushText(m_current_position - 1);
+                        m_current_token_start = m_current_position + 1;
+                        handleC1(m_utf8_decoder.codePoint());
+                    } else {
+                        m_contains_only_latin = m_contains_only_latin && m_utf8_decoder.isLatin();
+                    }
+                    break;
+                case Utf8Decoder::Reject:
+                    m_contains_only_latin = false;
+                    break;
+                default:
+                    break;
                 }
-                m_decode_state = DecodeC0;
-                decodeC0(m_current_data.at(m_current_position));
+                continue;
             }
-            m_contains_only_latin = m_contains_only_latin && m_utf8_decoder.isLatin();
-            break;
-        case DecodeC0:
-            decodeC0(character);
-            break;
-        case DecodeC1_7bit:
-            decodeC1_7bit(character);
-            break;
-        case DecodeCSI:
-            decodeCSI(character);
-            break;
-        case DecodeOSC:
-            decodeOSC(character);
-            break;
-        case DecodeCharacterSet:
-            decodeCharacterSet(character);
-            break;
-        case DecodeFontSize:
-            decodeFontSize(character);
-            break;
-       }
+        }
+        processByte(character);
     }
-    if (m_decode_state == PlainText) {
-        QByteArray to_insert = getByteArrayMidNoCopy(m_current_data, m_current_token_start, m_current_data.size() - m_current_token_start);
-        if (to_insert.size()) {
-            qCDebug(lcParser) << "Parser Insert text:" << to_insert;
-            m_screen->currentCursor()->addAtCursor(to_insert, m_contains_only_latin);
-            tokenFinished();
+
+    if (m_state == Ground) {
+        int text_end = m_current_data.size();
+        if (m_utf8_decoder.isInSequence()) {
+            // Hold back the incomplete sequence so only whole characters are
+            // passed on to the cursor
+            text_end--;
+            while (text_end > m_current_token_start && (data_begin[text_end] & 0xc0) == 0x80)
+                text_end--;
+            // A deep copy, as the data can be the read buffer of the pty
+            // which is reused for the next read
+            m_incomplete_sequence = QByteArray(m_current_data.constData() + text_end,
+                                               m_current_data.size() - text_end);
         }
+        flushText(text_end);
     }
     m_current_data = QByteArray();
 }
 
-void Parser::decodeC0(uchar character)
+const CommandBuffer &Parser::commands() const
+{
+    return m_commands;
+}
+
+void Parser::processByte(uchar character)
+{
+    const uchar entry = transition_table.entries[m_state][character];
+    const Action action = Action(entry & 0x0f);
+    const State next_state = State(entry >> 4);
+
+    if (m_state == Ground && action != Print)
+        flushText(m_current_position);
+
+    if (next_state == NoTransition) {
+        performAction(action, character);
+    } else {
+        enterState(next_state, action, character);
+    }
+
+    if (m_state != Ground || action != Print)
+        m_current_token_start = m_current_position + 1;
+}
+
+void Parser::performAction(Action action, uchar character)
+{
+    switch (action) {
+    case Ignore:
+    case Print:
+        break;
+    case Execute:
+        execute(character);
+        break;
+    case Clear:
+        clear();
+        break;
+    case Collect:
+        collect(character);
+        break;
+    case Param:
+        param(character);
+        break;
+    case EscDispatch:
+        escDispatch(character);
+        break;
+    case CsiDispatch:
+        csiDispatch(character);
+        break;
+    case Hook:
+    case Put:
+    case Unhook:
+        break;
+    case OscStart:
+        m_osc_data.resize(0);
+        break;
+    case OscPut:
+        m_osc_data.append(character);
+        break;
+    case OscEnd:
+        oscDispatch();
+        break;
+    case ActionCount:
+        break;
+    }
+}
+
+void Parser::enterState(State state, Action action, uchar character)
+{
+    switch (m_state) {
+    case OscString:
+        performAction(OscEnd, character);
+        break;
+    case DcsPassthrough:
+        performAction(Unhook, character);
+        break;
+    default:
+        break;
+    }
+
+    performAction(action, character);
+
+    m_state = state;
+
+    switch (m_state) {
+    case Escape:
+    case CsiEntry:
+    case DcsEntry:
+        performAction(Clear, character);
+        break;
+    case OscString:
+        performAction(OscStart, character);
+        break;
+    case DcsPassthrough:
+        performAction(Hook, character);
+        break;
+    default:
+        break;
+    }
+}
+
+void Parser::handleC1(uint code_point)
+{
+    // An 8-bit control is equivalent to ESC followed by the control minus 0x40
+    processByte(C0::ESC);
+    processByte(code_point - 0x40);
+}
+
+void Parser::flushText(int end)
+{
+    if (end > m_current_token_start) {
+        const QByteArray to_insert = getByteArrayMidNoCopy(m_current_data, m_current_token_start, end - m_current_token_start);
+        qCDebug(lcParser) << "Parser Insert text:" << to_insert;
+        m_commands.appendText(ScreenCommand::Print, to_insert.constData(), to_insert.size(), m_contains_only_latin);
+    }
+    m_current_token_start = end;
+    m_contains_only_latin = true;
+}
+
+void Parser::execute(uchar character)
 {
     qCDebug(lcParser) << C0::C0(character);
     switch (character) {
-    case C0::NUL:
-    case C0::SOH:
-    case C0::STX:
-    case C0::ETX:
-    case C0::EOT:
-    case C0::ENQ:
-    case C0::ACK:
-        qCWarning(lcParser) << "Unhandled" << C0::C0(character);
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
-        break;
     case C0::BEL:
-        m_screen->scheduleFlash();
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
+        m_commands.append(ScreenCommand::Flash);
         break;
     case C0::BS:
-        m_screen->currentCursor()->moveLeft();
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
+        m_commands.append(ScreenCommand::MoveLeft, 1);
         break;
     case C0::HT:
-        m_screen->currentCursor()->moveToNextTab();
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
+        m_commands.append(ScreenCommand::MoveToNextTab);
         break;
     case C0::LF:
     case C0::VT:
     case C0::FF:
         if (m_lnm_mode_set)
-            m_screen->currentCursor()->moveBeginningOfLine();
-        m_screen->currentCursor()->lineFeed();
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
+            m_commands.append(ScreenCommand::CarriageReturn);
+        m_commands.appendLineFeed();
         break;
     case C0::CR:
-        m_screen->currentCursor()->moveBeginningOfLine();
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
+        m_commands.append(ScreenCommand::CarriageReturn);
         break;
     case C0::SOorLS1:
-        m_screen->currentCursor()->setTextCodec(m_graphic_codecs[1]);
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
+        m_commands.appendTextCodec(m_graphic_codecs[1]);
         break;
     case C0::SIorLS0:
-        m_screen->currentCursor()->setTextCodec(m_graphic_codecs[0]);
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
-        break;
-    case C0::DLE:
-    case C0::DC1:
-    case C0::DC2:
-    case C0::DC3:
-    case C0::DC4:
-    case C0::NAK:
-    case C0::SYN:
-    case C0::ETB:
-    case C0::CAN:
-    case C0::EM:
-    case C0::SUB:
+        m_commands.appendTextCodec(m_graphic_codecs[0]);
+        break;
+    default:
         qCWarning(lcParser) << "Unhandled" << C0::C0(character);
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
         break;
-    case C0::ESC:
-        if (m_decode_state != DecodeC0) {
-            tokenFinished();
-            break;
-        }
-        m_decode_state = DecodeC1_7bit;
+    }
+}
+
+void Parser::clear()
+{
+    m_private_marker = 0;
+    m_intermediate_char = 0;
+    m_intermediate_count = 0;
+
+    m_parameters.clear();
+}
+
+void Parser::collect(uchar character)
+{
+    if (character >= 0x3c && character <= 0x3f) {
+        m_private_marker = character;
+        return;
+    }
+
+    if (!m_intermediate_count)
+        m_intermediate_char = character;
+    else
+        qCWarning(lcParser) << "multiple intermediate bytes found in control sequence";
+    m_intermediate_count++;
+}
+
+void Parser::param(uchar character)
+{
+    switch (character) {
+    case 0x3a:
+        m_parameters.addSeparator(true);
         break;
-        if (m_decode_state != DecodeC0)
-            tokenFinished();
+    case 0x3b:
+        m_parameters.addSeparator(false);
         break;
-    case C0::IS4:
-    case C0::IS3:
-    case C0::IS2:
-    case C0::IS1:
     default:
-        qCWarning(lcParser) << "Unhandled" << C0::C0(character);
-        if (m_decode_state == DecodeC0)
-            tokenFinished();
+        m_parameters.addDigit(character);
         break;
     }
 }
 
-void Parser::decodeC1_7bit(uchar character)
+void Parser::escDispatch(uchar character)
 {
-    qCDebug(lcParser) << C1_7bit::C1_7bit(character);
-    switch(character) {
-    case C1_7bit::ESC:
-        tokenFinished();
+    uchar function = EscFunction::Unhandled;
+    if (m_intermediate_count < 2)
+        function = dispatch_table.esc[ParserDispatchTable::intermediateIndex(m_intermediate_char)][character - 0x30];
+
+    switch (function) {
+    case EscFunction::DECSC:
+        m_commands.append(ScreenCommand::SaveCursor);
+        break;
+    case EscFunction::DECRC:
+        m_commands.append(ScreenCommand::RestoreCursor);
         break;
-    case '#':
-        m_decode_state = DecodeFontSize;
+    case EscFunction::DECKPAM:
+        qCDebug(lcParser) << "Application keypad";
         break;
-    case C1_7bit::SCS_G0:
-        m_decode_state = DecodeCharacterSet;
-        m_decode_graphics_set = 0;
+    case EscFunction::DECKPNM:
+        qCDebug(lcParser) << "Normal keypad mode";
         break;
-    case C1_7bit::SCS_G1:
-        m_decode_state = DecodeCharacterSet;
-        m_decode_graphics_set = 1;
+    case EscFunction::IND:
+        m_commands.append(ScreenCommand::MoveDown, 1);
         break;
-    case C1_7bit::SCS_G2:
-        m_decode_state = DecodeCharacterSet;
-        m_decode_graphics_set = 2;
+    case EscFunction::NEL:
+        m_commands.append(ScreenCommand::CarriageReturn);
+        m_commands.appendLineFeed();
         break;
-    case C1_7bit::SCS_G3:
-        m_decode_state = DecodeCharacterSet;
-        m_decode_graphics_set = 3;
+    case EscFunction::HTS:
+        m_commands.append(ScreenCommand::SetTabStop);
         break;
-    case C1_7bit::DECSC:
-        m_screen->saveCursor();
-        tokenFinished();
+    case EscFunction::RI:
+        m_commands.append(ScreenCommand::ReverseLineFeed);
         break;
-    case C1_7bit::DECRC:
-        m_screen->restoreCursor();
-        tokenFinished();
+    case EscFunction::ST:
         break;
-    case '=':
-        qCDebug(lcParser) << "Application keypad";
-        tokenFinished();
+    case EscFunction::DECALN:
+        qCDebug(lcParser) << "Filling screen with 'E'";
+        m_commands.append(ScreenCommand::Fill, 'E');
+        break;
+    case EscFunction::SCS_G0:
+    case EscFunction::SCS_G1:
+    case EscFunction::SCS_G2:
+    case EscFunction::SCS_G3:
+        designateCharacterSet(function - EscFunction::SCS_G0, character);
         break;
-    case '>':
-        qCDebug(lcParser) << "Normal keypad mode";
-        tokenFinished();
-        break;
-    case C1_7bit::NOT_DEFINED:
-    case C1_7bit::NOT_DEFINED1:
-    case C1_7bit::BPH:
-    case C1_7bit::NBH:
-        qCWarning(lcParser) << "Unhandled" << C1_7bit::C1_7bit(character);
-        tokenFinished();
-        break;
-    case C1_7bit::IND:
-        m_screen->currentCursor()->moveDown();
-        tokenFinished();
-        break;
-    case C1_7bit::NEL:
-        m_screen->currentCursor()->moveBeginningOfLine();
-        m_screen->currentCursor()->lineFeed();
-        tokenFinished();
-        break;
-    case C1_7bit::SSA:
-    case C1_7bit::ESA:
-        qCWarning(lcParser) << "Unhandled" << C1_7bit::C1_7bit(character);
-        tokenFinished();
-        break;
-    case C1_7bit::HTS:
-        m_screen->currentCursor()->setTabStop();
-        tokenFinished();
-        break;
-    case C1_7bit::HTJ:
-    case C1_7bit::VTS:
-    case C1_7bit::PLD:
-    case C1_7bit::PLU:
-        qCWarning(lcParser) << "Unhandled" << C1_7bit::C1_7bit(character);
-        tokenFinished();
-        break;
-    case C1_7bit::RI:
-        m_screen->currentCursor()->reverseLineFeed();
-        tokenFinished();
-        break;
-    case C1_7bit::SS2:
-    case C1_7bit::SS3:
-    case C1_7bit::DCS:
-    case C1_7bit::PU1:
-    case C1_7bit::PU2:
-    case C1_7bit::STS:
-    case C1_7bit::CCH:
-    case C1_7bit::MW :
-    case C1_7bit::SPA:
-    case C1_7bit::EPA:
-    case C1_7bit::SOS:
-    case C1_7bit::NOT_DEFINED3:
-    case C1_7bit::SCI:
-        qCWarning(lcParser) << "Unhandled" << C1_7bit::C1_7bit(character);
-        tokenFinished();
-        break;
-    case C1_7bit::CSI:
-        m_decode_state = DecodeCSI;
-        break;
-    case C1_7bit::ST :
-        qCWarning(lcParser) << "Unhandled" << C1_7bit::C1_7bit(character);
-        tokenFinished();
-        break;
-    case C1_7bit::OSC:
-        m_decode_state = DecodeOSC;
-        break;
-    case C1_7bit::PM :
-    case C1_7bit::APC:
     default:
-        qCWarning(lcParser) << "Unhandled" << C1_7bit::C1_7bit(character);
-        tokenFinished();
+        if (m_intermediate_count)
+            qCWarning(lcParser) << "Unhandled escape sequence" << char(m_intermediate_char) << char(character);
+        else
+            qCWarning(lcParser) << "Unhandled" << C1_7bit::C1_7bit(character);
         break;
     }
 }
 
-void Parser::decodeParameters(uchar character)
+void Parser::csiDispatch(uchar character)
 {
-    switch (character) {
-    case 0x30:
-    case 0x31:
-    case 0x32:
-    case 0x33:
-    case 0x34:
-    case 0x35:
-    case 0x36:
-    case 0x37:
-    case 0x38:
-    case 0x39:
-        m_parameter_string.append(character);
+    uchar function = CsiFunction::Unhandled;
+    if (m_intermediate_count < 2) {
+        function = dispatch_table.csi[ParserDispatchTable::markerIndex(m_private_marker)]
+                                     [ParserDispatchTable::intermediateIndex(m_intermediate_char)]
+                                     [character - 0x40];
+    }
+
+    if (lcParser().isDebugEnabled()) {
+        QDebug debug = qDebug();
+        if (m_intermediate_count)
+            debug << FinalBytesSingleIntermediate::FinalBytesSingleIntermediate(character);
+        else
+            debug << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
+        printParameters(m_parameters, debug, m_private_marker == '?');
+    }
+
+    switch (function) {
+    case CsiFunction::ICH: {
+        int n_chars = m_parameters.size() ? m_parameters.at(0) : 1;
+        m_commands.append(ScreenCommand::InsertBlanks, n_chars);
+    }
         break;
-    case 0x3a:
-        qCDebug(lcParser) << "Encountered special delimiter in parameterbyte";
+    case CsiFunction::CUU: {
+        Q_ASSERT(m_parameters.size() < 2);
+        int move_up = m_parameters.size() ? m_parameters.at(0) : 1;
+        m_commands.append(ScreenCommand::MoveUp, move_up ? move_up : 1);
+    }
         break;
-    case 0x3b:
-        if (!m_parameter_string.size()) {
-            m_parameters.append(INT_MIN);
+    case CsiFunction::CUD: {
+        int move_down = m_parameters.size() ? m_parameters.at(0) : 1;
+        m_commands.append(ScreenCommand::MoveDown, move_down ? move_down : 1);
+    }
+        break;
+    case CsiFunction::CUF:{
+        Q_ASSERT(m_parameters.size() < 2);
+        int move_right = m_parameters.size() ? m_parameters.at(0) : 1;
+        m_commands.append(ScreenCommand::MoveRight, move_right ? move_right : 1);
+    }
+        break;
+    case CsiFunction::CUB: {
+        Q_ASSERT(m_parameters.size() < 2);
+        int move_left = m_parameters.size() ? m_parameters.at(0) : 1;
+        m_commands.append(ScreenCommand::MoveLeft, move_left ? move_left : 1);
+    }
+        break;
+    case CsiFunction::CHA: {
+        Q_ASSERT(m_parameters.size() < 2);
+        handleDefaultParameters(1);
+        int move_to_pos_on_line = m_parameters.size() ? m_parameters.at(0) : 1;
+        m_commands.append(ScreenCommand::MoveToCharacter, move_to_pos_on_line - 1);
+    }
+        break;
+    case CsiFunction::CUP:
+    case CsiFunction::HVP:
+        Q_ASSERT(m_parameters.size() <= 2);
+        handleDefaultParameters(1);
+        if (!m_parameters.size()) {
+            m_commands.append(ScreenCommand::MoveOrigin);
+        } else if (m_parameters.size() == 2){
+                m_commands.append(ScreenCommand::Move, m_parameters.at(1) - 1, m_parameters.at(0) - 1);
+        } else if (m_parameters.size() == 1){
+                m_commands.append(ScreenCommand::Move, m_parameters.at(0) - 1, 0);
+        }
+        break;
+    case CsiFunction::ED:
+        if (!m_parameters.size()) {
+            m_commands.append(ScreenCommand::ClearToEndOfScreen);
         } else {
-            appendParameter();
+            int param = m_parameters.size() ? m_parameters.at(0) : 0;
+            switch (param) {
+            case 0:
+                m_commands.append(ScreenCommand::ClearToEndOfScreen);
+                break;
+            case 1:
+                m_commands.append(ScreenCommand::ClearToBeginningOfScreen);
+                break;
+            case 2:
+                m_commands.append(ScreenCommand::ClearScreen);
+                break;
+            default:
+                qCWarning(lcParser) << "Invalid parameter value for FinalBytesNoIntermediate::ED";
+            }
         }
-        m_parameters_expecting_more = true;
         break;
-    case 0x3c:
-    case 0x3d:
-        appendParameter();
-        qCWarning(lcParser) << "Parameter decoding INVALID RANGE" << char(character);
-        m_parameters.append(-character);
+    case CsiFunction::EL:
+        if (!m_parameters.size() || m_parameters.at(0) == 0) {
+            m_commands.append(ScreenCommand::ClearToEndOfLine);
+        } else if (m_parameters.at(0) == 1) {
+            m_commands.append(ScreenCommand::ClearToBeginningOfLine);
+        } else if (m_parameters.at(0) == 2) {
+            m_commands.append(ScreenCommand::ClearLine);
+        } else{
+            qCWarning(lcParser) << "Fault when processing FinalBytesNoIntermediate::EL";
+        }
         break;
-    case 0x3e:
-        if (m_parameters.size() == 0 && m_parameter_string.size() == 0) {
-            m_gt_param = true;
-        } else {
-            appendParameter();
-            qCWarning(lcParser) << "unknown parameter state";
+    case CsiFunction::IL: {
+        int count = 1;
+        if (m_parameters.size()) {
+            count = m_parameters.at(0);
         }
+        m_commands.append(ScreenCommand::InsertLines, count);
+    }
         break;
-    case 0x3f:
-        if (m_parameters.size() == 0 && m_parameter_string.size() == 0) {
-            m_dec_mode = true;
-        } else {
-            appendParameter();
-            qCWarning(lcParser) << "unknown parameter state";
+    case CsiFunction::DL: {
+        int count = 1;
+        if (m_parameters.size()) {
+            count = m_parameters.at(0);
         }
+        m_commands.append(ScreenCommand::DeleteLines, count);
+    }
         break;
-    default:
-        //this is undefined for now
-        qCWarning(lcParser) << "Encountered undefined parameter byte";
+    case CsiFunction::SU:
+    case CsiFunction::SD: {
+        handleDefaultParameters(1);
+        const int count = m_parameters.size() ? m_parameters.at(0) : 1;
+        m_commands.append(function == CsiFunction::SU ? ScreenCommand::ScrollUp : ScreenCommand::ScrollDown, count);
+    }
         break;
+    case CsiFunction::DCH:{
+        Q_ASSERT(m_parameters.size() < 2);
+        int n_chars = m_parameters.size() ? m_parameters.at(0) : 1;
+        m_commands.append(ScreenCommand::DeleteCharacters, n_chars);
     }
-}
-
-void Parser::decodeCSI(uchar character)
-{
-        if (character < C0::C0_END) {
-            decodeC0(character);
-            return;
+        break;
+    case CsiFunction::PrimaryDA:
+        m_commands.append(ScreenCommand::SendPrimaryDA);
+        break;
+    case CsiFunction::SecondaryDA:
+        m_commands.append(ScreenCommand::SendSecondaryDA);
+        break;
+    case CsiFunction::VPA: {
+        Q_ASSERT(m_parameters.size() < 2);
+        handleDefaultParameters(1);
+        int move_to_line = m_parameters.size() ? m_parameters.at(0) -1 : 0;
+        m_commands.append(ScreenCommand::MoveToLine, move_to_line);
+    }
+        break;
+    case CsiFunction::TBC:
+        if (!m_parameters.size() || m_parameters.at(0) == 0) {
+            m_commands.append(ScreenCommand::RemoveTabStop);
+        } else if (m_parameters.at(0) == 3) {
+            m_commands.append(ScreenCommand::ClearTabStops);
         }
-
-        if (character >= 0x30 && character <= 0x3f) {
-            decodeParameters(character);
-        } else {
-            appendParameter();
-            if (character >= 0x20 && character <= 0x2f) {
-                if (m_intermediate_char.unicode())
-                    qCWarning(lcParser) << "double intermediate bytes found in CSI";
-                m_intermediate_char = character;
-            } else if (character >= 0x40 && character <= 0x7d) {
-                if (m_intermediate_char.unicode()) {
-                    if (lcParser().isDebugEnabled()) {
-                        QDebug debug = qDebug();
-                        debug << FinalBytesSingleIntermediate::FinalBytesSingleIntermediate(character);
-                        printParameters(m_parameters, debug, m_dec_mode);
-                    }
-                    switch (character) {
-                    case FinalBytesSingleIntermediate::SL:
-                    case FinalBytesSingleIntermediate::SR:
-                    case FinalBytesSingleIntermediate::GSM:
-                    case FinalBytesSingleIntermediate::GSS:
-                    case FinalBytesSingleIntermediate::FNT:
-                    case FinalBytesSingleIntermediate::TSS:
-                    case FinalBytesSingleIntermediate::JFY:
-                    case FinalBytesSingleIntermediate::SPI:
-                    case FinalBytesSingleIntermediate::QUAD:
-                    case FinalBytesSingleIntermediate::SSU:
-                    case FinalBytesSingleIntermediate::PFS:
-                    case FinalBytesSingleIntermediate::SHS:
-                    case FinalBytesSingleIntermediate::SVS:
-                    case FinalBytesSingleIntermediate::IGS:
-                    case FinalBytesSingleIntermediate::IDCS:
-                    case FinalBytesSingleIntermediate::PPA:
-                    case FinalBytesSingleIntermediate::PPR:
-                    case FinalBytesSingleIntermediate::PPB:
-                    case FinalBytesSingleIntermediate::SPD:
-                    case FinalBytesSingleIntermediate::DTA:
-                    case FinalBytesSingleIntermediate::SHL:
-                    case FinalBytesSingleIntermediate::SLL:
-                    case FinalBytesSingleIntermediate::FNK:
-                    case FinalBytesSingleIntermediate::SPQR:
-                    case FinalBytesSingleIntermediate::SEF:
-                    case FinalBytesSingleIntermediate::PEC:
-                    case FinalBytesSingleIntermediate::SSW:
-                    case FinalBytesSingleIntermediate::SACS:
-                    case FinalBytesSingleIntermediate::SAPV:
-                    case FinalBytesSingleIntermediate::STAB:
-                    case FinalBytesSingleIntermediate::GCC:
-                    case FinalBytesSingleIntermediate::TATE:
-                    case FinalBytesSingleIntermediate::TALE:
-                    case FinalBytesSingleIntermediate::TAC:
-                    case FinalBytesSingleIntermediate::TCC:
-                    case FinalBytesSingleIntermediate::TSR:
-                    case FinalBytesSingleIntermediate::SCO:
-                    case FinalBytesSingleIntermediate::SRCS:
-                    case FinalBytesSingleIntermediate::SCS:
-                    case FinalBytesSingleIntermediate::SLS:
-                    case FinalBytesSingleIntermediate::SCP:
-                    default:
-                        qCWarning(lcParser) << "unhandled CSI" << FinalBytesSingleIntermediate::FinalBytesSingleIntermediate(character);
-                        break;
-                    }
-                    tokenFinished();
-                } else {
-                    if (lcParser().isDebugEnabled()) {
-                        QDebug debug = qDebug();
-                        debug << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        printParameters(m_parameters, debug, m_dec_mode);
-                    }
-                    switch (character) {
-                    case FinalBytesNoIntermediate::ICH: {
-                        int n_chars = m_parameters.size() ? m_parameters.at(0) : 1;
-                        QByteArray empty(n_chars, ' ');
-                        m_screen->currentCursor()->insertAtCursor(empty);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::CUU: {
-                        Q_ASSERT(m_parameters.size() < 2);
-                        int move_up = m_parameters.size() ? m_parameters.at(0) : 1;
-                        m_screen->currentCursor()->moveUp(move_up ? move_up : 1);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::CUD: {
-                        int move_down = m_parameters.size() ? m_parameters.at(0) : 1;
-                        m_screen->currentCursor()->moveDown(move_down ? move_down : 1);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::CUF:{
-                        Q_ASSERT(m_parameters.size() < 2);
-                        int move_right = m_parameters.size() ? m_parameters.at(0) : 1;
-                        m_screen->currentCursor()->moveRight(move_right ? move_right : 1);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::CUB: {
-                        Q_ASSERT(m_parameters.size() < 2);
-                        int move_left = m_parameters.size() ? m_parameters.at(0) : 1;
-                        m_screen->currentCursor()->moveLeft(move_left ? move_left : 1);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::CNL:
-                    case FinalBytesNoIntermediate::CPL:
-                        qCWarning(lcParser) << "unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        break;
-                    case FinalBytesNoIntermediate::CHA: {
-                        Q_ASSERT(m_parameters.size() < 2);
-                        handleDefaultParameters(1);
-                        int move_to_pos_on_line = m_parameters.size() ? m_parameters.at(0) : 1;
-                        m_screen->currentCursor()->moveToCharacter(move_to_pos_on_line - 1);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::CUP:
-                        handleDefaultParameters(1);
-                        if (!m_parameters.size()) {
-                            m_screen->currentCursor()->moveOrigin();
-                        } else if (m_parameters.size() == 2){
-                                m_screen->currentCursor()->move(m_parameters.at(1) - 1, m_parameters.at(0) - 1);
-                        } else if (m_parameters.size() == 1){
-                                m_screen->currentCursor()->move(m_parameters.at(0) - 1, 0);
-                        }
-                        break;
-                    case FinalBytesNoIntermediate::CHT:
-                        qCWarning(lcParser) << "unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        break;
-                    case FinalBytesNoIntermediate::ED:
-                        if (!m_parameters.size()) {
-                            m_screen->currentCursor()->clearToEndOfScreen();
-                        } else {
-                            int param = m_parameters.size() ? m_parameters.at(0) : 0;
-                            switch (param) {
-                            case 0:
-                                m_screen->currentCursor()->clearToEndOfScreen();
-                                break;
-                            case 1:
-                                m_screen->currentCursor()->clearToBeginningOfScreen();
-                                break;
-                            case 2:
-                                m_screen->clearScreen();
-                                break;
-                            default:
-                                qCWarning(lcParser) << "Invalid parameter value for FinalBytesNoIntermediate::ED";
-                            }
-                        }
-
-                        break;
-                    case FinalBytesNoIntermediate::EL:
-                        if (!m_parameters.size() || m_parameters.at(0) == 0) {
-                            m_screen->currentCursor()->clearToEndOfLine();
-                        } else if (m_parameters.at(0) == 1) {
-                            m_screen->currentCursor()->clearToBeginningOfLine();
-                        } else if (m_parameters.at(0) == 2) {
-                            m_screen->currentCursor()->clearLine();
-                        } else{
-                            qCWarning(lcParser) << "Fault when processing FinalBytesNoIntermediate::EL";
-                        }
-                        break;
-                    case FinalBytesNoIntermediate::IL: {
-                        int count = 1;
-                        if (m_parameters.size()) {
-                            count = m_parameters.at(0);
-                        }
-                        m_screen->currentCursor()->scrollUp(count);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::DL: {
-                        int count = 1;
-                        if (m_parameters.size()) {
-                            count = m_parameters.at(0);
-                        }
-                        m_screen->currentCursor()->scrollDown(count);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::EF:
-                    case FinalBytesNoIntermediate::EA:
-                        qCWarning(lcParser) << "unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        break;
-                    case FinalBytesNoIntermediate::DCH:{
-                        Q_ASSERT(m_parameters.size() < 2);
-                        int n_chars = m_parameters.size() ? m_parameters.at(0) : 1;
-                        m_screen->currentCursor()->deleteCharacters(n_chars);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::SSE:
-                    case FinalBytesNoIntermediate::CPR:
-                    case FinalBytesNoIntermediate::SU:
-                    case FinalBytesNoIntermediate::SD:
-                    case FinalBytesNoIntermediate::NP:
-                    case FinalBytesNoIntermediate::PP:
-                    case FinalBytesNoIntermediate::CTC:
-                    case FinalBytesNoIntermediate::ECH:
-                    case FinalBytesNoIntermediate::CVT:
-                    case FinalBytesNoIntermediate::CBT:
-                    case FinalBytesNoIntermediate::SRS:
-                    case FinalBytesNoIntermediate::PTX:
-                    case FinalBytesNoIntermediate::SDS:
-                    case FinalBytesNoIntermediate::SIMD:
-                    case FinalBytesNoIntermediate::HPA:
-                    case FinalBytesNoIntermediate::HPR:
-                    case FinalBytesNoIntermediate::REP:
-                        qCWarning(lcParser) << "unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        break;
-                    case FinalBytesNoIntermediate::DA:
-                        if (m_gt_param) {
-                            m_screen->sendSecondaryDA();
-                        } else {
-                            m_screen->sendPrimaryDA();
-                        }
-                        break;
-                    case FinalBytesNoIntermediate::VPA: {
-                        Q_ASSERT(m_parameters.size() < 2);
-                        handleDefaultParameters(1);
-                        int move_to_line = m_parameters.size() ? m_parameters.at(0) -1 : 0;
-                        m_screen->currentCursor()->moveToLine(move_to_line);
-                    }
-                        break;
-                    case FinalBytesNoIntermediate::VPR:
-                        qCWarning(lcParser) << "unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        break;
-                    case FinalBytesNoIntermediate::HVP: {
-                        Q_ASSERT(m_parameters.size() <= 2);
-                        handleDefaultParameters(1);
-                        if (!m_parameters.size()) {
-                            m_screen->currentCursor()->moveOrigin();
-                        } else if (m_parameters.size() == 2){
-                                m_screen->currentCursor()->move(m_parameters.at(1) - 1, m_parameters.at(0) - 1);
-                        } else if (m_parameters.size() == 1){
-                                m_screen->currentCursor()->move(m_parameters.at(0) - 1, 0);
-                        }
-                        break;
-                    }
-                    case FinalBytesNoIntermediate::TBC:
-                        if (!m_parameters.size() || m_parameters.at(0) == 0) {
-                            m_screen->currentCursor()->removeTabStop();
-                        } else if (m_parameters.at(0) == 3) {
-                            m_screen->currentCursor()->clearTabStops();
-                        }
-                        break;
-                    case FinalBytesNoIntermediate::SM:
-                        if (!m_parameters.size()) {
-                            qCWarning(lcParser) << FinalBytesNoIntermediate::SM << "called without parameter";
-                            break;
-                        }
-                        for (int i = 0; i < m_parameters.size(); i++) {
-                            if (m_dec_mode) {
-                                setDecMode(m_parameters.at(i));
-                            } else {
-                                setMode(m_parameters.at(i));
-                            }
-                        }
-                        break;
-                    case FinalBytesNoIntermediate::MC:
-                    case FinalBytesNoIntermediate::HPB:
-                    case FinalBytesNoIntermediate::VPB:
-                        qCWarning(lcParser) << "unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        break;
-                    case FinalBytesNoIntermediate::RM:
-                        if (!m_parameters.size()) {
-                            qCWarning(lcParser) << FinalBytesNoIntermediate::RM << "called without parameter";
-                            break;
-                        }
-                        for (int i = 0; i < m_parameters.size(); i++) {
-                            if (m_dec_mode) {
-                                resetDecMode(m_parameters.at(i));
-                            } else {
-                                resetMode(m_parameters.at(i));
-                            }
-                        }
-
-                        break;
-                    case FinalBytesNoIntermediate::SGR:
-                        handleDefaultParameters(0);
-                        if (!m_parameters.size())
-                            m_parameters << 0;
-                        handleSGR();
-                        break;
-                    case FinalBytesNoIntermediate::DSR:
-                        qCDebug(lcParser) << "report";
-                    case FinalBytesNoIntermediate::DAQ:
-                    case FinalBytesNoIntermediate::Reserved0:
-                    case FinalBytesNoIntermediate::Reserved1:
-                        qCWarning(lcParser) << "Unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        break;
-                    case FinalBytesNoIntermediate::DECSTBM:
-                        if (m_parameters.size() == 2) {
-                            if (m_parameters.at(0) >= 0) {
-                                m_screen->currentCursor()->setScrollArea(m_parameters.at(0) - 1,m_parameters.at(1) - 1);
-                            } else {
-                                qCWarning(lcParser)<< "Unknown value for scrollRegion" << m_parameters.at(0);
-                            }
-                        } else {
-                            m_screen->currentCursor()->resetScrollArea();
-                        }
-                        m_screen->currentCursor()->moveOrigin();
-                        break;
-                    case FinalBytesNoIntermediate::Reserved3:
-                    case FinalBytesNoIntermediate::Reserved4:
-                    case FinalBytesNoIntermediate::Reserved5:
-                    case FinalBytesNoIntermediate::Reserved6:
-                    case FinalBytesNoIntermediate::Reserved7:
-                    case FinalBytesNoIntermediate::Reserved8:
-                    case FinalBytesNoIntermediate::Reserved9:
-                    case FinalBytesNoIntermediate::Reserveda:
-                    case FinalBytesNoIntermediate::Reservedb:
-                    case FinalBytesNoIntermediate::Reservedc:
-                    case FinalBytesNoIntermediate::Reservedd:
-                    case FinalBytesNoIntermediate::Reservede:
-                    case FinalBytesNoIntermediate::Reservedf:
-                    default:
-                        qCWarning(lcParser) << "Unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
-                        break;
-                    }
-                    tokenFinished();
-                }
-            }
+        break;
+    case CsiFunction::SM:
+    case CsiFunction::DECSET:
+        if (!m_parameters.size()) {
+            qCWarning(lcParser) << FinalBytesNoIntermediate::SM << "called without parameter";
+            break;
         }
-}
-
-void Parser::decodeOSC(uchar character)
-{
-    if (m_decode_osc_state == None) {
-        if (!m_parameters.size() &&
-                character >= 0x30 && character <= 0x3f) {
-            decodeParameters(character);
-        } else {
-            m_osc_data.append(character);
-            appendParameter();
-            if (m_parameters.size() == 0) {
-                return;
-            } else if (m_parameters.size() > 1) {
-                qCDebug(lcParser) << m_parameters;
-                tokenFinished();
-                return;
-            }
-
-            switch (m_parameters.at(0)) {
-                case 0:
-                    m_decode_osc_state = ChangeWindowAndIconName;
-                    break;
-                case 1:
-                    m_decode_osc_state = ChangeIconTitle;
-                    break;
-                case 2:
-                    m_decode_osc_state = ChangeWindowTitle;
-                    break;
-                case 7:
-                    m_decode_osc_state = FilePath;
-                    break;
-                default:
-                    m_decode_osc_state = Unknown;
-                    qCWarning(lcParser) << "Unknown parameter state" << m_parameters.at(0);
-                    break;
+        for (int i = 0; i < m_parameters.size(); i++) {
+            if (function == CsiFunction::DECSET) {
+                setDecMode(m_parameters.at(i));
+            } else {
+                setMode(m_parameters.at(i));
             }
         }
-    } else {
-        if (character == 0x07) {
-            if (m_decode_osc_state == ChangeWindowAndIconName ||
-                    m_decode_osc_state == ChangeWindowTitle) {
-                m_screen->setTitle(QString::fromUtf8(m_osc_data));
+        break;
+    case CsiFunction::RM:
+    case CsiFunction::DECRST:
+        if (!m_parameters.size()) {
+            qCWarning(lcParser) << FinalBytesNoIntermediate::RM << "called without parameter";
+            break;
+        }
+        for (int i = 0; i < m_parameters.size(); i++) {
+            if (function == CsiFunction::DECRST) {
+                resetDecMode(m_parameters.at(i));
+            } else {
+                resetMode(m_parameters.at(i));
             }
-            if (m_decode_osc_state == FilePath) {
-                if (m_osc_data.startsWith("file:/")) {
-                    int last_slash = m_osc_data.lastIndexOf(QChar('/'));
-                    if (last_slash >= 0 && last_slash < m_osc_data.size() - 1) {
-                        QString title = m_osc_data.mid(last_slash + 1).simplified();
-                        m_screen->setTitle(title);
-                    }
-                }
+        }
+        break;
+    case CsiFunction::SGR:
+        handleDefaultParameters(0);
+        if (!m_parameters.size())
+            m_parameters.append(0);
+        handleSGR();
+        break;
+    case CsiFunction::DECSTBM:
+        if (m_parameters.size() == 2) {
+            if (m_parameters.at(0) >= 0) {
+                m_commands.append(ScreenCommand::SetScrollArea, m_parameters.at(0) - 1,m_parameters.at(1) - 1);
+            } else {
+                qCWarning(lcParser)<< "Unknown value for scrollRegion" << m_parameters.at(0);
             }
-            tokenFinished();
         } else {
-            m_osc_data.append(character);
+            m_commands.append(ScreenCommand::ResetScrollArea);
         }
+        m_commands.append(ScreenCommand::MoveOrigin);
+        break;
+    default:
+        if (m_intermediate_count)
+            qCWarning(lcParser) << "Unhandled CSI" << FinalBytesSingleIntermediate::FinalBytesSingleIntermediate(character);
+        else
+            qCWarning(lcParser) << "Unhandled CSI" << FinalBytesNoIntermediate::FinalBytesNoIntermediate(character);
+        break;
     }
 }
 
-void Parser::decodeCharacterSet(uchar character)
+void Parser::oscDispatch()
 {
-    if (m_decode_graphics_set < 0 || m_decode_graphics_set > (int) (sizeof(m_graphic_codecs) / sizeof(*m_graphic_codecs))) {
-        qCWarning(lcParser) << "Parser state is illigal. m_decode_graphics_set is: " << m_decode_graphics_set << "array size is:" << (sizeof(m_graphic_codecs) / sizeof(*m_graphic_codecs));
-        m_decode_graphics_set = 0;
+    int separator = 0;
+    int command = 0;
+    for (; separator < m_osc_data.size() && m_osc_data.at(separator) != ';'; separator++) {
+        const char digit = m_osc_data.at(separator);
+        if (digit < '0' || digit > '9' || separator > 4)
+            break;
+        command = command * 10 + (digit - '0');
+    }
+    if (!separator || separator >= m_osc_data.size() || m_osc_data.at(separator) != ';') {
+        qCWarning(lcParser) << "Failed to decode OSC" << m_osc_data;
         return;
     }
+    const QByteArray osc_data = getByteArrayMidNoCopy(m_osc_data, separator + 1, m_osc_data.size() - separator - 1);
+
+    switch (command) {
+    case 0:
+    case 2:
+        m_commands.appendText(ScreenCommand::SetTitle, osc_data.constData(), osc_data.size());
+        break;
+    case 1:
+        break;
+    case 7:
+        if (osc_data.startsWith("file:/")) {
+            int last_slash = osc_data.lastIndexOf('/');
+            if (last_slash >= 0 && last_slash < osc_data.size() - 1) {
+                const QByteArray title = osc_data.mid(last_slash + 1).simplified();
+                m_commands.appendText(ScreenCommand::SetTitle, title.constData(), title.size());
+            }
+        }
+        break;
+    default:
+        qCWarning(lcParser) << "Unknown OSC" << command;
+        break;
+    }
+}
+
+void Parser::designateCharacterSet(int graphics_set, uchar character)
+{
     switch(character) {
         case '0':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::dec_special_graphics);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::dec_special_graphics);
             break;
         case '4':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_dutch);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_dutch);
             break;
         case '5':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_finnish);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_finnish);
             break;
         case '6':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_norwegian_danish);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_norwegian_danish);
             break;
         case '7':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_swedish);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_swedish);
             break;
         case 'A':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_british);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_british);
             break;
         case 'B':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::ascii);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::ascii);
             break;
         case 'C':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_finnish);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_finnish);
             break;
         case 'R':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_french);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_french);
             break;
         case 'Q':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_french_canadian);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_french_canadian);
             break;
         case 'K':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_german);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_german);
             break;
         case 'Y':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_italian);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_italian);
             break;
         case 'E':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_norwegian_danish);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_norwegian_danish);
             break;
         case 'Z':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_spanish);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_spanish);
             break;
         case 'H':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_swedish);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_swedish);
             break;
         case '=':
-            m_graphic_codecs[m_decode_graphics_set] = codecForCharacterset(CharacterSet::nrc_swiss);
+            m_graphic_codecs[graphics_set] = codecForCharacterset(CharacterSet::nrc_swiss);
             break;
         default:
             qCWarning(lcParser) << "unsupported character set" << character << (char) character;
     }
-    tokenFinished();
-}
-
-void Parser::decodeFontSize(uchar character)
-{
-    switch(character) {
-        case '8':
-            qCDebug(lcParser) << "Filling screen with 'E'";
-            m_screen->fill(QChar('E'));
-            break;
-        default:
-            qCWarning(lcParser) << "Failed to decode font size for" << character;
-            break;
-    }
-    tokenFinished();
 }
 
 void Parser::setMode(int mode)
@@ -933,7 +1018,7 @@ void Parser::setMode(int mode)
 //Control representation          CRM†    3
 //Insert/replace                  IRM     4
         case 4:
-            m_screen->currentCursor()->setInsertMode(Cursor::Insert);
+            m_commands.append(ScreenCommand::SetInsertMode, Cursor::Insert);
             break;
 //Status reporting transfer       SRTM*   5
 //Vertical editing                VEM*    7
@@ -963,32 +1048,28 @@ void Parser::setDecMode(int mode)
     switch (mode) {
 //1 -> Application Cursor Keys (DECCKM).
     case 1:
-        m_screen->setApplicationCursorKeysMode(true);
+        m_commands.append(ScreenCommand::SetApplicationCursorKeys, true);
         break;
 //2 -> Designate USASCII for character sets G0-G3 (DECANM), and set VT100 mode.
 //3 -> 132 Column Mode (DECCOLM).
     case 3:
-        m_screen->emitRequestWidth(132);
-        m_screen->emitRequestHeight(24);
-        m_screen->clear();
-        m_screen->currentCursor()->moveOrigin();
-        m_screen->currentCursor()->resetScrollArea();
+        m_commands.append(ScreenCommand::SetColumnMode, 132);
         break;
 //4 -> Smooth (Slow) Scroll (DECSCLM).
     case 4:
-        m_screen->setFastScroll(false);
+        m_commands.append(ScreenCommand::SetFastScroll, false);
         break;
 //5 -> Reverse Video (DECSCNM).
     case 5:
-        m_screen->colorPalette()->setInverseDefaultColors(true);
+        m_commands.append(ScreenCommand::SetInverseDefaultColors, true);
         break;
 //6 -> Origin Mode (DECOM).
     case 6:
-        m_screen->currentCursor()->setOriginAtMargin(true);
+        m_commands.append(ScreenCommand::SetOriginAtMargin, true);
         break;
 //7 -> Wraparound Mode (DECAWM).
     case 7:
-        m_screen->currentCursor()->setWrapAround(true);
+        m_commands.append(ScreenCommand::SetWrapAround, true);
         break;
 
 //8 -> Auto-repeat Keys (DECARM).
@@ -996,13 +1077,13 @@ void Parser::setDecMode(int mode)
 //10 -> Show toolbar (rxvt).
 //12 -> Start Blinking Cursor (att610).
     case 12:
-        m_screen->currentCursor()->setBlinking(true);
+        m_commands.append(ScreenCommand::SetCursorBlinking, true);
         break;
 //18 -> Print form feed (DECPFF).
 //19 -> Set print extent to full screen (DECPEX).
 //25 -> Show Cursor (DECTCEM).
     case 25:
-        m_screen->currentCursor()->setVisible(true);
+        m_commands.append(ScreenCommand::SetCursorVisible, true);
         break;
 //30 -> Show scrollbar (rxvt).
 //35 -> Enable font-shifting functions (rxvt).
@@ -1015,7 +1096,7 @@ void Parser::setDecMode(int mode)
 //46 -> Start Logging. This is normally disabled by a compile-time option.
 //47 -> Use Alternate Screen Buffer. (This may be disabled by the titeInhibit resource).
     case 47:
-        m_screen->useAlternateScreenBuffer();
+        m_commands.append(ScreenCommand::UseAlternateScreenBuffer);
         break;
 //66 -> Application keypad (DECNKM).
 //67 -> Backarrow key sends backspace (DECBKM).
@@ -1043,16 +1124,16 @@ void Parser::setDecMode(int mode)
 //1043 -> Enable raising of the window when Control-G is received. (enables the popOnBell resource).
 //1047 -> Use Alternate Screen Buffer. (This may be disabled by the titeInhibit resource).
     case 1047:
-        m_screen->useAlternateScreenBuffer();
+        m_commands.append(ScreenCommand::UseAlternateScreenBuffer);
         break;
 //1048 -> Save cursor as in DECSC. (This may be disabled by the titeInhibit resource).
     case 1048:
-        m_screen->saveCursor();
+        m_commands.append(ScreenCommand::SaveCursor);
         break;
 //1049 -> Save cursor as in DECSC and use Alternate Screen Buffer, clearing it first. (This may be disabled by the titeInhibit resource). This combines the effects of the 1047 and 1048 modes. Use this with terminfo-based applications rather than the 47 mode.
     case 1049:
-        m_screen->saveCursor();
-        m_screen->useAlternateScreenBuffer();
+        m_commands.append(ScreenCommand::SaveCursor);
+        m_commands.append(ScreenCommand::UseAlternateScreenBuffer);
         break;
 //1050 -> Set terminfo/termcap function-key mode.
 //1051 -> Set Sun function-key mode.
@@ -1074,7 +1155,7 @@ void Parser::resetMode(int mode)
 //Control representation          CRM†    3
 //Insert/replace                  IRM     4
         case 4:
-            m_screen->currentCursor()->setInsertMode(Cursor::Replace);
+            m_commands.append(ScreenCommand::SetInsertMode, Cursor::Replace);
             break;
 //Status reporting transfer       SRTM*   5
 //Vertical editing                VEM*    7
@@ -1104,45 +1185,41 @@ void Parser::resetDecMode(int mode)
 //taken from http://invisible-island.net/xterm/ctlseqs/ctlseqs.html
 //1 -> Normal Cursor Keys (DECCKM).
         case 1:
-            m_screen->setApplicationCursorKeysMode(false);
+            m_commands.append(ScreenCommand::SetApplicationCursorKeys, false);
             break;
 //2 -> Designate VT52 mode (DECANM).
 //3 -> 80 Column Mode (DECCOLM).
         case 3:
-            m_screen->emitRequestWidth(80);
-            m_screen->emitRequestHeight(24);
-            m_screen->clear();
-            m_screen->currentCursor()->moveOrigin();
-            m_screen->currentCursor()->resetScrollArea();
+            m_commands.append(ScreenCommand::SetColumnMode, 80);
             break;
 //4 -> Jump (Fast) Scroll (DECSCLM).
         case 4:
-            m_screen->setFastScroll(true);
+            m_commands.append(ScreenCommand::SetFastScroll, true);
             break;
 //5 -> Normal Video (DECSCNM).
         case 5:
-            m_screen->colorPalette()->setInverseDefaultColors(false);
+            m_commands.append(ScreenCommand::SetInverseDefaultColors, false);
             break;
 //6 -> Normal Cursor Mode (DECOM).
         case 6:
-            m_screen->currentCursor()->setOriginAtMargin(false);
+            m_commands.append(ScreenCommand::SetOriginAtMargin, false);
             break;
 //7 -> No Wraparound Mode (DECAWM).
         case 7:
-            m_screen->currentCursor()->setWrapAround(false);
+            m_commands.append(ScreenCommand::SetWrapAround, false);
             break;
 //8 -> No Auto-repeat Keys (DECARM).
 //9 -> Don’t send Mouse X & Y on button press.
 //10 -> Hide toolbar (rxvt).
 //12 -> Stop Blinking Cursor (att610).
         case 12:
-            m_screen->currentCursor()->setBlinking(false);
+            m_commands.append(ScreenCommand::SetCursorBlinking, false);
             break;
 //18 -> Don’t print form feed (DECPFF).
 //19 -> Limit print to scrolling region (DECPEX).
 //25 -> Hide Cursor (DECTCEM).
         case 25:
-            m_screen->currentCursor()->setVisible(false);
+            m_commands.append(ScreenCommand::SetCursorVisible, false);
             break;
 //30 -> Don’t show scrollbar (rxvt).
 //35 -> Disable font-shifting functions (rxvt).
@@ -1154,7 +1231,7 @@ void Parser::resetDecMode(int mode)
 //46 -> Stop Logging. (This is normally disabled by a compile-time option).
 //47 -> Use Normal Screen Buffer.
         case 47:
-            m_screen->useNormalScreenBuffer();
+            m_commands.append(ScreenCommand::UseNormalScreenBuffer);
             break;
 //66 -> Numeric keypad (DECNKM).
 //67 -> Backarrow key sends delete (DECBKM).
@@ -1182,16 +1259,16 @@ void Parser::resetDecMode(int mode)
 //1043 -> Disable raising of the window when Control-G is received. (This disables the popOnBell resource).
 //1047 -> Use Normal Screen Buffer, clearing screen first if in the Alternate Screen. (This may be disabled by the titeInhibit resource).
     case 1047:
-            m_screen->useNormalScreenBuffer();
+            m_commands.append(ScreenCommand::UseNormalScreenBuffer);
             break;
 //1048 -> Restore cursor as in DECRC. (This may be disabled by the titeInhibit resource).
     case 1048:
-            m_screen->restoreCursor();
+            m_commands.append(ScreenCommand::RestoreCursor);
             break;
 //1049 -> Use Normal Screen Buffer and restore cursor as in DECRC. (This may be disabled by the titeInhibit resource). This combines the effects of the 1047 and 1048 modes. Use this with terminfo-based applications rather than the 47 mode.
     case 1049:
-            m_screen->restoreCursor();
-            m_screen->useNormalScreenBuffer();
+            m_commands.append(ScreenCommand::RestoreCursor);
+            m_commands.append(ScreenCommand::UseNormalScreenBuffer);
             break;
 //1050 -> Reset terminfo/termcap function-key mode.
 //1051 -> Reset Sun function-key mode.
@@ -1213,34 +1290,38 @@ void Parser::handleSGR()
         switch(param) {
             case 0:
                 //                                    m_screen->setTextStyle(TextStyle::Normal);
-                m_screen->currentCursor()->resetStyle();
+                m_commands.append(ScreenCommand::ResetStyle);
                 break;
             case 1:
-                m_screen->currentCursor()->setTextStyle(TextStyle::Bold);
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Bold, true);
                 break;
             case 4:
-                m_screen->currentCursor()->setTextStyle(TextStyle::Underlined);
+                i += handleUnderlineStyle(i);
                 break;
             case 5:
-                m_screen->currentCursor()->setTextStyle(TextStyle::Blinking);
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Blinking, true);
                 break;
             case 7:
-                m_screen->currentCursor()->setTextStyle(TextStyle::Inverse);
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Inverse, true);
                 break;
             case 8:
                 qCDebug(lcParser) << "SGR: Hidden text not supported";
                 break;
             case 22:
-                m_screen->currentCursor()->setTextStyle(TextStyle::Bold, false);
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Bold, false);
+                break;
+            case 21:
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::DoubleUnderlined, true);
                 break;
             case 24:
-                m_screen->currentCursor()->setTextStyle(TextStyle::Underlined, false);
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Underlined, false);
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::DoubleUnderlined, false);
                 break;
             case 25:
-                m_screen->currentCursor()->setTextStyle(TextStyle::Blinking, false);
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Blinking, false);
                 break;
             case 27:
-                m_screen->currentCursor()->setTextStyle(TextStyle::Inverse, false);
+                m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Inverse, false);
                 break;
             case 28:
                 qCDebug(lcParser) << "SGR: Visible text is always on";
@@ -1253,10 +1334,10 @@ void Parser::handleSGR()
             case 35:
             case 36:
             case 37:
-                m_screen->currentCursor()->setTextForegroundColorIndex(ColorPalette::Color(param - 30));
+                m_commands.append(ScreenCommand::SetForegroundColorIndex, ColorPalette::Color(param - 30));
                 break;
             case 39: // Foreground Default
-                m_screen->currentCursor()->setTextForegroundColorIndex(ColorPalette::DefaultForeground);
+                m_commands.append(ScreenCommand::SetForegroundColorIndex, ColorPalette::DefaultForeground);
                 break;
             case 38:
             case 48:
@@ -1270,108 +1351,145 @@ void Parser::handleSGR()
             case 45:
             case 46:
             case 47:
-                m_screen->currentCursor()->setTextBackgroundColorIndex(ColorPalette::Color(param - 40));
+                m_commands.append(ScreenCommand::SetBackgroundColorIndex, ColorPalette::Color(param - 40));
                 break;
             case 49: // Background default
-                m_screen->currentCursor()->setTextBackgroundColorIndex(ColorPalette::DefaultBackground);
+                m_commands.append(ScreenCommand::SetBackgroundColorIndex, ColorPalette::DefaultBackground);
                 break;
             default:
                 qCWarning(lcParser) << "Unknown SGR" << param;
+                // Skip sub parameters of unknown attributes
+                i += m_parameters.subParameterCount(i);
                 break;
         }
 
     }
 }
 
-// @return additional bytes consumed beyond the default of 1
-int Parser::handleXtermColor(int param, int i) {
-    QRgb color;
-    int ret = 0;
-    switch (m_parameters.at(++i)) {
+// Handles both 38;5;n / 38;2;r;g;b and the ITU T.416 forms 38:5:n and
+// 38:2:[colour space]:r:g:b
+// @return additional parameters consumed beyond the default of 1
+int Parser::handleXtermColor(int param, int i)
+{
+    const int sub_parameters = m_parameters.subParameterCount(i);
+    const int available = sub_parameters ? sub_parameters : m_parameters.size() - i - 1;
+    if (!available) {
+        qCWarning(lcParser) << "Missing color type for SGR" << param;
+        return 0;
+    }
+
+    QRgb color = 0;
+    bool valid = false;
+    int consumed = 1;
+    switch (m_parameters.at(i + 1)) {
         case 5:
-            if (m_parameters.size() >= 3) {
-                color = m_screen->colorPalette()->xtermRgb(m_parameters.at(++i));
-                ret = 2;
+            if (available >= 2) {
+                color = m_screen->colorPalette()->xtermRgb(m_parameters.at(i + 2));
+                valid = true;
+                consumed = 2;
             } else {
-                qCWarning(lcParser) << "8-bit color bytes unexpected" << m_parameters;
+                qCWarning(lcParser) << "8-bit color bytes unexpected";
             }
             break;
-        case 2:
-            if (m_parameters.size() >= 5) {
-                color = QColor(m_parameters.at(i + 1), m_parameters.at(i + 2), m_parameters.at(i + 3)).rgb();
-                ret = 4;
+        case 2: {
+            const int first = sub_parameters >= 5 ? i + 3 : i + 2;
+            if (first + 2 <= i + available) {
+                color = QColor(m_parameters.at(first), m_parameters.at(first + 1), m_parameters.at(first + 2)).rgb();
+                valid = true;
+                consumed = first + 2 - i;
             } else {
-                qCWarning(lcParser) << "24-bit color bytes unexpected" << m_parameters;
+                qCWarning(lcParser) << "24-bit color bytes unexpected";
             }
+        }
+            break;
+        default:
+            qCWarning(lcParser) << "Unknown color type" << m_parameters.at(i + 1);
             break;
     }
-    if (param == 38)
-        m_screen->currentCursor()->setTextForegroundColor(color);
-    else
-        m_screen->currentCursor()->setTextBackgroundColor(color);
-    return ret;
-}
-
-void Parser::tokenFinished()
-{
-    m_decode_state = PlainText;
-    m_decode_osc_state = None;
-    m_osc_data.clear();
-
-    m_parameters.clear();
-    m_parameter_string.clear();
-
-    m_current_token_start = m_current_position + 1;
-    m_intermediate_char = 0;
-
-    m_parameters_expecting_more = false;
-    m_dec_mode = false;
-    m_gt_param = false;
-    m_contains_only_latin = true;
+    if (valid) {
+        if (param == 38)
+            m_commands.append(ScreenCommand::SetForegroundColor, int(color));
+        else
+            m_commands.append(ScreenCommand::SetBackgroundColor, int(color));
+    }
+    return sub_parameters ? sub_parameters : consumed;
 }
 
-void Parser::appendParameter()
+// Handles 4 and the 4:n underline styles
+// @return additional parameters consumed beyond the default of 1
+int Parser::handleUnderlineStyle(int i)
 {
-    if (m_parameter_string.size()) {
-        m_parameters.append(m_parameter_string.toUShort());
-        m_parameter_string.clear();
-        m_parameters_expecting_more = false;
+    const int sub_parameters = m_parameters.subParameterCount(i);
+    const int style = sub_parameters ? m_parameters.at(i + 1) : 1;
+    switch (style) {
+        case 0:
+            m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Underlined, false);
+            m_commands.append(ScreenCommand::SetTextStyle, TextStyle::DoubleUnderlined, false);
+            break;
+        case 2:
+            m_commands.append(ScreenCommand::SetTextStyle, TextStyle::DoubleUnderlined, true);
+            break;
+        default:
+            // Curly, dotted and dashed underlines are drawn as single underlines
+            m_commands.append(ScreenCommand::SetTextStyle, TextStyle::Underlined, true);
+            break;
     }
+    return sub_parameters;
 }
 
 void Parser::handleDefaultParameters(int defaultValue)
 {
-    for (int i = 0; i < m_parameters.size(); i++) {
-        if (m_parameters.at(i) == INT_MIN)
-            m_parameters.replace(i, defaultValue);
-    }
-    if (m_parameters_expecting_more)
-        m_parameters.append(defaultValue);
+    m_parameters.replaceDefaults(defaultValue);
 }
 
-QDebug operator<<(QDebug debug, Parser::DecodeState decodeState)
+QDebug operator<<(QDebug debug, Parser::State state)
 {
-    switch(decodeState) {
-        case Parser::PlainText:
-            debug << "PlainText";
+    switch(state) {
+        case Parser::Ground:
+            debug << "Ground";
+            break;
+        case Parser::Escape:
+            debug << "Escape";
+            break;
+        case Parser::EscapeIntermediate:
+            debug << "EscapeIntermediate";
+            break;
+        case Parser::CsiEntry:
+            debug << "CsiEntry";
+            break;
+        case Parser::CsiParam:
+            debug << "CsiParam";
+            break;
+        case Parser::CsiIntermediate:
+            debug << "CsiIntermediate";
+            break;
+        case Parser::CsiIgnore:
+            debug << "CsiIgnore";
+            break;
+        case Parser::DcsEntry:
+            debug << "DcsEntry";
+            break;
+        case Parser::DcsParam:
+            debug << "DcsParam";
             break;
-        case Parser::DecodeC0:
-            debug << "DecodeC0";
+        case Parser::DcsIntermediate:
+            debug << "DcsIntermediate";
             break;
-        case Parser::DecodeC1_7bit:
-            debug << "DecodeC1_7bit";
+        case Parser::DcsPassthrough:
+            debug << "DcsPassthrough";
             break;
-        case Parser::DecodeCSI:
-            debug << "DecodeCSI";
+        case Parser::DcsIgnore:
+            debug << "DcsIgnore";
             break;
-        case Parser::DecodeOSC:
-            debug << "DecodeOSC";
+        case Parser::OscString:
+            debug << "OscString";
             break;
-        case Parser::DecodeCharacterSet:
-            debug << "DecodeCharacterSet";
+        case Parser::SosPmApcString:
+            debug << "SosPmApcString";
             break;
-        case Parser::DecodeFontSize:
-            debug << "DecodeFontSize";
+        case Parser::StateCount:
+        case Parser::NoTransition:
+            debug << "Invalid";
             break;
     }
     return debug;
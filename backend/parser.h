@@ -28,7 +28,9 @@
 #include <QtCore/QVector>
 #include <QtCore/QLinkedList>
 
+#include "command_buffer.h"
 #include "controll_chars.h"
+#include "csi_parameters.h"
 #include "utf8_decoder.h"
 
 class Screen;
@@ -39,35 +41,64 @@ public:
     Parser(Screen *screen);
 
     void addData(const QByteArray &data);
+    const CommandBuffer &commands() const;
 
 private:
 
-    enum DecodeState {
-        PlainText,
-        DecodeC0,
-        DecodeC1_7bit,
-        DecodeCSI,
-        DecodeOSC,
-        DecodeCharacterSet,
-        DecodeFontSize
+    // States of the DEC ANSI parser described at http://vt100.net/emu/dec_ansi_parser
+    enum State {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        CsiEntry,
+        CsiParam,
+        CsiIntermediate,
+        CsiIgnore,
+        DcsEntry,
+        DcsParam,
+        DcsIntermediate,
+        DcsPassthrough,
+        DcsIgnore,
+        OscString,
+        SosPmApcString,
+        StateCount,
+        NoTransition = 0x0f
     };
 
-    enum DecodeOSCState {
-        None,
-        ChangeWindowAndIconName,
-        ChangeIconTitle,
-        ChangeWindowTitle,
-        FilePath,
-        Unknown
+    enum Action {
+        Ignore,
+        Print,
+        Execute,
+        Clear,
+        Collect,
+        Param,
+        EscDispatch,
+        CsiDispatch,
+        Hook,
+        Put,
+        Unhook,
+        OscStart,
+        OscPut,
+        OscEnd,
+        ActionCount
     };
 
-    void decodeC0(uchar character);
-    void decodeC1_7bit(uchar character);
-    void decodeParameters(uchar character);
-    void decodeCSI(uchar character);
-    void decodeOSC(uchar character);
-    void decodeCharacterSet(uchar character);
-    void decodeFontSize(uchar character);
+    void processByte(uchar character);
+    void performAction(Action action, uchar character);
+    void enterState(State state, Action action, uchar character);
+    void handleC1(uint code_point);
+
+    void flushText(int end);
+
+    void execute(uchar character);
+    void clear();
+    void collect(uchar character);
+    void param(uchar character);
+    void escDispatch(uchar character);
+    void csiDispatch(uchar character);
+    void oscDispatch();
+
+    void designateCharacterSet(int graphics_set, uchar character);
 
     void setMode(int mode);
     void setDecMode(int mode);
@@ -76,38 +107,36 @@ private:
 
     void handleSGR();
     int handleXtermColor(int param, int i);
+    int handleUnderlineStyle(int i);
 
-    void tokenFinished();
-
-    void appendParameter();
     void handleDefaultParameters(int defaultValue);
 
-    DecodeState m_decode_state;
-    DecodeOSCState m_decode_osc_state;
+    State m_state;
     QByteArray m_osc_data;
 
     QByteArray m_current_data;
+    QByteArray m_incomplete_sequence;
 
     int m_current_token_start;
     int m_current_position;
 
-    QChar m_intermediate_char;
+    uchar m_private_marker;
+    uchar m_intermediate_char;
+    int m_intermediate_count;
 
-    QByteArray m_parameter_string;
-    QVector<int> m_parameters;
-    bool m_parameters_expecting_more;
-    bool m_dec_mode;
-    bool m_gt_param;
+    CsiParameters m_parameters;
     bool m_lnm_mode_set;
     bool m_contains_only_latin;
 
-    int m_decode_graphics_set;
     QTextCodec *m_graphic_codecs[4];
     Utf8Decoder m_utf8_decoder;
+    CommandBuffer m_commands;
 
     Screen *m_screen;
-    friend QDebug operator<<(QDebug debug, DecodeState decodeState);
+    friend struct ParserTransitionTable;
+    friend struct ParserDispatchTable;
+    friend QDebug operator<<(QDebug debug, State state);
 };
-QDebug operator<<(QDebug debug, Parser::DecodeState decodeState);
+QDebug operator<<(QDebug debug, Parser::State state);
 
 #endif // PARSER_H
@@ -0,0 +1,108 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <QtCore/QAtomicInteger>
+
+// Single producer, single consumer byte ring buffer. One thread may write and
+// one other thread may read without locking. The indexes run freely and are
+// masked on access, so the capacity has to be a power of two.
+class RingBuffer
+{
+public:
+    inline explicit RingBuffer(quint32 capacity);
+    inline ~RingBuffer();
+
+    // Producer side. Returns the size of the contiguous free region at *data
+    inline quint32 writeRegion(char **data);
+    inline void commitWrite(quint32 size);
+
+    // Consumer side. Returns the size of the contiguous readable region at *data
+    inline quint32 readRegion(const char **data) const;
+    inline void commitRead(quint32 size);
+
+    inline quint32 size() const;
+    inline quint32 capacity() const;
+
+private:
+    char *m_data;
+    const quint32 m_capacity;
+    QAtomicInteger<quint32> m_write_index;
+    QAtomicInteger<quint32> m_read_index;
+};
+
+RingBuffer::RingBuffer(quint32 capacity)
+    : m_data(new char[capacity])
+    , m_capacity(capacity)
+    , m_write_index(0)
+    , m_read_index(0)
+{
+    Q_ASSERT((capacity & (capacity - 1)) == 0);
+}
+
+RingBuffer::~RingBuffer()
+{
+    delete[] m_data;
+}
+
+quint32 RingBuffer::writeRegion(char **data)
+{
+    const quint32 write_index = m_write_index.loadAcquire();
+    const quint32 free = m_capacity - (write_index - m_read_index.loadAcquire());
+    const quint32 offset = write_index & (m_capacity - 1);
+    *data = m_data + offset;
+    return qMin(free, m_capacity - offset);
+}
+
+void RingBuffer::commitWrite(quint32 size)
+{
+    m_write_index.storeRelease(m_write_index.loadAcquire() + size);
+}
+
+quint32 RingBuffer::readRegion(const char **data) const
+{
+    const quint32 read_index = m_read_index.loadAcquire();
+    const quint32 used = m_write_index.loadAcquire() - read_index;
+    const quint32 offset = read_index & (m_capacity - 1);
+    *data = m_data + offset;
+    return qMin(used, m_capacity - offset);
+}
+
+void RingBuffer::commitRead(quint32 size)
+{
+    m_read_index.storeRelease(m_read_index.loadAcquire() + size);
+}
+
+quint32 RingBuffer::size() const
+{
+    return m_write_index.loadAcquire() - m_read_index.loadAcquire();
+}
+
+quint32 RingBuffer::capacity() const
+{
+    return m_capacity;
+}
+
+#endif // RING_BUFFER_H
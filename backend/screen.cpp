@@ -29,10 +29,13 @@
 #include "text.h"
 #include "scrollback.h"
 #include "selection.h"
+#include "memory_governor.h"
+#include "search.h"
 
 #include "controll_chars.h"
 #include "character_sets.h"
 
+#include <QtCore/QBitArray>
 #include <QtCore/QTimer>
 #include <QtCore/QSocketNotifier>
 #include <QtGui/QGuiApplication>
@@ -49,26 +52,37 @@ Screen::Screen(QObject *parent)
     , m_timer_event_id(0)
     , m_width(1)
     , m_height(0)
-    , m_primary_data(new ScreenData(500, this))
+    , m_block_pool(this)
+    , m_primary_data(new ScreenData(100000, this))
     , m_alternate_data(new ScreenData(0, this))
     , m_current_data(m_primary_data)
     , m_old_current_data(m_primary_data)
     , m_selection(new Selection(this))
+    , m_search(new Search(this))
     , m_flash(false)
     , m_cursor_changed(false)
     , m_application_cursor_key_mode(false)
     , m_fast_scroll(true)
     , m_default_background(m_palette->normalColor(ColorPalette::DefaultBackground))
+    , m_scrollback_bytes(0)
+    , m_text_count(0)
 {
+    update_default_text_style();
+    MemoryGovernor::instance()->registerScreen(this);
+
     Cursor *cursor = new Cursor(this);
     m_cursor_stack << cursor;
     m_new_cursors << cursor;
 
+    m_alternate_data->setCellGridEnabled(true);
+
     connect(m_primary_data, SIGNAL(contentHeightChanged()), this, SIGNAL(contentHeightChanged()));
     connect(m_primary_data, &ScreenData::contentModified, this, &Screen::contentModified);
     connect(m_primary_data, &ScreenData::dataHeightChanged, this, &Screen::dataHeightChanged);
     connect(m_primary_data, &ScreenData::dataWidthChanged, this, &Screen::dataWidthChanged);
     connect(m_palette, SIGNAL(changed()), this, SLOT(paletteChanged()));
+    connect(m_search, &Search::resultsFound, this, &Screen::searchResultsFound);
+    connect(m_search, &Search::finished, this, &Screen::searchFinished);
 
     setHeight(25);
     setWidth(80);
@@ -80,6 +94,7 @@ Screen::Screen(QObject *parent)
 
 Screen::~Screen()
 {
+    MemoryGovernor::instance()->unregisterScreen(this);
 
     for(int i = 0; i < m_to_delete.size(); i++) {
         delete m_to_delete.at(i);
@@ -171,6 +186,7 @@ void Screen::useAlternateScreenBuffer()
         disconnect(m_primary_data, &ScreenData::dataWidthChanged, this, &Screen::dataWidthChanged);
         m_current_data = m_alternate_data;
         m_current_data->clear();
+        m_search->abort();
         connect(m_alternate_data, SIGNAL(contentHeightChanged()), this, SIGNAL(contentHeightChanged()));
         connect(m_alternate_data, &ScreenData::contentModified, this, &Screen::contentModified);
         connect(m_alternate_data, &ScreenData::dataHeightChanged, this, &Screen::dataHeightChanged);
@@ -187,6 +203,7 @@ void Screen::useNormalScreenBuffer()
         disconnect(m_alternate_data, &ScreenData::dataHeightChanged, this, &Screen::dataHeightChanged);
         disconnect(m_alternate_data, &ScreenData::dataWidthChanged, this, &Screen::dataWidthChanged);
         m_current_data = m_primary_data;
+        m_search->abort();
         connect(m_primary_data, SIGNAL(contentHeightChanged()), this, SIGNAL(contentHeightChanged()));
         connect(m_primary_data, &ScreenData::contentModified, this, &Screen::contentModified);
         connect(m_primary_data, &ScreenData::dataHeightChanged, this, &Screen::dataHeightChanged);
@@ -195,13 +212,41 @@ void Screen::useNormalScreenBuffer()
     }
 }
 
-TextStyle Screen::defaultTextStyle() const
+void Screen::update_default_text_style()
+{
+    m_default_text_style.style = TextStyle::Normal;
+    m_default_text_style.foreground = colorPalette()->defaultForeground().rgb();
+    m_default_text_style.background = colorPalette()->defaultBackground().rgb();
+    m_default_text_style.id = internStyle(m_default_text_style);
+}
+
+quint16 Screen::internStyle(const TextStyle &style)
+{
+    quint16 id = m_style_table.intern(style);
+    if (id == TextStyle::InvalidId) {
+        collectStyles();
+        id = m_style_table.intern(style);
+        // Every style is still used, so the text is shown in the one closest to it
+        if (id == TextStyle::InvalidId)
+            id = m_style_table.closest(style);
+    }
+    return id;
+}
+
+// Gives the ids of the styles that no block, cursor or cell uses back to the
+// style table. The scrollback keeps its own copies of the styles of its
+// records, so only its live blocks count
+void Screen::collectStyles()
 {
-    TextStyle style;
-    style.style = TextStyle::Normal;
-    style.foreground = colorPalette()->defaultForeground().rgb();
-    style.background = colorPalette()->defaultBackground().rgb();
-    return style;
+    QBitArray live(m_style_table.size());
+    live.setBit(m_default_text_style.id);
+    for (Cursor *cursor : m_cursor_stack)
+        live.setBit(cursor->currentTextStyle().id);
+    for (Cursor *cursor : m_delete_cursors)
+        live.setBit(cursor->currentTextStyle().id);
+    m_primary_data->markStyles(&live);
+    m_alternate_data->markStyles(&live);
+    m_style_table.collect(live);
 }
 
 void Screen::saveCursor()
@@ -274,6 +319,23 @@ void Screen::doubleClicked(double character, double line)
     m_selection->setEndY(selectionRange.end.y());
 }
 
+void Screen::search(const QString &text, bool caseSensitive)
+{
+    m_search->start(text, caseSensitive);
+}
+
+void Screen::cancelSearch()
+{
+    m_search->cancel();
+}
+
+QPoint Screen::searchResultPosition(double sequence, int position) const
+{
+    if (sequence < 0)
+        return QPoint(-1, -1);
+    return currentScreenData()->positionForSequence(quint64(sequence), position);
+}
+
 void Screen::setTitle(const QString &title)
 {
     m_title = title;
@@ -290,6 +352,75 @@ QString Screen::platformName() const
     return qGuiApp->platformName();
 }
 
+int Screen::scrollbackLineLimit() const
+{
+    return int(m_primary_data->scrollback()->maxLines());
+}
+
+void Screen::setScrollbackLineLimit(int lines)
+{
+    lines = std::max(lines, 0);
+    if (size_t(lines) == m_primary_data->scrollback()->maxLines())
+        return;
+    m_primary_data->setScrollbackLimits(lines, scrollbackByteLimit());
+    emit scrollbackLimitsChanged();
+}
+
+qint64 Screen::scrollbackByteLimit() const
+{
+    return m_primary_data->scrollback()->maxBytes();
+}
+
+void Screen::setScrollbackByteLimit(qint64 bytes)
+{
+    bytes = std::max(bytes, qint64(0));
+    if (bytes == scrollbackByteLimit())
+        return;
+    m_primary_data->setScrollbackLimits(m_primary_data->scrollback()->maxLines(), bytes);
+    emit scrollbackLimitsChanged();
+}
+
+qint64 Screen::scrollbackBytes() const
+{
+    return m_primary_data->scrollback()->byteSize() + m_alternate_data->scrollback()->byteSize();
+}
+
+qint64 Screen::memoryUsage() const
+{
+    return m_primary_data->scrollback()->memoryUsage()
+        + m_alternate_data->scrollback()->memoryUsage()
+        + qint64(m_text_count) * MemoryGovernor::TextObjectCost;
+}
+
+void Screen::releaseCaches()
+{
+    for (int i = 0; i < m_to_delete.size(); i++)
+        delete m_to_delete.at(i);
+    m_text_count -= m_to_delete.size();
+    m_to_delete.clear();
+    m_to_delete.squeeze();
+    m_block_pool.trim();
+}
+
+void Screen::spillScrollback()
+{
+    m_primary_data->scrollback()->spill();
+    m_alternate_data->scrollback()->spill();
+}
+
+// Drops the oldest scrollback until about bytes of memory are given back
+void Screen::truncateScrollback(qint64 bytes)
+{
+    Scrollback *scrollback = m_primary_data->scrollback();
+    const qint64 memory = scrollback->memoryUsage();
+    const qint64 stored = scrollback->byteSize();
+    if (!memory || !stored)
+        return;
+    // What is left in memory can be compressed, so scale to the stored size
+    const qint64 to_drop = std::min(stored, qint64(double(bytes) * stored / memory) + 1);
+    m_primary_data->truncateScrollback(stored - to_drop);
+}
+
 void Screen::scheduleFlash()
 {
     m_flash = true;
@@ -350,6 +481,14 @@ void Screen::dispatchChanges()
     }
 
     m_selection->dispatchChanges();
+
+    const qint64 scrollback_bytes = scrollbackBytes();
+    if (scrollback_bytes != m_scrollback_bytes) {
+        m_scrollback_bytes = scrollback_bytes;
+        emit scrollbackBytesChanged();
+    }
+
+    MemoryGovernor::instance()->enforce();
 }
 
 void Screen::sendPrimaryDA()
@@ -375,6 +514,7 @@ bool Screen::applicationCursorKeyMode() const
 
 void Screen::ensureVisiblePages(int top_line)
 {
+    MemoryGovernor::instance()->touch(this);
     currentScreenData()->ensureVisiblePages(top_line);
 }
 
@@ -398,6 +538,7 @@ static bool hasMeta(Qt::KeyboardModifiers modifiers)
 
 void Screen::sendKey(const QString &text, Qt::Key key, Qt::KeyboardModifiers modifiers)
 {
+    MemoryGovernor::instance()->touch(this);
 
 //    if (key == Qt::Key_Control)
 //        printScreen();
@@ -611,6 +752,7 @@ Text *Screen::createTextSegment(const TextStyleLine &style_line)
         to_return->setVisible(true);
     } else {
         to_return = new Text(this);
+        m_text_count++;
         emit textCreated(to_return);
     }
 
@@ -625,12 +767,193 @@ void Screen::releaseTextSegment(Text *text)
 void Screen::readData(const QByteArray &data)
 {
     m_parser.addData(data);
+    execute(m_parser.commands());
 
     scheduleEventDispatch();
 }
 
+void Screen::execute(const CommandBuffer &commands)
+{
+    for (int i = 0; i < commands.size(); i++) {
+        const CommandBuffer::Command &command = commands.at(i);
+        const int *arguments = command.arguments;
+        switch (command.type) {
+        case ScreenCommand::Print:
+            currentCursor()->addAtCursor(commands.text(command), arguments[2]);
+            break;
+        case ScreenCommand::InsertBlanks:
+            currentCursor()->insertAtCursor(QByteArray(arguments[0], ' '));
+            break;
+        case ScreenCommand::LineFeed:
+            currentCursor()->lineFeed(arguments[0]);
+            break;
+        case ScreenCommand::ReverseLineFeed:
+            currentCursor()->reverseLineFeed();
+            break;
+        case ScreenCommand::CarriageReturn:
+            currentCursor()->moveBeginningOfLine();
+            break;
+        case ScreenCommand::MoveUp:
+            currentCursor()->moveUp(arguments[0]);
+            break;
+        case ScreenCommand::MoveDown:
+            currentCursor()->moveDown(arguments[0]);
+            break;
+        case ScreenCommand::MoveLeft:
+            currentCursor()->moveLeft(arguments[0]);
+            break;
+        case ScreenCommand::MoveRight:
+            currentCursor()->moveRight(arguments[0]);
+            break;
+        case ScreenCommand::Move:
+            currentCursor()->move(arguments[0], arguments[1]);
+            break;
+        case ScreenCommand::MoveToLine:
+            currentCursor()->moveToLine(arguments[0]);
+            break;
+        case ScreenCommand::MoveToCharacter:
+            currentCursor()->moveToCharacter(arguments[0]);
+            break;
+        case ScreenCommand::MoveOrigin:
+            currentCursor()->moveOrigin();
+            break;
+        case ScreenCommand::MoveToNextTab:
+            currentCursor()->moveToNextTab();
+            break;
+        case ScreenCommand::SetTabStop:
+            currentCursor()->setTabStop();
+            break;
+        case ScreenCommand::RemoveTabStop:
+            currentCursor()->removeTabStop();
+            break;
+        case ScreenCommand::ClearTabStops:
+            currentCursor()->clearTabStops();
+            break;
+        case ScreenCommand::ClearToBeginningOfLine:
+            currentCursor()->clearToBeginningOfLine();
+            break;
+        case ScreenCommand::ClearToEndOfLine:
+            currentCursor()->clearToEndOfLine();
+            break;
+        case ScreenCommand::ClearLine:
+            currentCursor()->clearLine();
+            break;
+        case ScreenCommand::ClearToBeginningOfScreen:
+            currentCursor()->clearToBeginningOfScreen();
+            break;
+        case ScreenCommand::ClearToEndOfScreen:
+            currentCursor()->clearToEndOfScreen();
+            break;
+        case ScreenCommand::ClearScreen:
+            clearScreen();
+            break;
+        case ScreenCommand::DeleteCharacters:
+            currentCursor()->deleteCharacters(arguments[0]);
+            break;
+        case ScreenCommand::InsertLines:
+            currentCursor()->insertLines(arguments[0]);
+            break;
+        case ScreenCommand::DeleteLines:
+            currentCursor()->deleteLines(arguments[0]);
+            break;
+        case ScreenCommand::ScrollUp:
+            currentCursor()->scrollUp(arguments[0]);
+            break;
+        case ScreenCommand::ScrollDown:
+            currentCursor()->scrollDown(arguments[0]);
+            break;
+        case ScreenCommand::SetScrollArea:
+            currentCursor()->setScrollArea(arguments[0], arguments[1]);
+            break;
+        case ScreenCommand::ResetScrollArea:
+            currentCursor()->resetScrollArea();
+            break;
+        case ScreenCommand::ResetStyle:
+            currentCursor()->resetStyle();
+            break;
+        case ScreenCommand::SetTextStyle:
+            currentCursor()->setTextStyle(TextStyle::Style(arguments[0]), arguments[1]);
+            break;
+        case ScreenCommand::SetForegroundColor:
+            currentCursor()->setTextForegroundColor(QRgb(arguments[0]));
+            break;
+        case ScreenCommand::SetBackgroundColor:
+            currentCursor()->setTextBackgroundColor(QRgb(arguments[0]));
+            break;
+        case ScreenCommand::SetForegroundColorIndex:
+            currentCursor()->setTextForegroundColorIndex(ColorPalette::Color(arguments[0]));
+            break;
+        case ScreenCommand::SetBackgroundColorIndex:
+            currentCursor()->setTextBackgroundColorIndex(ColorPalette::Color(arguments[0]));
+            break;
+        case ScreenCommand::SetTextCodec:
+            currentCursor()->setTextCodec(command.codec);
+            break;
+        case ScreenCommand::SetInsertMode:
+            currentCursor()->setInsertMode(Cursor::InsertMode(arguments[0]));
+            break;
+        case ScreenCommand::SetOriginAtMargin:
+            currentCursor()->setOriginAtMargin(arguments[0]);
+            break;
+        case ScreenCommand::SetWrapAround:
+            currentCursor()->setWrapAround(arguments[0]);
+            break;
+        case ScreenCommand::SetCursorVisible:
+            currentCursor()->setVisible(arguments[0]);
+            break;
+        case ScreenCommand::SetCursorBlinking:
+            currentCursor()->setBlinking(arguments[0]);
+            break;
+        case ScreenCommand::SetColumnMode:
+            emitRequestWidth(arguments[0]);
+            emitRequestHeight(24);
+            clear();
+            currentCursor()->moveOrigin();
+            currentCursor()->resetScrollArea();
+            break;
+        case ScreenCommand::SetFastScroll:
+            setFastScroll(arguments[0]);
+            break;
+        case ScreenCommand::SetInverseDefaultColors:
+            colorPalette()->setInverseDefaultColors(arguments[0]);
+            break;
+        case ScreenCommand::SetApplicationCursorKeys:
+            setApplicationCursorKeysMode(arguments[0]);
+            break;
+        case ScreenCommand::UseAlternateScreenBuffer:
+            useAlternateScreenBuffer();
+            break;
+        case ScreenCommand::UseNormalScreenBuffer:
+            useNormalScreenBuffer();
+            break;
+        case ScreenCommand::SaveCursor:
+            saveCursor();
+            break;
+        case ScreenCommand::RestoreCursor:
+            restoreCursor();
+            break;
+        case ScreenCommand::Fill:
+            fill(QChar(arguments[0]));
+            break;
+        case ScreenCommand::Flash:
+            scheduleFlash();
+            break;
+        case ScreenCommand::SendPrimaryDA:
+            sendPrimaryDA();
+            break;
+        case ScreenCommand::SendSecondaryDA:
+            sendSecondaryDA();
+            break;
+        case ScreenCommand::SetTitle:
+            setTitle(QString::fromUtf8(commands.text(command)));
+            break;
+        }
+    }
+}
+
 void Screen::paletteChanged()
 {
+    update_default_text_style();
     QColor new_default = m_palette->normalColor(ColorPalette::DefaultBackground);
     if (new_default != m_default_background) {
         m_default_background = new_default;
@@ -30,17 +30,21 @@
 #include "parser.h"
 #include "yat_pty.h"
 #include "text_style.h"
+#include "block_pool.h"
+#include "style_table.h"
 
 #include <QtCore/QPoint>
 #include <QtCore/QSize>
 #include <QtCore/QStack>
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QVariantList>
 
 class Block;
 class Cursor;
 class Text;
 class ScreenData;
 class Selection;
+class Search;
 
 class Screen : public QObject
 {
@@ -53,6 +57,9 @@ class Screen : public QObject
     Q_PROPERTY(Selection *selection READ selection CONSTANT)
     Q_PROPERTY(QColor defaultBackgroundColor READ defaultBackgroundColor NOTIFY defaultBackgroundColorChanged)
     Q_PROPERTY(QString platformName READ platformName CONSTANT)
+    Q_PROPERTY(int scrollbackLineLimit READ scrollbackLineLimit WRITE setScrollbackLineLimit NOTIFY scrollbackLimitsChanged)
+    Q_PROPERTY(qint64 scrollbackByteLimit READ scrollbackByteLimit WRITE setScrollbackByteLimit NOTIFY scrollbackLimitsChanged)
+    Q_PROPERTY(qint64 scrollbackBytes READ scrollbackBytes NOTIFY scrollbackBytesChanged)
 
 public:
     explicit Screen(QObject *parent = 0);
@@ -68,6 +75,7 @@ public:
     int width() const;
 
     ScreenData *currentScreenData() const { return m_current_data; }
+    BlockPool *blockPool() { return &m_block_pool; }
     void useAlternateScreenBuffer();
     void useNormalScreenBuffer();
 
@@ -75,7 +83,11 @@ public:
     void saveCursor();
     void restoreCursor();
 
-    TextStyle defaultTextStyle() const;
+    const TextStyle &defaultTextStyle() const { return m_default_text_style; }
+    StyleTable *styleTable() { return &m_style_table; }
+    // Interns style in the style table, making room for it when the table is full
+    quint16 internStyle(const TextStyle &style);
+    void collectStyles();
 
     QColor defaultForegroundColor() const;
     QColor defaultBackgroundColor() const;
@@ -93,11 +105,35 @@ public:
     Selection *selection() const;
     Q_INVOKABLE void doubleClicked(double character, double line);
 
+    // Starts looking for text in the scrollback and on the screen, replacing
+    // any search that is still running. Matches are reported through
+    // searchResultsFound as they are found, followed by searchFinished
+    Q_INVOKABLE void search(const QString &text, bool caseSensitive = false);
+    Q_INVOKABLE void cancelSearch();
+    // Character and line a search result is shown at now, (-1, -1) if its
+    // line has been dropped from the scrollback
+    Q_INVOKABLE QPoint searchResultPosition(double sequence, int position) const;
+
     void setTitle(const QString &title);
     QString title() const;
 
     QString platformName() const;
 
+    int scrollbackLineLimit() const;
+    void setScrollbackLineLimit(int lines);
+    // 0 means the scrollback is only limited by its number of lines
+    qint64 scrollbackByteLimit() const;
+    void setScrollbackByteLimit(qint64 bytes);
+    // Bytes of text and style information held by the scrollback
+    qint64 scrollbackBytes() const;
+
+    // Memory the MemoryGovernor accounts to this screen, and the ways it can
+    // have the screen give some of it back
+    qint64 memoryUsage() const;
+    void releaseCaches();
+    void spillScrollback();
+    void truncateScrollback(qint64 bytes);
+
     void scheduleFlash();
 
     Q_INVOKABLE void printScreen() const;
@@ -105,6 +141,8 @@ public:
     void scheduleEventDispatch();
     void dispatchChanges();
 
+    void execute(const CommandBuffer &commands);
+
     void sendPrimaryDA();
     void sendSecondaryDA();
 
@@ -133,6 +171,8 @@ signals:
     void screenTitleChanged();
 
     void textCreated(Text *text);
+    void searchResultsFound(const QVariantList &results);
+    void searchFinished();
     void cursorCreated(Cursor *cursor);
 
     void requestHeightChange(int newHeight);
@@ -143,6 +183,8 @@ signals:
     void widthChanged();
 
     void defaultBackgroundColorChanged();
+    void scrollbackLimitsChanged();
+    void scrollbackBytesChanged();
 
     void contentModified(size_t lineModified, int lineDiff, int contentDiff);
     void dataHeightChanged(int newHeight, int removedBeginning, int reclaimed);
@@ -154,6 +196,8 @@ protected:
     void timerEvent(QTimerEvent *);
 
 private:
+    void update_default_text_style();
+
     ColorPalette *m_palette;
     YatPty m_pty;
     Parser m_parser;
@@ -164,6 +208,9 @@ private:
     int m_width;
     int m_height;
 
+    StyleTable m_style_table;
+    TextStyle m_default_text_style;
+    BlockPool m_block_pool;
     ScreenData *m_primary_data;
     ScreenData *m_alternate_data;
     ScreenData *m_current_data;
@@ -176,6 +223,7 @@ private:
     QString m_title;
 
     Selection *m_selection;
+    Search *m_search;
 
     bool m_flash;
     bool m_cursor_changed;
@@ -185,6 +233,8 @@ private:
     QVector<Text *> m_to_delete;
 
     QColor m_default_background;
+    qint64 m_scrollback_bytes;
+    int m_text_count;
 
     friend class ScreenData;
 };
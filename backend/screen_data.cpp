@@ -27,10 +27,12 @@
 #include "screen.h"
 #include "scrollback.h"
 #include "cursor.h"
+#include "block_pool.h"
 
 #include <stdio.h>
 
 #include <QtGui/QGuiApplication>
+#include <QtCore/QBitArray>
 #include <QtCore/QDebug>
 
 ScreenData::ScreenData(size_t max_scrollback, Screen *screen)
@@ -40,17 +42,19 @@ ScreenData::ScreenData(size_t max_scrollback, Screen *screen)
     , m_screen_height(0)
     , m_height(0)
     , m_width(0)
-    , m_block_count(0)
     , m_old_total_lines(0)
+    , m_row_index_dirty(true)
+    , m_cell_grid(nullptr)
 {
 }
 
 ScreenData::~ScreenData()
 {
     for (auto it = m_screen_blocks.begin(); it != m_screen_blocks.end(); ++it) {
-        delete *it;
+        m_screen->blockPool()->release(*it);
     }
     delete m_scrollback;
+    delete m_cell_grid;
 }
 
 
@@ -64,7 +68,9 @@ void ScreenData::setHeight(int height, int currentCursorLine)
     if (m_screen_height == height)
         return;
 
+    flush_cell_grid();
     m_screen_height = height;
+    m_row_index_dirty = true;
 
     int removed_beginning = 0;
     int removed_end = 0;
@@ -85,11 +91,15 @@ void ScreenData::setHeight(int height, int currentCursorLine)
         reclaimed = ensure_at_least_height(height);
     }
 
+    if (m_cell_grid)
+        m_cell_grid->resize(m_width, m_screen_height);
+
     emit dataHeightChanged(m_screen_height, removed_beginning, reclaimed);
 }
 
 void ScreenData::setWidth(int width)
 {
+    flush_cell_grid();
     m_width = width;
 
     for (Block *block : m_screen_blocks) {
@@ -97,6 +107,10 @@ void ScreenData::setWidth(int width)
         block->setWidth(width);
         m_height += block->lineCount() - before_count;
     }
+    m_row_index_dirty = true;
+
+    // Blocks reclaimed from the scrollback below need the new width
+    m_scrollback->setWidth(width);
 
     int removed = 0;
     int reclaimed = 0;
@@ -105,21 +119,42 @@ void ScreenData::setWidth(int width)
     } else {
         reclaimed = ensure_at_least_height(m_screen_height);
     }
-
-    m_scrollback->setWidth(width);
+    if (m_cell_grid)
+        m_cell_grid->resize(m_width, m_screen_height);
 
     emit dataWidthChanged(m_width, removed, reclaimed);
 }
 
+// Used for the alternate screen where full screen applications repaint
+// single cells all over the screen
+void ScreenData::setCellGridEnabled(bool enabled)
+{
+    if (enabled == bool(m_cell_grid))
+        return;
+    if (enabled) {
+        m_cell_grid = new CellGrid(m_screen);
+        m_cell_grid->resize(m_width, m_screen_height);
+    } else {
+        flush_cell_grid();
+        delete m_cell_grid;
+        m_cell_grid = nullptr;
+    }
+}
+
 
 void ScreenData::clearToEndOfLine(const QPoint &point)
 {
+    if (m_cell_grid && load_cell_grid_row(point.y())
+            && m_cell_grid->clearToEnd(point.y(), point.x()))
+        return;
+    flush_cell_grid();
     auto it = it_for_row_ensure_single_line_block(point.y());
     (*it)->clearToEnd(point.x());
 }
 
 void ScreenData::clearToEndOfScreen(int y)
 {
+    flush_cell_grid();
     auto it = it_for_row_ensure_single_line_block(y);
     while(it != m_screen_blocks.end()) {
         clearBlock(it);
@@ -129,12 +164,17 @@ void ScreenData::clearToEndOfScreen(int y)
 
 void ScreenData::clearToBeginningOfLine(const QPoint &point)
 {
+    if (m_cell_grid && load_cell_grid_row(point.y())
+            && m_cell_grid->clearCharacters(point.y(), 0, point.x()))
+        return;
+    flush_cell_grid();
     auto it = it_for_row_ensure_single_line_block(point.y());
     (*it)->clearCharacters(0,point.x());
 }
 
 void ScreenData::clearToBeginningOfScreen(int y)
 {
+    flush_cell_grid();
     auto it = it_for_row_ensure_single_line_block(y);
     if (it != m_screen_blocks.end())
         (*it)->clear();
@@ -146,11 +186,17 @@ void ScreenData::clearToBeginningOfScreen(int y)
 
 void ScreenData::clearLine(const QPoint &point)
 {
+    if (m_cell_grid && load_cell_grid_row(point.y())) {
+        m_cell_grid->clearRow(point.y());
+        return;
+    }
+    flush_cell_grid();
     (*it_for_row_ensure_single_line_block(point.y()))->clear();
 }
 
 void ScreenData::clear()
 {
+    flush_cell_grid();
     for (auto it = m_screen_blocks.begin(); it != m_screen_blocks.end(); ++it) {
         clearBlock(it);
     }
@@ -158,19 +204,34 @@ void ScreenData::clear()
 
 void ScreenData::releaseTextObjects()
 {
+    flush_cell_grid();
     for (auto it = m_screen_blocks.begin(); it != m_screen_blocks.end(); ++it) {
         (*it)->releaseTextObjects();
     }
 }
 
+void ScreenData::markStyles(QBitArray *live) const
+{
+    for (int i = 0; i < m_screen_blocks.size(); i++)
+        m_screen_blocks.at(i)->markStyles(live);
+    m_scrollback->markStyles(live);
+    if (m_cell_grid)
+        m_cell_grid->markStyles(live);
+}
+
 void ScreenData::clearCharacters(const QPoint &point, int to)
 {
+    if (m_cell_grid && load_cell_grid_row(point.y())
+            && m_cell_grid->clearCharacters(point.y(), point.x(), to))
+        return;
+    flush_cell_grid();
     auto it = it_for_row_ensure_single_line_block(point.y());
     (*it)->clearCharacters(point.x(),to);
 }
 
 void ScreenData::deleteCharacters(const QPoint &point, int to)
 {
+    flush_cell_grid();
     auto it = it_for_row(point.y());
     if (it  == m_screen_blocks.end())
         return;
@@ -178,7 +239,12 @@ void ScreenData::deleteCharacters(const QPoint &point, int to)
     int line_in_block = point.y() - (*it)->screenIndex();
     int chars_to_line = line_in_block * m_width;
 
+    const int lines_before = (*it)->lineCount();
     (*it)->deleteCharacters(chars_to_line + point.x(), chars_to_line + to);
+    if ((*it)->lineCount() != lines_before) {
+        m_height += (*it)->lineCount() - lines_before;
+        m_row_index_dirty = true;
+    }
 }
 
 const CursorDiff ScreenData::replace(const QPoint &point, const QString &text, const TextStyle &style, bool only_latin)
@@ -192,56 +258,101 @@ const CursorDiff ScreenData::insert(const QPoint &point, const QString &text, co
 }
 
 
-void ScreenData::moveLine(int from, int to)
+void ScreenData::insertLine(int row, int topMargin)
+{
+    insertLines(row, topMargin, 1);
+}
+
+// Scrolls the region between topMargin and row up by count lines, inserting
+// empty lines after row. Without a top margin the lines go to the scrollback
+// in one go, otherwise the lines leaving the region are reused
+void ScreenData::insertLines(int row, int topMargin, int count)
 {
-    if (from == to)
+    if (count < 1)
+        return;
+
+    if (topMargin || m_height < m_screen_height) {
+        deleteLines(topMargin, row, count);
         return;
+    }
+
+    flush_cell_grid();
+
+    // Blocks are pushed to the scrollback above the insertion point, so
+    // remember it as a distance from the end of the ring
+    const int row_from_end = m_screen_blocks.size() - it_for_row(row + 1).index();
 
     const size_t old_content_height = contentHeight();
-    if (to > from)
-        to++;
-    auto from_it = it_for_row_ensure_single_line_block(from);
-    auto to_it = it_for_row_ensure_single_line_block(to);
 
-    (*from_it)->clear();
-    m_screen_blocks.splice(to_it, m_screen_blocks, from_it);
-    emit contentModified(m_scrollback->height() + to, 1, content_height_diff(old_content_height));
+    int remaining = count;
+    while (remaining > 0) {
+        const int pushed = push_at_most_to_scrollback(std::min(remaining, m_screen_height - 1));
+        const int to_insert = std::max(pushed, 1);
+        for (int i = 0; i < to_insert; i++)
+            m_screen_blocks.insert(m_screen_blocks.end() - row_from_end, m_screen->blockPool()->acquire());
+        m_height += to_insert;
+        remaining -= to_insert;
+    }
+    m_row_index_dirty = true;
+
+    emit contentModified(m_scrollback->height() + row + 1, count, content_height_diff(old_content_height));
 }
 
-void ScreenData::insertLine(int row, int topMargin)
+// Moves the lines in [row, bottom] down by count. The lines pushed out at
+// the bottom are cleared and rotated in as the blank lines at row
+void ScreenData::insertBlankLines(int row, int bottom, int count)
 {
-    auto row_it = it_for_row(row + 1);
+    if (row < 0 || bottom >= m_screen_height || row > bottom || count < 1)
+        return;
 
+    flush_cell_grid();
+    count = std::min(count, bottom - row + 1);
     const size_t old_content_height = contentHeight();
 
-    if (!topMargin && m_height >= m_screen_height) {
-        push_at_most_to_scrollback(1);
-    } else {
-        auto row_top_margin = it_for_row_ensure_single_line_block(topMargin);
-        if (row == topMargin) {
-            (*row_top_margin)->clear();
-            return;
-        }
-        delete (*row_top_margin);
-        m_screen_blocks.erase(row_top_margin);
-        m_height--;
-        m_block_count--;
-    }
+    ensure_block_starts_at_row(row);
+    ensure_block_starts_at_row(bottom - count + 1);
+    ensure_block_starts_at_row(bottom + 1);
+    const int first = index_for_row(row);
+    const int middle = index_for_row(bottom - count + 1);
+    const int last = clear_blocks(middle, index_for_row(bottom + 1), count);
 
-    Block *block_to_insert = new Block(m_screen);
-    m_screen_blocks.insert(row_it,block_to_insert);
-    m_height++;
-    m_block_count++;
+    m_screen_blocks.rotate(first, middle, last);
+    m_row_index_dirty = true;
 
-    emit contentModified(m_scrollback->height() + row + 1, 1, content_height_diff(old_content_height));
+    emit contentModified(m_scrollback->height() + row, 0, content_height_diff(old_content_height));
 }
 
+// Removes count lines at row and moves the rest of [row, bottom] up. The
+// removed lines are cleared and rotated in as the blank lines at the bottom
+void ScreenData::deleteLines(int row, int bottom, int count)
+{
+    if (row < 0 || bottom >= m_screen_height || row > bottom || count < 1)
+        return;
+
+    flush_cell_grid();
+    count = std::min(count, bottom - row + 1);
+    const size_t old_content_height = contentHeight();
+
+    ensure_block_starts_at_row(row);
+    ensure_block_starts_at_row(row + count);
+    ensure_block_starts_at_row(bottom + 1);
+    const int first = index_for_row(row);
+    const int middle_before = index_for_row(row + count);
+    const int last_before = index_for_row(bottom + 1);
+    const int middle = clear_blocks(first, middle_before, count);
+    const int last = last_before + (middle - middle_before);
+
+    m_screen_blocks.rotate(first, middle, last);
+    m_row_index_dirty = true;
+
+    emit contentModified(m_scrollback->height() + row, 0, content_height_diff(old_content_height));
+}
 
 void ScreenData::fill(const QChar &character)
 {
     clear();
     auto it = --m_screen_blocks.end();
-    for (int i = 0; i < m_block_count; --it, i++) {
+    for (int i = 0; i < m_screen_blocks.size(); --it, i++) {
         QString fill_str(m_screen->width(), character);
         (*it)->replaceAtPos(0, fill_str, m_screen->defaultTextStyle());
     }
@@ -249,8 +360,9 @@ void ScreenData::fill(const QChar &character)
 
 void ScreenData::dispatchLineEvents()
 {
-    if (!m_block_count)
+    if (m_screen_blocks.isEmpty())
         return;
+    flush_cell_grid();
     const int scrollback_height = m_scrollback->height();
     int i = 0;
     for (auto it = m_screen_blocks.begin(); it != m_screen_blocks.end(); ++it) {
@@ -273,10 +385,10 @@ void ScreenData::printRuler(QDebug &debug) const
     debug << "    " << (void *) this << ruler;
 }
 
-void ScreenData::printStyleInformation() const
+void ScreenData::printStyleInformation()
 {
-    auto it = m_screen_blocks.end();
-    std::advance(it, -m_block_count);
+    flush_cell_grid();
+    auto it = m_screen_blocks.begin();
     for (int i = 0; it != m_screen_blocks.end(); ++it, i++) {
         if (i % 5 == 0) {
             QDebug debug = qDebug();
@@ -304,6 +416,69 @@ Scrollback *ScreenData::scrollback() const
     return m_scrollback;
 }
 
+void ScreenData::setScrollbackLimits(size_t max_lines, qint64 max_bytes)
+{
+    const size_t old_content_height = contentHeight();
+    m_scrollback->setLimits(max_lines, max_bytes);
+    scrollback_trimmed(old_content_height);
+}
+
+void ScreenData::truncateScrollback(qint64 max_bytes)
+{
+    const size_t old_content_height = contentHeight();
+    m_scrollback->truncate(max_bytes);
+    scrollback_trimmed(old_content_height);
+}
+
+// Appends the positions of text in the blocks on the screen as
+// (character, line) in the content
+void ScreenData::findText(const QString &text, Qt::CaseSensitivity cs, QVector<QPoint> *matches)
+{
+    if (text.isEmpty())
+        return;
+    flush_cell_grid();
+    int index = 0;
+    for (auto it = m_screen_blocks.begin(); it != m_screen_blocks.end(); ++it, ++index) {
+        const Block *block = *it;
+        if (block->textSize() >= text.size()) {
+            const QString block_text = block->textMid(0);
+            for (int pos = block_text.indexOf(text, 0, cs); pos >= 0; pos = block_text.indexOf(text, pos + text.size(), cs))
+                matches->append(QPoint(pos, index));
+        }
+    }
+}
+
+// Returns the character and line the position in the block is shown at
+// now, or (-1, -1) if the block is gone
+QPoint ScreenData::positionForSequence(quint64 sequence, int position) const
+{
+    const int width = std::max(m_width, 1);
+    const quint64 end_sequence = m_scrollback->endSequence();
+    if (sequence < end_sequence) {
+        const qint64 line = m_scrollback->lineForSequence(sequence);
+        if (line < 0)
+            return QPoint(-1, -1);
+        return QPoint(position % width, int(line + position / width));
+    }
+    if (sequence - end_sequence >= quint64(m_screen_blocks.size()))
+        return QPoint(-1, -1);
+
+    const int index = int(sequence - end_sequence);
+    int line = m_scrollback->height();
+    for (int i = 0; i < index; i++)
+        line += m_screen_blocks.at(i)->lineCount();
+    return QPoint(position % width, line + position / width);
+}
+
+void ScreenData::scrollback_trimmed(size_t old_content_height)
+{
+    const int content_diff = content_height_diff(old_content_height);
+    if (content_diff) {
+        emit contentModified(m_scrollback->height(), 0, content_diff);
+        m_screen->scheduleEventDispatch();
+    }
+}
+
 void ScreenData::sendSelectionToClipboard(const QPoint &start, const QPoint &end, QClipboard::Mode mode)
 {
     if (start.y() < 0)
@@ -311,6 +486,7 @@ void ScreenData::sendSelectionToClipboard(const QPoint &start, const QPoint &end
     if (end.y() >= contentHeight())
         return;
 
+    flush_cell_grid();
     QString to_clip_board_buffer;
 
     bool started_in_scrollback = false;
@@ -346,7 +522,7 @@ void ScreenData::sendSelectionToClipboard(const QPoint &start, const QPoint &end
             }
             if (to_clip_board_buffer.size())
                 to_clip_board_buffer += '\n';
-            to_clip_board_buffer += (*it)->textLine().mid(start_pos, end_pos - start_pos);
+            to_clip_board_buffer += (*it)->textMid(start_pos, end_pos - start_pos);
             if (should_break)
                 break;
             screen_index += (*it)->lineCount();
@@ -360,14 +536,22 @@ const SelectionRange ScreenData::getDoubleClickSelectionRange(size_t character,
     if (line < m_scrollback->height())
         return m_scrollback->getDoubleClickSelectionRange(character, line);
     size_t screen_line = line - m_scrollback->height();
+    flush_cell_grid();
     auto it = it_for_row(screen_line);
     if (it != m_screen_blocks.end())
-        return Selection::getDoubleClickRange(it, character, line, m_width);
+        return Selection::getDoubleClickRange(*it, character, line, m_width);
     return { QPoint(), QPoint() };
 }
 
 const CursorDiff ScreenData::modify(const QPoint &point, const QString &text, const TextStyle &style, bool replace, bool only_latin)
 {
+    if (m_cell_grid && replace && load_cell_grid_row(point.y())
+            && m_cell_grid->replace(point.y(), point.x(), text, style, only_latin)) {
+        emit contentModified(m_scrollback->height() + point.y(), 0, 0);
+        return cursor_diff(point.x(), text.size(), point.x());
+    }
+    flush_cell_grid();
+
     auto it = it_for_row(point.y());
     if (it == m_screen_blocks.end())
         return { 0, 0 };
@@ -378,6 +562,8 @@ const CursorDiff ScreenData::modify(const QPoint &point, const QString &text, co
         block->lineCountAfterModified(start_char, text.size(), replace)  - lines_before;
     const size_t old_content_height = contentHeight();
     m_height += lines_changed;
+    if (lines_changed)
+        m_row_index_dirty = true;
     if (lines_changed > 0) {
         int removed = 0;
         auto to_merge_inn = it;
@@ -389,9 +575,8 @@ const CursorDiff ScreenData::modify(const QPoint &point, const QString &text, co
             block->moveLinesFromBlock(to_be_reduced, 0, lines_to_remove);
             removed += lines_to_remove;
             if (remove_block) {
-                delete to_be_reduced;
+                m_screen->blockPool()->release(to_be_reduced);
                 to_merge_inn = m_screen_blocks.erase(to_merge_inn);
-                m_block_count--;
             } else {
                 ++to_merge_inn;
             }
@@ -408,17 +593,41 @@ const CursorDiff ScreenData::modify(const QPoint &point, const QString &text, co
     } else {
         block->insertAtPos(start_char, text, style, only_latin);
     }
-    int end_char = (start_char + text.size()) % m_width;
+    emit contentModified(m_scrollback->height() + point.y(), lines_changed, content_height_diff(old_content_height));
+    return cursor_diff(start_char, text.size(), point.x());
+}
+
+const CursorDiff ScreenData::cursor_diff(int start_char, int text_size, int x) const
+{
+    int end_char = (start_char + text_size) % m_width;
     if (end_char == 0)
         end_char = m_width -1;
 
-    int end_line = (start_char + text.size()) / m_width;
+    int end_line = (start_char + text_size) / m_width;
     int line_diff = end_line - (start_char / m_width);
-    emit contentModified(m_scrollback->height() + point.y(), lines_changed, content_height_diff(old_content_height));
-    return { line_diff, end_char - point.x()};
+    return { line_diff, end_char - x};
 }
 
-void ScreenData::clearBlock(std::list<Block *>::iterator line)
+bool ScreenData::load_cell_grid_row(int row)
+{
+    if (row < 0 || row >= m_screen_height)
+        return false;
+    if (m_cell_grid->isRowLoaded(row))
+        return true;
+    auto it = it_for_row(row);
+    if (it_is_end(it) || (*it)->screenIndex() != row || (*it)->lineCount() != 1)
+        return false;
+    m_cell_grid->loadRow(row, *it);
+    return true;
+}
+
+void ScreenData::flush_cell_grid()
+{
+    if (m_cell_grid && m_cell_grid->hasLoadedRows())
+        m_cell_grid->flush();
+}
+
+void ScreenData::clearBlock(BlockRing::iterator line)
 {
     int before_count = (*line)->lineCount();
     (*line)->clear();
@@ -426,15 +635,17 @@ void ScreenData::clearBlock(std::list<Block *>::iterator line)
     if (diff_line > 0) {
         ++line;
         for (int i = 0; i < diff_line; i++) {
-            m_screen_blocks.insert(line, new Block(m_screen));
+            m_screen_blocks.insert(line, m_screen->blockPool()->acquire());
         }
-        m_block_count+=diff_line;
+        m_row_index_dirty = true;
     }
 }
 
-std::list<Block *>::iterator ScreenData::it_for_row_ensure_single_line_block(int row)
+BlockRing::iterator ScreenData::it_for_row_ensure_single_line_block(int row)
 {
     auto it = it_for_row(row);
+    if (it_is_end(it))
+        return it;
     const int index = (*it)->screenIndex();
     const int lines = (*it)->lineCount();
 
@@ -446,23 +657,23 @@ std::list<Block *>::iterator ScreenData::it_for_row_ensure_single_line_block(int
     return split_out_row_from_block(it, line_diff);
 }
 
-std::list<Block *>::iterator ScreenData::split_out_row_from_block(std::list<Block *>::iterator it, int row_in_block)
+BlockRing::iterator ScreenData::split_out_row_from_block(BlockRing::iterator it, int row_in_block)
 {
     int lines = (*it)->lineCount();
 
     if (row_in_block == 0 && lines == 1)
         return it;
 
+    m_row_index_dirty = true;
+
     if (row_in_block == 0) {
         auto insert_before = (*it)->takeLine(0);
         insert_before->setScreenIndex(row_in_block);
-        m_block_count++;
         return m_screen_blocks.insert(it,insert_before);
     } else if (row_in_block == lines -1) {
         auto insert_after = (*it)->takeLine(lines -1);
         insert_after->setScreenIndex(row_in_block);
         ++it;
-        m_block_count++;
         return m_screen_blocks.insert(it, insert_after);
     }
 
@@ -470,7 +681,6 @@ std::list<Block *>::iterator ScreenData::split_out_row_from_block(std::list<Bloc
     ++it;
     auto it_width_first = m_screen_blocks.insert(it, half);
     auto the_one = half->takeLine(0);
-    m_block_count+=2;
     return m_screen_blocks.insert(it_width_first,the_one);
 }
 
@@ -479,15 +689,15 @@ int ScreenData::push_at_most_to_scrollback(int lines)
     if (lines >= m_height)
         lines = m_height - 1;
     int pushed = 0;
-    auto it = m_screen_blocks.begin();
-    while (it != m_screen_blocks.end() && pushed + (*it)->lineCount() <= lines) {
-        m_block_count--;
-        const int block_height = (*it)->lineCount();
+    while (!m_screen_blocks.isEmpty() && pushed + m_screen_blocks.at(0)->lineCount() <= lines) {
+        Block *block = m_screen_blocks.take_front();
+        const int block_height = block->lineCount();
         m_height -= block_height;
         pushed += block_height;
-        m_scrollback->addBlock(*it);
-        it = m_screen_blocks.erase(it);
+        m_scrollback->addBlock(block);
     }
+    if (pushed)
+        m_row_index_dirty = true;
     return pushed;
 }
 
@@ -498,35 +708,33 @@ int ScreenData::reclaim_at_least(int lines)
         Block *block = m_scrollback->reclaimBlock();
         m_height += block->lineCount();
         lines_reclaimed += block->lineCount();
-        m_block_count++;
         m_screen_blocks.push_front(block);
     }
+    if (lines_reclaimed)
+        m_row_index_dirty = true;
     return lines_reclaimed;
 }
 
 int ScreenData::remove_lines_from_end(int lines)
 {
     int removed = 0;
-    auto it = m_screen_blocks.end();
-    while (it != m_screen_blocks.begin() && removed < lines) {
-        --it;
-        const int block_height = (*it)->lineCount();
+    while (!m_screen_blocks.isEmpty() && removed < lines) {
+        Block *block = m_screen_blocks.at(m_screen_blocks.size() - 1);
+        const int block_height = block->lineCount();
         if (removed + block_height <= lines) {
             removed += block_height;
             m_height -= block_height;
-            m_block_count--;
-            delete (*it);
-            it = m_screen_blocks.erase(it);
+            m_screen->blockPool()->release(m_screen_blocks.take_back());
         } else {
             const int to_remove = lines - removed;
             removed += to_remove;
             m_height -= to_remove;
-            Block *block = *it;
             for (int i = 0; i < to_remove; i++) {
                 block->removeLine(block->lineCount()-1);
             }
         }
     }
+    m_row_index_dirty = true;
     return removed;
 }
 
@@ -541,14 +749,57 @@ int ScreenData::ensure_at_least_height(int height)
     if (height > m_height) {
         int to_insert = height - m_height;
         for (int i = 0; i < to_insert; i++) {
-            m_screen_blocks.push_back(new Block(m_screen));
+            m_screen_blocks.push_back(m_screen->blockPool()->acquire());
         }
         m_height += to_insert;
-        m_block_count += to_insert;
+        m_row_index_dirty = true;
     }
     return reclaimed;
 }
 
+void ScreenData::rebuild_row_index()
+{
+    m_row_index.fill(-1, m_screen_height);
+    int row = m_screen_height;
+    for (int i = m_screen_blocks.size() - 1; i >= 0 && row > 0; i--) {
+        Block *block = m_screen_blocks.at(i);
+        const int lines = block->lineCount();
+        row -= lines;
+        block->setScreenIndex(row);
+        for (int line = std::max(row, 0); line < row + lines; line++)
+            m_row_index[line] = i;
+    }
+    m_row_index_dirty = false;
+}
+
+void ScreenData::ensure_block_starts_at_row(int row)
+{
+    auto it = it_for_row(row);
+    if (it_is_end(it))
+        return;
+    const int row_in_block = row - (*it)->screenIndex();
+    if (row_in_block > 0) {
+        m_screen_blocks.insert(it + 1, (*it)->split(row_in_block));
+        m_row_index_dirty = true;
+    }
+}
+
+int ScreenData::index_for_row(int row)
+{
+    return it_for_row(row).index();
+}
+
+// Clears the blocks in [first, last) and adds blank blocks until they make
+// up lines lines again. Returns the new end of the range
+int ScreenData::clear_blocks(int first, int last, int lines)
+{
+    for (int i = first; i < last; i++)
+        m_screen_blocks.at(i)->clear();
+    for (int i = last - first; i < lines; i++, last++)
+        m_screen_blocks.insert(m_screen_blocks.begin() + last, m_screen->blockPool()->acquire());
+    return last;
+}
+
 int ScreenData::content_height_diff(size_t old_content_height)
 {
     const size_t content_height = contentHeight();
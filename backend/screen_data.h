@@ -27,6 +27,8 @@
 #include "text_style.h"
 #include "block.h"
 #include "selection.h"
+#include "block_ring.h"
+#include "cell_grid.h"
 
 #include <QtCore/QVector>
 #include <QtCore/QPoint>
@@ -67,32 +69,45 @@ public:
     const CursorDiff replace(const QPoint &pos, const QString &text, const TextStyle &style, bool only_latin);
     const CursorDiff insert(const QPoint &pos, const QString &text, const TextStyle &style, bool only_latin);
 
-    void moveLine(int from, int to);
     void insertLine(int insertAt, int topMargin);
+    void insertLines(int insertAt, int topMargin, int count);
+    void insertBlankLines(int row, int bottom, int count);
+    void deleteLines(int row, int bottom, int count);
 
     void fill(const QChar &character);
 
     void dispatchLineEvents();
 
     void printRuler(QDebug &debug) const;
-    void printStyleInformation() const;
+    void printStyleInformation();
 
     Screen *screen() const;
 
     void ensureVisiblePages(int top_line);
+    // Sets the bits of the style ids used by the blocks, the scrollback and
+    // the cell grid
+    void markStyles(QBitArray *live) const;
 
     Scrollback *scrollback() const;
+    void setScrollbackLimits(size_t max_lines, qint64 max_bytes);
+    void truncateScrollback(qint64 max_bytes);
+    // Screen blocks go on from the sequence numbers of the scrollback, they
+    // get the same number when they are pushed to it. Matches are given as
+    // the position in the text of the block and the index of the block
+    void findText(const QString &text, Qt::CaseSensitivity cs, QVector<QPoint> *matches);
+    QPoint positionForSequence(quint64 sequence, int position) const;
 
     void sendSelectionToClipboard(const QPoint &start, const QPoint &end, QClipboard::Mode mode);
 
-    inline std::list<Block *>::iterator it_for_row(int row);
-    inline std::list<Block *>::iterator it_for_block(Block *block);
-    bool it_is_end(std::list<Block *>::iterator it) const { return m_screen_blocks.end() == it; }
+    inline BlockRing::iterator it_for_row(int row);
+    inline BlockRing::iterator it_for_block(Block *block);
+    bool it_is_end(BlockRing::iterator it) const { return it.index() == m_screen_blocks.size(); }
 
     const SelectionRange getDoubleClickSelectionRange(size_t character, size_t line);
 public slots:
     void setHeight(int height, int currentCursorLine);
     void setWidth(int width);
+    void setCellGridEnabled(bool enabled);
 
 signals:
     void contentHeightChanged();
@@ -102,61 +117,76 @@ signals:
 
 private:
     const CursorDiff modify(const QPoint &pos, const QString &text, const TextStyle &style, bool replace, bool only_latin);
-    void clearBlock(std::list<Block *>::iterator line);
-    std::list<Block *>::iterator it_for_row_ensure_single_line_block(int row);
-    std::list<Block *>::iterator split_out_row_from_block(std::list<Block *>::iterator block_it, int row_in_block);
+    const CursorDiff cursor_diff(int start_char, int text_size, int x) const;
+    bool load_cell_grid_row(int row);
+    void flush_cell_grid();
+    void clearBlock(BlockRing::iterator line);
+    BlockRing::iterator it_for_row_ensure_single_line_block(int row);
+    BlockRing::iterator split_out_row_from_block(BlockRing::iterator block_it, int row_in_block);
+    void rebuild_row_index();
+    void ensure_block_starts_at_row(int row);
+    int index_for_row(int row);
+    int clear_blocks(int first, int last, int lines);
     int push_at_most_to_scrollback(int lines);
     int reclaim_at_least(int lines);
     int remove_lines_from_end(int lines);
     int ensure_at_least_height(int height);
     int content_height_diff(size_t old_content_height);
+    void scrollback_trimmed(size_t old_content_height);
     Screen *m_screen;
     Scrollback *m_scrollback;
     int m_screen_height;
     int m_height;
     int m_width;
-    int m_block_count;
     int m_old_total_lines;
 
-    std::list<Block *> m_screen_blocks;
+    BlockRing m_screen_blocks;
+    QVector<int> m_row_index;
+    bool m_row_index_dirty;
+    CellGrid *m_cell_grid;
 };
 
-std::list<Block *>::iterator ScreenData::it_for_row(int row)
+// While every block is a single line the rows map straight onto the ring,
+// otherwise the row index is rebuilt after the block layout has changed
+BlockRing::iterator ScreenData::it_for_row(int row)
 {
-    if (row >= m_screen_height) {
+    if (row < 0 || row >= m_screen_height)
         return m_screen_blocks.end();
-    }
-    auto it = m_screen_blocks.end();
-    int line_for_block = m_screen_height;
-    size_t abs_line = contentHeight();
-    while (it != m_screen_blocks.begin()) {
-        --it;
-        line_for_block -= (*it)->lineCount();
-        abs_line -= (*it)->lineCount();
-        if (line_for_block <= row) {
-            (*it)->setScreenIndex(line_for_block);
-            (*it)->setLine(abs_line);
-            return it;
-        }
-    }
 
-    return m_screen_blocks.end();
+    Block *block;
+    int index;
+    if (m_screen_blocks.size() == m_height) {
+        index = m_screen_blocks.size() - m_screen_height + row;
+        if (index < 0)
+            return m_screen_blocks.end();
+        block = m_screen_blocks.at(index);
+        block->setScreenIndex(row);
+    } else {
+        if (m_row_index_dirty)
+            rebuild_row_index();
+        index = m_row_index.at(row);
+        if (index < 0)
+            return m_screen_blocks.end();
+        block = m_screen_blocks.at(index);
+    }
+    block->setLine(contentHeight() - m_screen_height + block->screenIndex());
+    return BlockRing::iterator(&m_screen_blocks, index);
 }
-inline std::list<Block *>::iterator ScreenData::it_for_block(Block *block)
+
+inline BlockRing::iterator ScreenData::it_for_block(Block *block)
 {
     if (!block)
         return m_screen_blocks.end();
-    auto it = m_screen_blocks.end();
     int line_for_block = m_screen_height;
     size_t abs_line = contentHeight();
-    while(it != m_screen_blocks.begin()) {
-        --it;
-        line_for_block -= (*it)->lineCount();
-        abs_line -= (*it)->lineCount();
-        if (*it == block) {
-            (*it)->setScreenIndex(line_for_block);
-            (*it)->setLine(abs_line);
-            return it;
+    for (int i = m_screen_blocks.size() - 1; i >= 0; i--) {
+        Block *current = m_screen_blocks.at(i);
+        line_for_block -= current->lineCount();
+        abs_line -= current->lineCount();
+        if (current == block) {
+            current->setScreenIndex(line_for_block);
+            current->setLine(abs_line);
+            return BlockRing::iterator(&m_screen_blocks, i);
         }
     }
     return m_screen_blocks.end();
@@ -26,55 +26,84 @@
 #include "screen_data.h"
 #include "screen.h"
 #include "block.h"
+#include "block_pool.h"
+
+#include <QtCore/QBitArray>
 
 #include <set>
 
 #define P_VAR(variable) \
     #variable ":" << variable
 
+static int line_count(int text_size, int width)
+{
+    return (std::max(text_size - 1, 0) / width) + 1;
+}
+
 Scrollback::Scrollback(size_t max_size, ScreenData *screen_data)
     : m_screen_data(screen_data)
-    , m_height(0)
+    , m_lines(screen_data->screen()->styleTable())
     , m_width(0)
-    , m_block_count(0)
     , m_max_size(max_size)
-    , m_adjust_visible_pages(0)
+    , m_max_bytes(0)
+    , m_front_sequence(0)
 {
 }
 
+Scrollback::~Scrollback()
+{
+    for (Block *block : m_live_blocks)
+        m_screen_data->screen()->blockPool()->release(block);
+}
+
 void Scrollback::addBlock(Block *block)
 {
     if (!m_max_size) {
-        delete block;
+        m_screen_data->screen()->blockPool()->release(block);
         return;
     }
 
-    m_blocks.push_back(block);
-    block->releaseTextObjects();
-    m_block_count++;
-    m_height += m_blocks.back()->lineCount();
-
-    while (m_blocks.front() != block && m_height - m_blocks.front()->lineCount() >= m_max_size) {
-        m_block_count--;
-        m_height -= std::min(m_blocks.front()->lineCount(), (int)m_height);
-        delete m_blocks.front();
-        m_blocks.pop_front();
-        m_adjust_visible_pages++;
-    }
+    m_lines.push_back(block);
+    m_line_index.push_back(block->lineCount());
+    m_index.addLine(m_front_sequence + m_lines.size() - 1, block->textMid(0));
+    m_screen_data->screen()->blockPool()->release(block);
+
+    trim_to_limits(1);
 
     m_visible_pages.clear();
 }
 
+void Scrollback::setLimits(size_t max_lines, qint64 max_bytes)
+{
+    m_max_size = max_lines;
+    m_max_bytes = max_bytes;
+    trim_to_limits(m_max_size ? 1 : 0);
+    m_visible_pages.clear();
+}
+
+// Drops the oldest blocks until at most max_bytes are left, without
+// changing the limits
+void Scrollback::truncate(qint64 max_bytes)
+{
+    while (m_lines.size() > 1 && m_lines.recordSize() > max_bytes)
+        pop_front_block();
+    m_visible_pages.clear();
+}
+
 Block *Scrollback::reclaimBlock()
 {
-    if (m_blocks.empty())
+    if (m_lines.isEmpty())
         return nullptr;
 
-    Block *last = m_blocks.back();
+    const int index = m_lines.size() - 1;
+    Block *last = m_live_blocks.take(m_front_sequence + index);
+    if (!last) {
+        last = m_screen_data->screen()->blockPool()->acquire();
+        thaw_line(index, last);
+    }
+    m_lines.pop_back();
+    m_line_index.pop_back();
     last->setWidth(m_width);
-    m_block_count--;
-    m_height -= last->lineCount();
-    m_blocks.pop_back();
 
     m_visible_pages.clear();
     return last;
@@ -84,20 +113,21 @@ void Scrollback::ensureVisiblePages(int top_line)
 {
     if (top_line < 0)
         return;
-    if (size_t(top_line) >= m_height)
+    const size_t total_height = height();
+    if (size_t(top_line) >= total_height)
         return;
 
     uint height = std::max(m_screen_data->screen()->height(), 1);
 
-    int complete_pages = m_height / height;
-    int remainder = m_height - (complete_pages * height);
+    int complete_pages = total_height / height;
+    int remainder = total_height - (complete_pages * height);
 
     int top_page = top_line / height;
     int bottom_page = top_page + 1;
 
     std::set<int> pages_to_update;
     pages_to_update.insert(top_page);
-    if (bottom_page * height < m_height)
+    if (bottom_page * height < total_height)
         pages_to_update.insert(bottom_page);
 
     for (auto it = m_visible_pages.begin(); it != m_visible_pages.end(); ++it) {
@@ -118,145 +148,204 @@ void Scrollback::ensureVisiblePages(int top_line)
     }
 
     for (auto it = pages_to_update.begin(); it != pages_to_update.end(); ++it) {
-        auto page_it = findIteratorForPage(*it);
-        m_visible_pages.push_back( { *it, 0, page_it } );
+        m_visible_pages.push_back( { *it, 0 } );
         if (*it < complete_pages) {
             ensurePageVisible(m_visible_pages.back(), height);
         } else if (*it == complete_pages) {
             ensurePageVisible(m_visible_pages.back(), remainder);
         }
     }
+
+    const size_t end_line = std::min(lineForPage(bottom_page + 1), total_height);
+    const int first_index = m_line_index.indexForLine(lineForPage(top_page));
+    const int end_index = m_line_index.indexForLine(end_line - 1) + 1;
+    release_hidden_blocks(first_index, end_index);
+    m_lines.setHotRange(first_index, end_index);
 }
 
 void Scrollback::ensurePageVisible(Page &page, int new_height)
 {
-    if (page.size == new_height || !m_block_count)
+    if (page.size == new_height || m_lines.isEmpty())
         return;
 
-    int line_no = page.page_no * m_screen_data->screen()->height();
-    auto it = page.it;
-    std::advance(it, page.size);
-    for (int i = page.size; i < new_height; ++it, i++) {
-        (*it)->setLine(line_no + i);
-        (*it)->dispatchEvents();
+    const size_t end_line = lineForPage(page.page_no) + new_height;
+    int index = m_line_index.indexForLine(lineForPage(page.page_no) + page.size);
+    size_t line = m_line_index.lineForIndex(index);
+    for (; index < m_lines.size() && line < end_line; index++) {
+        Block *block = live_block(index);
+        block->setLine(line);
+        block->dispatchEvents();
+        line += m_line_index.lines(index);
     }
     page.size = new_height;
 }
 
 void Scrollback::ensurePageNotVisible(Page &page)
 {
-    auto it = page.it;
-    for (int i = 0; i < page.size; ++it, i++) {
-        (*it)->releaseTextObjects();
+    const size_t end_line = lineForPage(page.page_no) + page.size;
+    int index = m_line_index.indexForLine(lineForPage(page.page_no));
+    size_t line = index < m_lines.size() ? m_line_index.lineForIndex(index) : end_line;
+    for (; index < m_lines.size() && line < end_line; index++) {
+        release_live_block(m_front_sequence + index);
+        line += m_line_index.lines(index);
     }
     page.size = 0;
 }
 
-std::list<Block *>::iterator Scrollback::findIteratorForPage(int page_no)
+size_t Scrollback::lineForPage(int page_no) const
 {
-    uint line = page_no * m_screen_data->screen()->height();
-    Q_ASSERT(line < m_height);
-    for (auto it = m_visible_pages.begin(); it != m_visible_pages.end(); ++it) {
-        Page &page = *it;
-        int diff = page_no - page.page_no;
-        if (diff < 5 && diff > 5) {
-            auto to_return = page.it;
-            int advance = diff * m_screen_data->screen()->height();
-            std::advance(to_return, advance);
-            return to_return;
-        }
-    }
+    return size_t(page_no) * m_screen_data->screen()->height();
+}
 
-    if (line > m_height / 2) {
-        auto to_return = m_blocks.end();
-        std::advance(to_return, line - m_height);
-        return to_return;
-    }
+size_t Scrollback::height() const
+{
+    return size_t(m_line_index.totalLines());
+}
+
+// Only the line counts of the scrollback depend on the width. They are
+// computed from the text sizes kept with the records, without reading the
+// records themselves, and the line index is rebuilt from them in one pass.
+void Scrollback::setWidth(int width)
+{
+    if (size_t(width) == m_width)
+        return;
+    m_width = width;
+    if (m_lines.isEmpty() || width <= 0)
+        return;
+
+    // The live blocks are laid out for the old width
+    releaseVisiblePages();
 
-    auto to_return = m_blocks.begin();
-    std::advance(to_return, line);
-    return to_return;
+    QVector<int> line_counts(m_lines.size());
+    for (int index = 0; index < m_lines.size(); index++)
+        line_counts[index] = line_count(m_lines.textSize(index), width);
+    m_line_index.reset(line_counts);
 }
 
-std::list<Block *>::iterator Scrollback::findIteratorForLine(size_t line)
+void Scrollback::releaseVisiblePages()
 {
-    size_t current_line = m_height;
-    auto it = m_blocks.end();
-    while (it != m_blocks.begin()) {
-        --it;
-        current_line -= (*it)->lineCount();
-        if (current_line <= line)
-            return it;
+    for (Block *block : m_live_blocks)
+        m_screen_data->screen()->blockPool()->release(block);
+    m_live_blocks.clear();
+    m_visible_pages.clear();
+}
+
+// Recreates the block for a line from its frozen record the first time the
+// line is needed, the block is kept until its page is no longer visible
+Block *Scrollback::live_block(int index)
+{
+    Block *&block = m_live_blocks[m_front_sequence + index];
+    if (!block) {
+        block = m_screen_data->screen()->blockPool()->acquire();
+        block->setWidth(m_width);
+        thaw_line(index, block);
     }
-    return m_blocks.end();
+    return block;
 }
 
-void Scrollback::adjustVisiblePages()
+// The styles of the record are interned while the block is filled, so room
+// in the style table is made before that
+void Scrollback::thaw_line(int index, Block *block)
 {
-    if (!m_adjust_visible_pages)
-        return;
+    Screen *screen = m_screen_data->screen();
+    if (screen->styleTable()->isFull())
+        screen->collectStyles();
+    m_lines.thaw(index, block);
+}
 
-    for (auto it = m_visible_pages.begin(); it != m_visible_pages.end(); ++it) {
-        Page &page = *it;
-        const size_t line_for_page = page.page_no * m_screen_data->screen()->height();
-        if (line_for_page < m_adjust_visible_pages) {
-            auto to_remove = it;
-            --it;
-            m_visible_pages.erase(to_remove);
+void Scrollback::markStyles(QBitArray *live) const
+{
+    for (const Block *block : m_live_blocks)
+        block->markStyles(live);
+}
+
+void Scrollback::release_live_block(quint64 sequence)
+{
+    if (Block *block = m_live_blocks.take(sequence))
+        m_screen_data->screen()->blockPool()->release(block);
+}
+
+// Pages are forgotten when blocks are added, so their blocks are released
+// here once they are outside of the pages that are visible again
+void Scrollback::release_hidden_blocks(int first_index, int end_index)
+{
+    const quint64 first = m_front_sequence + first_index;
+    const quint64 end = m_front_sequence + end_index;
+    for (auto it = m_live_blocks.begin(); it != m_live_blocks.end();) {
+        if (it.key() < first || it.key() >= end) {
+            m_screen_data->screen()->blockPool()->release(it.value());
+            it = m_live_blocks.erase(it);
         } else {
-            page.size = 0;
-            std::advance(page.it, m_adjust_visible_pages);
+            ++it;
         }
     }
+}
 
-    m_adjust_visible_pages = 0;
+void Scrollback::pop_front_block()
+{
+    release_live_block(m_front_sequence);
+    m_lines.pop_front();
+    m_line_index.pop_front();
+    m_front_sequence++;
+    m_index.setFrontSequence(m_front_sequence);
 }
 
-size_t Scrollback::height() const
+// Drops the oldest blocks until the scrollback is within its limits, but
+// keeps the newest keep blocks even when they are over them on their own
+void Scrollback::trim_to_limits(int keep)
 {
-    return m_height;
+    while (m_lines.size() > keep) {
+        const bool over_lines = m_line_index.totalLines() - m_line_index.lines(0) >= qint64(m_max_size);
+        const bool over_bytes = m_max_bytes && m_lines.recordSize() > m_max_bytes;
+        if (!over_lines && !over_bytes)
+            break;
+        pop_front_block();
+    }
 }
 
-void Scrollback::setWidth(int width)
+// Appends the positions of text in the block with the given sequence
+// number as (character, line) in the content
+void Scrollback::findText(quint64 sequence, const QString &text, Qt::CaseSensitivity cs, QVector<int> *positions) const
 {
-    m_width = width;
+    if (sequence < m_front_sequence || sequence >= endSequence() || text.isEmpty())
+        return;
+    const int index = int(sequence - m_front_sequence);
+    if (m_lines.textSize(index) < text.size())
+        return;
+    const QString line = m_lines.textMid(index, 0, -1);
+    for (int pos = line.indexOf(text, 0, cs); pos >= 0; pos = line.indexOf(text, pos + text.size(), cs))
+        positions->append(pos);
+}
+
+qint64 Scrollback::lineForSequence(quint64 sequence) const
+{
+    if (sequence < m_front_sequence || sequence >= endSequence())
+        return -1;
+    return m_line_index.lineForIndex(int(sequence - m_front_sequence));
 }
 
 QString Scrollback::selection(const QPoint &start, const QPoint &end) const
 {
     Q_ASSERT(start.y() >= 0);
     Q_ASSERT(end.y() >= 0);
-    Q_ASSERT(size_t(end.y()) < m_height);
+    Q_ASSERT(size_t(end.y()) < height());
     QString return_string;
 
-    size_t current_line = m_height;
-    auto it = m_blocks.end();
-
-    bool should_continue = true;
-    while (it != m_blocks.begin() && should_continue) {
-        --it;
-        const int block_height = (*it)->lineCount();
-        current_line -= block_height;
-        if (current_line > size_t(end.y())) {
-            continue;
-        }
+    int start_line_in_block;
+    int end_line_in_block;
+    const int start_index = m_line_index.indexForLine(start.y(), &start_line_in_block);
+    const int end_index = m_line_index.indexForLine(end.y(), &end_line_in_block);
 
-        int end_pos = (*it)->textSize();
-        if (current_line <= size_t(end.y()) && current_line + block_height >= size_t(end.y())) {
-            size_t end_line_count = end.y() - current_line;
-            end_pos = end_line_count * m_width + end.x();
-        }
+    for (int i = start_index; i <= end_index && i < m_lines.size(); i++) {
         int start_pos = 0;
-        if (current_line <= size_t(start.y()) && current_line + block_height >= size_t(start.y())) {
-            size_t start_line_count = start.y() - current_line;
-            start_pos = start_line_count * m_width + start.x();
-            should_continue = false;
-        } else if (current_line + block_height < size_t(start.y())) {
-            should_continue = false;
-        }
-        return_string.prepend((*it)->textLine().mid(start_pos, end_pos));
-        if (should_continue)
-            return_string.prepend(QChar('\n'));
+        if (i == start_index)
+            start_pos = start_line_in_block * m_width + start.x();
+        int end_pos = m_lines.textSize(i);
+        if (i == end_index)
+            end_pos = end_line_in_block * m_width + end.x();
+        if (i != start_index)
+            return_string += QChar('\n');
+        return_string += m_lines.textMid(i, start_pos, end_pos - start_pos);
     }
 
     return return_string;
@@ -264,8 +353,11 @@ QString Scrollback::selection(const QPoint &start, const QPoint &end) const
 
 const SelectionRange Scrollback::getDoubleClickSelectionRange(size_t character, size_t line)
 {
-    auto it = findIteratorForLine(line);
-    if (it != m_blocks.end())
-        return Selection::getDoubleClickRange(it, character,line, m_width);
+    const int index = m_line_index.indexForLine(line);
+    if (index < m_lines.size()) {
+        Block *block = live_block(index);
+        block->setLine(m_line_index.lineForIndex(index));
+        return Selection::getDoubleClickRange(block, character, line, m_width);
+    }
     return { QPoint(), QPoint() };
 }
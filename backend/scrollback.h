@@ -25,24 +25,30 @@
 #define SCROLLBACK_H
 
 #include "selection.h"
+#include "frozen_lines.h"
+#include "line_index.h"
+#include "trigram_index.h"
 
 #include <list>
 
 #include <QtCore/qglobal.h>
 #include <QtCore/QPoint>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
 class ScreenData;
 class Block;
+class QBitArray;
 
 struct Page {
     int page_no;
     int size;
-    std::list<Block *>::iterator it;
 };
 
 class Scrollback
 {
 public:
     Scrollback(size_t max_size, ScreenData *screen_data);
+    ~Scrollback();
 
     void addBlock(Block *block);
     Block *reclaimBlock();
@@ -52,25 +58,57 @@ public:
 
     void setWidth(int width);
 
-    size_t blockCount() { return m_block_count; }
+    size_t blockCount() { return m_lines.size(); }
+
+    // A max_bytes of 0 means the size in bytes is not limited
+    void setLimits(size_t max_lines, qint64 max_bytes);
+    size_t maxLines() const { return m_max_size; }
+    qint64 maxBytes() const { return m_max_bytes; }
+    qint64 byteSize() const { return m_lines.recordSize(); }
+    qint64 memoryUsage() const { return m_lines.byteSize() + m_index.byteSize(); }
+
+    void spill() { m_lines.spill(); }
+    void truncate(qint64 max_bytes);
+    void setMemoryLimit(qint64 limit) { m_lines.setMemoryLimit(limit); }
+
+    quint64 frontSequence() const { return m_front_sequence; }
+    quint64 endSequence() const { return m_front_sequence + m_lines.size(); }
+    // Sets buckets to the TrigramIndex buckets of the blocks that might
+    // contain text. Returns false if all the blocks have to be searched
+    bool findCandidates(const QString &text, QVector<quint32> *buckets) const { return m_index.findBuckets(text, buckets); }
+    // Appends where text starts in the block, as positions in its text
+    void findText(quint64 sequence, const QString &text, Qt::CaseSensitivity cs, QVector<int> *positions) const;
+    // First line of the block, or -1 if it is no longer in the scrollback
+    qint64 lineForSequence(quint64 sequence) const;
+    void releaseColdChunks() { m_lines.releaseColdChunks(); }
+    void markStyles(QBitArray *live) const;
 
     QString selection(const QPoint &start, const QPoint &end) const;
     const SelectionRange getDoubleClickSelectionRange(size_t character, size_t line);
 private:
     void ensurePageVisible(Page &page, int new_height);
     void ensurePageNotVisible(Page &page);
-    std::list<Block *>::iterator findIteratorForPage(int page_no);
-    std::list<Block *>::iterator findIteratorForLine(size_t line);
-    void adjustVisiblePages();
+    size_t lineForPage(int page_no) const;
+    void releaseVisiblePages();
+    Block *live_block(int index);
+    void thaw_line(int index, Block *block);
+    void release_live_block(quint64 sequence);
+    void release_hidden_blocks(int first_index, int end_index);
+    void pop_front_block();
+    void trim_to_limits(int keep);
     ScreenData *m_screen_data;
 
-    std::list<Block *> m_blocks;
+    FrozenLines m_lines;
+    // Blocks recreated from m_lines for the visible pages, by sequence number
+    QHash<quint64, Block *> m_live_blocks;
+    LineIndex m_line_index;
+    TrigramIndex m_index;
     std::list<Page> m_visible_pages;
-    size_t m_height;
     size_t m_width;
-    size_t m_block_count;
     size_t m_max_size;
-    size_t m_adjust_visible_pages;
+    qint64 m_max_bytes;
+
+    quint64 m_front_sequence;
 };
 
 #endif //SCROLLBACK_H
@@ -0,0 +1,159 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#include "search.h"
+
+#include "screen.h"
+#include "screen_data.h"
+#include "scrollback.h"
+#include "trigram_index.h"
+
+#include <QtCore/QTimerEvent>
+#include <QtCore/QVariantMap>
+
+#include <algorithm>
+
+Search::Search(Screen *screen)
+    : QObject(screen)
+    , m_screen(screen)
+    , m_data(nullptr)
+    , m_case_sensitivity(Qt::CaseInsensitive)
+    , m_indexed(false)
+    , m_next_bucket(0)
+    , m_next_sequence(0)
+    , m_range_end(0)
+    , m_end_sequence(0)
+    , m_timer_id(0)
+{
+}
+
+void Search::start(const QString &text, bool case_sensitive)
+{
+    cancel();
+    if (text.isEmpty()) {
+        emit finished();
+        return;
+    }
+
+    m_data = m_screen->currentScreenData();
+    m_text = text;
+    m_case_sensitivity = case_sensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    const Scrollback *scrollback = m_data->scrollback();
+    m_end_sequence = scrollback->endSequence();
+    m_indexed = scrollback->findCandidates(text, &m_buckets);
+    m_next_bucket = 0;
+    if (m_indexed) {
+        m_next_sequence = m_range_end = 0;
+    } else {
+        m_next_sequence = scrollback->frontSequence();
+        m_range_end = m_end_sequence;
+    }
+    m_timer_id = startTimer(0);
+}
+
+void Search::cancel()
+{
+    if (m_timer_id) {
+        killTimer(m_timer_id);
+        m_timer_id = 0;
+    }
+    m_buckets.clear();
+}
+
+// Ends a running search early, like when the screen data it searches is no
+// longer the current one, and reports it finished
+void Search::abort()
+{
+    if (!isActive())
+        return;
+    cancel();
+    emit finished();
+}
+
+void Search::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_timer_id)
+        search_batch();
+}
+
+bool Search::next_sequence(quint64 *sequence)
+{
+    for (;;) {
+        if (m_next_sequence < m_range_end) {
+            *sequence = m_next_sequence++;
+            return true;
+        }
+        if (m_indexed && m_next_bucket < m_buckets.size()) {
+            m_next_sequence = quint64(m_buckets.at(m_next_bucket++)) * TrigramIndex::BucketLines;
+            m_range_end = std::min(m_next_sequence + TrigramIndex::BucketLines, m_end_sequence);
+            continue;
+        }
+        // Then the blocks that scrolled into the scrollback since the range
+        // above was taken, they are no longer on the screen either
+        const Scrollback *scrollback = m_data->scrollback();
+        if (m_end_sequence >= scrollback->endSequence())
+            return false;
+        m_next_sequence = std::max(m_end_sequence, scrollback->frontSequence());
+        m_range_end = m_end_sequence = scrollback->endSequence();
+    }
+}
+
+void Search::search_batch()
+{
+    QVariantList results;
+    QVector<int> positions;
+    Scrollback *scrollback = m_data->scrollback();
+    quint64 sequence;
+    for (int searched = 0; searched < BatchLines; searched++) {
+        if (!next_sequence(&sequence)) {
+            scrollback->releaseColdChunks();
+            QVector<QPoint> matches;
+            m_data->findText(m_text, m_case_sensitivity, &matches);
+            for (const QPoint &match : matches)
+                add_result(scrollback->endSequence() + match.y(), match.x(), &results);
+            if (!results.isEmpty())
+                emit resultsFound(results);
+            cancel();
+            emit finished();
+            return;
+        }
+        positions.resize(0);
+        scrollback->findText(sequence, m_text, m_case_sensitivity, &positions);
+        for (int position : positions)
+            add_result(sequence, position, &results);
+    }
+    // Do not keep what was read for the search in memory
+    scrollback->releaseColdChunks();
+    if (!results.isEmpty())
+        emit resultsFound(results);
+}
+
+void Search::add_result(quint64 sequence, int position, QVariantList *results) const
+{
+    QVariantMap result;
+    result.insert(QStringLiteral("sequence"), sequence);
+    result.insert(QStringLiteral("position"), position);
+    result.insert(QStringLiteral("length"), m_text.size());
+    results->append(result);
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QVariantList>
+#include <QtCore/QVector>
+
+class Screen;
+class ScreenData;
+
+// Finds a text in the scrollback and on the screen. The scrollback is
+// searched in batches from the event loop, looking only at the lines its
+// TrigramIndex gives for the text, and the matches are reported as they are
+// found. The screen is searched last.
+//
+// Matches are given by the sequence number of their block and the position
+// in its text, which stay the same when the scrollback drops lines from its
+// front or is reflowed. Screen::searchResultPosition gives where a match is
+// shown at the moment.
+class Search : public QObject
+{
+    Q_OBJECT
+public:
+    enum { BatchLines = 4096 };
+
+    explicit Search(Screen *screen);
+
+    void start(const QString &text, bool case_sensitive);
+    void cancel();
+    void abort();
+    bool isActive() const { return m_timer_id != 0; }
+
+signals:
+    // Each result is a map with the sequence, position and length of a match
+    void resultsFound(const QVariantList &results);
+    void finished();
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    bool next_sequence(quint64 *sequence);
+    void search_batch();
+    void add_result(quint64 sequence, int position, QVariantList *results) const;
+
+    Screen *m_screen;
+    ScreenData *m_data;
+    QString m_text;
+    Qt::CaseSensitivity m_case_sensitivity;
+    bool m_indexed;
+    QVector<quint32> m_buckets;
+    int m_next_bucket;
+    quint64 m_next_sequence;
+    quint64 m_range_end;
+    quint64 m_end_sequence;
+    int m_timer_id;
+};
+
+#endif // SEARCH_H
@@ -194,16 +194,16 @@ void Selection::dispatchChanges()
 
 static const QChar delimiter_array[] = { ' ', '\n', '{', '(', '[', '}', ')', ']' };
 static const size_t delimiter_array_size = sizeof(delimiter_array) / sizeof(delimiter_array[0]);
-const SelectionRange Selection::getDoubleClickRange(std::list<Block *>::iterator it, size_t character, size_t line, int width)
+const SelectionRange Selection::getDoubleClickRange(Block *block, size_t character, size_t line, int width)
 {
-    const QString &string = (*it)->textLine();
-    size_t start_pos = ((line - (*it)->line()) * width) + character;
-    if (start_pos > size_t(string.size()))
+    const size_t text_size = size_t(block->textSize());
+    size_t start_pos = ((line - block->line()) * width) + character;
+    if (start_pos > text_size)
         return { QPoint(), QPoint() };
     size_t end_pos = start_pos + 1;
     for (bool found = false; start_pos > 0; start_pos--) {
         for (size_t i = 0; i < delimiter_array_size; i++) {
-            if (string.at(start_pos - 1) == delimiter_array[i]) {
+            if (block->characterAt(int(start_pos - 1)) == delimiter_array[i]) {
                 found = true;
                 break;
             }
@@ -212,9 +212,9 @@ const SelectionRange Selection::getDoubleClickRange(std::list<Block *>::iterator
             break;
     }
 
-    for (bool found = false; end_pos < size_t(string.size()); end_pos++) {
+    for (bool found = false; end_pos < text_size; end_pos++) {
         for (size_t i = 0; i < delimiter_array_size; i++) {
-            if (string.at(end_pos) == delimiter_array[i]) {
+            if (block->characterAt(int(end_pos)) == delimiter_array[i]) {
                 found = true;
                 break;
             }
@@ -223,8 +223,8 @@ const SelectionRange Selection::getDoubleClickRange(std::list<Block *>::iterator
             break;
     }
 
-    size_t start_line = (start_pos / width) + (*it)->line();
-    size_t end_line = (end_pos / width) + (*it)->line();
+    size_t start_line = (start_pos / width) + block->line();
+    size_t end_line = (end_pos / width) + block->line();
 
     return { QPoint(static_cast<int>(start_pos), static_cast<int>(start_line)),
              QPoint(static_cast<int>(end_pos)  , static_cast<int>(end_line)) };
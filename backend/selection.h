@@ -72,7 +72,7 @@ public:
 
     void dispatchChanges();
 
-    static const SelectionRange getDoubleClickRange(std::list<Block *>::iterator it, size_t character, size_t line, int width);
+    static const SelectionRange getDoubleClickRange(Block *block, size_t character, size_t line, int width);
 signals:
     void startXChanged();
     void startYChanged();
@@ -0,0 +1,115 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#include "spill_file.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QDebug>
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+SpillFile::SpillFile()
+    : m_failed(false)
+    , m_live_bytes(0)
+{
+}
+
+qint64 SpillFile::append(const QByteArray &data)
+{
+    if (!ensure_open())
+        return -1;
+    const qint64 offset = m_file.size();
+    if (!m_file.seek(offset) || m_file.write(data) != data.size() || !m_file.flush()) {
+        qWarning() << "Failed to write scrollback to" << m_file.fileName() << m_file.errorString();
+        m_file.resize(offset);
+        return -1;
+    }
+    m_live_bytes += data.size();
+    return offset;
+}
+
+QByteArray SpillFile::read(qint64 offset, int size)
+{
+    uchar *mapped = m_file.map(offset, size);
+    if (!mapped) {
+        qWarning() << "Failed to map scrollback from" << m_file.fileName() << m_file.errorString();
+        return QByteArray();
+    }
+    // All of it is copied right away, so have the kernel read it in one go
+    // instead of faulting in a page at a time
+    const long page_size = sysconf(_SC_PAGESIZE);
+    const quintptr page_offset = quintptr(mapped) % quintptr(page_size);
+    madvise(mapped - page_offset, size_t(size) + page_offset, MADV_WILLNEED);
+
+    QByteArray data(reinterpret_cast<const char *>(mapped), size);
+    m_file.unmap(mapped);
+    return data;
+}
+
+void SpillFile::release(qint64 offset, int size)
+{
+    m_live_bytes -= size;
+    if (!m_live_bytes) {
+        clear();
+        return;
+    }
+#if defined(Q_OS_LINUX) && defined(FALLOC_FL_PUNCH_HOLE)
+    fallocate(m_file.handle(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, size);
+#else
+    Q_UNUSED(offset);
+#endif
+}
+
+void SpillFile::clear()
+{
+    if (m_file.isOpen())
+        m_file.resize(0);
+    m_live_bytes = 0;
+}
+
+bool SpillFile::ensure_open()
+{
+    if (m_file.isOpen())
+        return true;
+    if (m_failed)
+        return false;
+
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (directory.isEmpty())
+        directory = QDir::tempPath();
+    m_file.setFileTemplate(directory + QStringLiteral("/yat-scrollback-XXXXXX"));
+    if (!m_file.open()) {
+        qWarning() << "Failed to create scrollback file in" << directory << m_file.errorString();
+        m_failed = true;
+        return false;
+    }
+    // Everything goes through the open descriptor, so the name can go right
+    // away and no scrollback is left behind on disk after a crash
+    m_file.setAutoRemove(false);
+    ::unlink(QFile::encodeName(m_file.fileName()).constData());
+    return true;
+}
@@ -0,0 +1,57 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#ifndef SPILL_FILE_H
+#define SPILL_FILE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QTemporaryFile>
+
+// Append only file in the runtime directory of the user holding the
+// scrollback chunks that do not fit in the memory limit. Chunks are read
+// back through a memory mapping, and the space of released chunks is given
+// back to the file system where it supports punching holes.
+class SpillFile
+{
+public:
+    SpillFile();
+
+    // Returns the offset of the data in the file, or -1 if the file could
+    // not be created or written
+    qint64 append(const QByteArray &data);
+    QByteArray read(qint64 offset, int size);
+    void release(qint64 offset, int size);
+    void clear();
+
+    qint64 liveBytes() const { return m_live_bytes; }
+
+private:
+    bool ensure_open();
+
+    QTemporaryFile m_file;
+    bool m_failed;
+    qint64 m_live_bytes;
+};
+
+#endif // SPILL_FILE_H
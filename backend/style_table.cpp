@@ -0,0 +1,102 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#include "style_table.h"
+
+#include <limits.h>
+
+uint qHash(const StyleTable::Key &key, uint seed)
+{
+    return qHash(key.foreground, seed) ^ qHash(key.background, seed * 31 + 1) ^ (key.style << 16);
+}
+
+StyleTable::StyleTable()
+    : m_generation(0)
+{
+    m_styles.reserve(64);
+}
+
+quint16 StyleTable::intern(const TextStyle &style)
+{
+    const Key style_key = key(style);
+    auto it = m_ids.constFind(style_key);
+    if (it != m_ids.constEnd())
+        return it.value();
+
+    quint16 id;
+    if (!m_free.isEmpty()) {
+        id = m_free.takeLast();
+        m_styles[id] = style;
+    } else if (m_styles.size() < TextStyle::InvalidId) {
+        id = quint16(m_styles.size());
+        m_styles.append(style);
+    } else {
+        return TextStyle::InvalidId;
+    }
+    m_styles[id].id = id;
+    m_ids.insert(style_key, id);
+    return id;
+}
+
+void StyleTable::collect(const QBitArray &live)
+{
+    const int free_count = m_free.size();
+    for (int id = 0; id < m_styles.size(); id++) {
+        TextStyle &style = m_styles[id];
+        if (style.id == TextStyle::InvalidId || (id < live.size() && live.testBit(id)))
+            continue;
+        m_ids.remove(key(style));
+        style.id = TextStyle::InvalidId;
+        m_free.append(quint16(id));
+    }
+    if (m_free.size() != free_count)
+        m_generation++;
+}
+
+static int colorDistance(QRgb a, QRgb b)
+{
+    return qAbs(qRed(a) - qRed(b)) + qAbs(qGreen(a) - qGreen(b)) + qAbs(qBlue(a) - qBlue(b));
+}
+
+// Only used when the table is full. Different flags weigh more than any
+// difference in the colors
+quint16 StyleTable::closest(const TextStyle &style) const
+{
+    quint16 best = TextStyle::InvalidId;
+    int best_distance = INT_MAX;
+    for (int id = 0; id < m_styles.size(); id++) {
+        const TextStyle &candidate = m_styles.at(id);
+        if (candidate.id == TextStyle::InvalidId)
+            continue;
+        int distance = colorDistance(candidate.foreground, style.foreground)
+                + colorDistance(candidate.background, style.background);
+        if (candidate.style != style.style)
+            distance += 6 * 255 + 1;
+        if (distance < best_distance) {
+            best = quint16(id);
+            best_distance = distance;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,81 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+
+#ifndef STYLE_TABLE_H
+#define STYLE_TABLE_H
+
+#include "text_style.h"
+
+#include <QtCore/QBitArray>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+// Interns the text styles used by a Screen. Every distinct combination of
+// flags and colors gets a 16 bit id which is stored in the TextStyle and in
+// the runs of the blocks, so comparing two interned styles is an integer
+// compare. When the ids run out the Screen marks the ones still in use and
+// collect() hands the others out again.
+class StyleTable
+{
+public:
+    StyleTable();
+
+    // Returns TextStyle::InvalidId when every id is taken
+    quint16 intern(const TextStyle &style);
+    const TextStyle &style(quint16 id) const { return m_styles.at(id); }
+    // Ids are below size(), including the ones that are free
+    int size() const { return m_styles.size(); }
+    bool isFull() const { return m_free.isEmpty() && m_styles.size() >= TextStyle::InvalidId; }
+
+    // Frees the ids that are not set in live
+    void collect(const QBitArray &live);
+    // Changes each time collect() frees ids, which can then be given to other styles
+    quint32 generation() const { return m_generation; }
+    // Id of the interned style that looks the most like style
+    quint16 closest(const TextStyle &style) const;
+
+private:
+    struct Key
+    {
+        uint style;
+        QRgb foreground;
+        QRgb background;
+
+        bool operator==(const Key &other) const
+        {
+            return style == other.style && foreground == other.foreground && background == other.background;
+        }
+    };
+    friend uint qHash(const Key &key, uint seed);
+
+    static Key key(const TextStyle &style) { return Key{ uint(style.style), style.foreground, style.background }; }
+
+    QHash<Key, quint16> m_ids;
+    // Free entries have the InvalidId
+    QVector<TextStyle> m_styles;
+    QVector<quint16> m_free;
+    quint32 m_generation;
+};
+
+#endif // STYLE_TABLE_H
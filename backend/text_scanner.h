@@ -0,0 +1,86 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef TEXT_SCANNER_H
+#define TEXT_SCANNER_H
+
+#include <QtCore/qglobal.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class TextScanner
+{
+public:
+    // Returns the first byte in [begin, end) that is not printable ascii,
+    // ie. a C0 control (including ESC) or a byte with the high bit set which
+    // might be the start of an 8-bit C1 control. Returns end if there is none.
+    static inline const uchar *findNonPrintable(const uchar *begin, const uchar *end);
+
+private:
+    static inline bool isPrintable(uchar character);
+    static inline int countTrailingZeros(uint mask);
+};
+
+const uchar *TextScanner::findNonPrintable(const uchar *begin, const uchar *end)
+{
+    const uchar *it = begin;
+#if defined(__SSE2__)
+    // Signed compare: 0x80-0xff are negative, so a single less than 0x20
+    // catches both the C0 range and the 8-bit range
+    const __m128i c0_end = _mm_set1_epi8(0x20);
+    for (; end - it >= 16; it += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+        uint mask = uint(_mm_movemask_epi8(_mm_cmplt_epi8(chunk, c0_end)));
+        if (mask)
+            return it + countTrailingZeros(mask);
+    }
+#endif
+    for (; it < end; ++it) {
+        if (!isPrintable(*it))
+            return it;
+    }
+    return end;
+}
+
+bool TextScanner::isPrintable(uchar character)
+{
+    return character >= 0x20 && character < 0x80;
+}
+
+int TextScanner::countTrailingZeros(uint mask)
+{
+#if defined(Q_CC_GNU) || defined(Q_CC_CLANG)
+    return __builtin_ctz(mask);
+#else
+    int count = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+#endif // TEXT_SCANNER_H
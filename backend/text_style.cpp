@@ -9,11 +9,14 @@ TextStyle::TextStyle()
     : style(Normal)
     , foreground(0)
     , background(0)
+    , id(InvalidId)
 {
 }
 
 bool TextStyle::isCompatible(const TextStyle &other) const
 {
+    if (id != InvalidId && other.id != InvalidId)
+        return id == other.id;
     return foreground == other.foreground
             && background == other.background
             && style == other.style;
@@ -21,7 +24,7 @@ bool TextStyle::isCompatible(const TextStyle &other) const
 
 QDebug operator<<(QDebug debug, TextStyleLine line)
 {
-    debug << "[" << line.start_index << "(" << line.style << ":" << line.foreground << ":" << line.background << ")" << line.end_index << "]";
+    debug << "[" << line.start_index << "(" << line.style_id << ")" << line.end_index << "]";
     return debug;
 }
 
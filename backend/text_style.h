@@ -26,24 +26,43 @@ public:
     };
     Q_DECLARE_FLAGS(Styles, Style)
 
+    enum { InvalidId = 0xffff };
+
     TextStyle();
 
     Styles style;
     QRgb foreground;
     QRgb background;
+    // Id in the StyleTable of the screen, InvalidId when not interned. Has
+    // to be updated when any of the other fields change, blocks only take
+    // interned styles
+    quint16 id;
 
     bool isCompatible(const TextStyle &other) const;
 };
 
 class Text;
-class TextStyleLine : public TextStyle {
+// A run of text in a Block. Only the id of the style is kept, it is looked up
+// in the StyleTable of the screen when the run is drawn
+class TextStyleLine {
 public:
     TextStyleLine(const TextStyle &style, int start_index, int end_index)
-        : TextStyle(style)
-        , start_index(start_index)
+        : TextStyleLine(style.id, start_index, end_index)
+    {
+        Q_ASSERT(style.id != TextStyle::InvalidId);
+    }
+
+    TextStyleLine(const TextStyleLine &other, int start_index, int end_index)
+        : TextStyleLine(other.style_id, start_index, end_index)
+    {
+    }
+
+    TextStyleLine(quint16 style_id, int start_index, int end_index)
+        : start_index(start_index)
         , end_index(end_index)
         , old_index(-1)
         , text_segment(0)
+        , style_id(style_id)
         , style_dirty(true)
         , index_dirty(true)
         , text_dirty(true)
@@ -55,6 +74,7 @@ public:
         , end_index(0)
         , old_index(-1)
         , text_segment(0)
+        , style_id(TextStyle::InvalidId)
         , style_dirty(false)
         , index_dirty(false)
         , text_dirty(false)
@@ -69,16 +89,18 @@ public:
 
     int old_index;
     Text *text_segment;
+    quint16 style_id;
     bool style_dirty;
     bool index_dirty;
     bool text_dirty;
 
-    void setStyle(const TextStyle &style) {
-        foreground = style.foreground;
-        background = style.background;
-        this->style = style.style;
-    }
+    bool isCompatible(const TextStyle &other) const { return style_id == other.id; }
+    bool isCompatible(const TextStyleLine &other) const { return style_id == other.style_id; }
+    void setStyle(const TextStyle &style) { style_id = style.id; }
+    void setStyle(const TextStyleLine &other) { style_id = other.style_id; }
 };
+// Lets QVector move the runs of a Block with memmove on insert and remove
+Q_DECLARE_TYPEINFO(TextStyleLine, Q_MOVABLE_TYPE);
 QDebug operator<<(QDebug debug, TextStyleLine line);
 
 
@@ -0,0 +1,152 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#include "trigram_index.h"
+
+#include <algorithm>
+
+TrigramIndex::TrigramIndex()
+    : m_entries(0)
+    , m_front_bucket(0)
+    , m_compacted_bucket(0)
+    , m_end_bucket(0)
+{
+}
+
+void TrigramIndex::addLine(quint64 sequence, const QString &text)
+{
+    const quint32 bucket = quint32(sequence / BucketLines);
+    m_end_bucket = std::max(m_end_bucket, bucket + 1);
+    if (text.size() < 3)
+        return;
+
+    const QChar *characters = text.constData();
+    QChar a = characters[0].toCaseFolded();
+    QChar b = characters[1].toCaseFolded();
+    for (int i = 2; i < text.size(); i++) {
+        const QChar c = characters[i].toCaseFolded();
+        QVector<quint32> &posting = m_postings[trigram(a, b, c)];
+        if (posting.isEmpty() || posting.last() < bucket) {
+            posting.append(bucket);
+            m_entries++;
+        } else if (posting.last() != bucket) {
+            // Lines were taken back from the scrollback and new ones added
+            auto it = std::lower_bound(posting.begin(), posting.end(), bucket);
+            if (*it != bucket) {
+                posting.insert(it, bucket);
+                m_entries++;
+            }
+        }
+        a = b;
+        b = c;
+    }
+}
+
+void TrigramIndex::setFrontSequence(quint64 front_sequence)
+{
+    m_front_bucket = quint32(front_sequence / BucketLines);
+    // Removing the buckets at the front from every posting list is only
+    // worth it once as many have been dropped as there are left
+    if (m_front_bucket - m_compacted_bucket > m_end_bucket - m_front_bucket)
+        compact();
+}
+
+void TrigramIndex::clear()
+{
+    m_postings.clear();
+    m_entries = 0;
+    m_front_bucket = 0;
+    m_compacted_bucket = 0;
+    m_end_bucket = 0;
+}
+
+bool TrigramIndex::findBuckets(const QString &text, QVector<quint32> *buckets) const
+{
+    buckets->clear();
+    if (text.size() < 3)
+        return false;
+
+    const QString folded = fold(text);
+    QVector<const QVector<quint32> *> postings;
+    for (int i = 2; i < folded.size(); i++) {
+        auto it = m_postings.constFind(trigram(folded.at(i - 2), folded.at(i - 1), folded.at(i)));
+        if (it == m_postings.constEnd())
+            return true;
+        if (!postings.contains(&it.value()))
+            postings.append(&it.value());
+    }
+
+    // Intersect starting with the shortest list to keep the work down
+    std::sort(postings.begin(), postings.end(),
+              [](const QVector<quint32> *a, const QVector<quint32> *b) { return a->size() < b->size(); });
+    const QVector<quint32> &shortest = *postings.first();
+    auto first = std::lower_bound(shortest.constBegin(), shortest.constEnd(), m_front_bucket);
+    buckets->reserve(int(shortest.constEnd() - first));
+    std::copy(first, shortest.constEnd(), std::back_inserter(*buckets));
+
+    QVector<quint32> intersection;
+    for (int i = 1; i < postings.size() && !buckets->isEmpty(); i++) {
+        const QVector<quint32> &posting = *postings.at(i);
+        intersection.resize(0);
+        std::set_intersection(buckets->constBegin(), buckets->constEnd(),
+                              posting.constBegin(), posting.constEnd(),
+                              std::back_inserter(intersection));
+        buckets->swap(intersection);
+    }
+    return true;
+}
+
+QString TrigramIndex::fold(const QString &text)
+{
+    QString folded(text.size(), Qt::Uninitialized);
+    const QChar *in = text.constData();
+    QChar *out = folded.data();
+    for (int i = 0; i < text.size(); i++)
+        out[i] = in[i].toCaseFolded();
+    return folded;
+}
+
+quint64 TrigramIndex::trigram(QChar a, QChar b, QChar c)
+{
+    return (quint64(a.unicode()) << 32) | (quint64(b.unicode()) << 16) | quint64(c.unicode());
+}
+
+void TrigramIndex::compact()
+{
+    for (auto it = m_postings.begin(); it != m_postings.end();) {
+        QVector<quint32> &posting = it.value();
+        auto first = std::lower_bound(posting.begin(), posting.end(), m_front_bucket);
+        const int dropped = int(first - posting.begin());
+        m_entries -= dropped;
+        if (dropped == posting.size()) {
+            it = m_postings.erase(it);
+            continue;
+        }
+        if (dropped) {
+            posting.remove(0, dropped);
+            posting.squeeze();
+        }
+        ++it;
+    }
+    m_compacted_bucket = m_front_bucket;
+}
@@ -0,0 +1,71 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+// Index from the case folded trigrams of the scrollback lines to the buckets
+// of BucketLines consecutive lines they are found in. Looking up a text gives
+// the buckets holding every trigram of it, so only the lines in those need to
+// be searched. The index may give buckets that do not hold the text, but
+// never misses one that does; lines taken back from the scrollback are
+// therefore just left in it.
+class TrigramIndex
+{
+public:
+    enum { BucketLines = 32 };
+
+    TrigramIndex();
+
+    void addLine(quint64 sequence, const QString &text);
+    // Lines before front_sequence are no longer searched
+    void setFrontSequence(quint64 front_sequence);
+    void clear();
+
+    // Sets buckets to the sorted buckets that might contain the text. Returns
+    // false if the text is too short to be looked up in the index
+    bool findBuckets(const QString &text, QVector<quint32> *buckets) const;
+
+    qint64 byteSize() const { return m_entries * qint64(sizeof(quint32)) + m_postings.size() * qint64(PostingCost); }
+
+    static QString fold(const QString &text);
+
+private:
+    // Rough cost of a hash node and an empty posting list
+    enum { PostingCost = 48 };
+
+    static quint64 trigram(QChar a, QChar b, QChar c);
+    void compact();
+
+    QHash<quint64, QVector<quint32>> m_postings;
+    qint64 m_entries;
+    quint32 m_front_bucket;
+    quint32 m_compacted_bucket;
+    quint32 m_end_bucket;
+};
+
+#endif // TRIGRAM_INDEX_H
@@ -26,21 +26,35 @@
 
 #include "controll_chars.h"
 
+// Validating utf-8 decoder based on the DFA described by Bjoern Hoehrmann at
+// http://bjoern.hoehrmann.de/utf-8/decoder/dfa/
+// The decoder keeps its state between calls to addChar, so sequences may be
+// split across several reads from the pty.
 class Utf8Decoder
 {
 public:
+    enum State {
+        Accept = 0,
+        Reject = 12
+    };
+
     inline Utf8Decoder();
 
-    inline void addChar(uchar character);
+    inline State addChar(uchar character);
 
+    inline State state() const;
+    inline bool isInSequence() const;
     inline bool isLatin() const;
     inline bool isC1() const;
+    inline uint32_t codePoint() const;
 
     inline void clear();
 private:
-    short m_expected_length;
-    short m_length;
-    uint32_t m_unicode;
+    static const uchar character_types[256];
+    static const uchar transitions[108];
+
+    uchar m_state;
+    uint32_t m_code_point;
 };
 
 Utf8Decoder::Utf8Decoder()
@@ -48,62 +62,51 @@ Utf8Decoder::Utf8Decoder()
     clear();
 }
 
-void Utf8Decoder::addChar(uchar character)
+Utf8Decoder::State Utf8Decoder::addChar(uchar character)
 {
-    if (m_length && m_length == m_expected_length) {
-        clear();
+    const uchar type = character_types[character];
+    if (m_state != Accept && m_state != Reject) {
+        m_code_point = (character & 0x3fu) | (m_code_point << 6);
+        m_state = transitions[m_state + type];
+        if (m_state != Reject)
+            return State(m_state);
+        // The byte that broke the sequence might start a new one
     }
+    m_code_point = (0xffu >> type) & character;
+    m_state = transitions[type];
+    return State(m_state);
+}
 
-    if (character < 0x80)
-        return;
-
-    fprintf(stderr, "Character: 0x%x\n", character);
-    if (m_expected_length == 0) {
-        //this is naive. There must be a faster way.
-        if ((character & 0xfc) == 0xfc) {
-            m_expected_length = 5;
-            m_unicode = character & 0x01;
-        } else if ((character & 0xf8) == 0xf8) {
-            m_expected_length = 4;
-            m_unicode = character & 0x03;
-        } else if ((character & 0xf0) == 0xf0) {
-            m_expected_length = 3;
-            m_unicode = character & 0x07;
-        } else if ((character & 0xe0) == 0xe0) {
-            m_expected_length = 2;
-            m_unicode = character & 0x0f;
-        } else if ((character & 0xc0) == 0xc0) {
-            m_expected_length = 1;
-            m_unicode = character & 0x1f;
-        } else {
-            m_expected_length = 0;
-            m_unicode = 0;
-            qWarning("Utf8Decoder: invalid decoder character");
-        }
-    } else {
-        fprintf(stderr, "Before 0x%x adding 0x%x pure 0x%x\n", m_unicode,(character & 0x3f), character);
-        m_unicode = (m_unicode << 6) |  (character & 0x3f);
-        fprintf(stderr, "After 0x%x\n", m_unicode);
-        m_length++;
-    }
+Utf8Decoder::State Utf8Decoder::state() const
+{
+    return State(m_state);
+}
+
+bool Utf8Decoder::isInSequence() const
+{
+    return m_state != Accept && m_state != Reject;
 }
 
 bool Utf8Decoder::isLatin() const
 {
-    return m_expected_length < 2 && m_unicode < 0xff;
+    return m_state == Accept && m_code_point <= 0xff;
 }
 
 bool Utf8Decoder::isC1() const
 {
-    return m_expected_length == 2 && m_length == m_expected_length &&
-        (m_unicode >= C1_8bit::C1_8bit_Start && m_unicode <= C1_8bit::C1_8bit_Stop);
+    return m_state == Accept &&
+        m_code_point >= C1_8bit::C1_8bit_Start && m_code_point < C1_8bit::C1_8bit_Stop;
+}
+
+uint32_t Utf8Decoder::codePoint() const
+{
+    return m_code_point;
 }
 
 void Utf8Decoder::clear()
 {
-    m_expected_length = 0;
-    m_length = 0;
-    m_unicode = 0;
+    m_state = Accept;
+    m_code_point = 0;
 }
 
 #endif
@@ -0,0 +1,103 @@
+/*******************************************************************************
+* Copyright (c) 2013 Jørgen Lind
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*******************************************************************************/
+
+#ifndef UTF8_TRANSCODER_H
+#define UTF8_TRANSCODER_H
+
+#include "utf8_decoder.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class Utf8Transcoder
+{
+public:
+    // Writes the utf-16 form of the utf-8 text in [begin, end) to destination,
+    // which needs room for end - begin code units. Malformed and truncated
+    // sequences are replaced by U+FFFD. Returns the number of code units written.
+    static inline int toUtf16(const uchar *begin, const uchar *end, ushort *destination);
+
+private:
+    static inline int widenAscii(const uchar *begin, const uchar *end, ushort *destination);
+};
+
+int Utf8Transcoder::toUtf16(const uchar *begin, const uchar *end, ushort *destination)
+{
+    ushort *out = destination;
+    Utf8Decoder decoder;
+    const uchar *it = begin;
+    while (it < end) {
+        if (*it < 0x80) {
+            if (decoder.isInSequence()) {
+                *out++ = 0xfffd;
+                decoder.clear();
+            }
+            const int widened = widenAscii(it, end, out);
+            it += widened;
+            out += widened;
+            continue;
+        }
+
+        const uchar character = *it++;
+        const bool was_in_sequence = decoder.isInSequence();
+        const Utf8Decoder::State state = decoder.addChar(character);
+        if (was_in_sequence && (character & 0xc0) != 0x80)
+            *out++ = 0xfffd;
+
+        if (state == Utf8Decoder::Accept) {
+            const uint32_t code_point = decoder.codePoint();
+            if (code_point > 0xffff) {
+                *out++ = ushort(0xd7c0 + (code_point >> 10));
+                *out++ = ushort(0xdc00 + (code_point & 0x3ff));
+            } else {
+                *out++ = ushort(code_point);
+            }
+        } else if (state == Utf8Decoder::Reject) {
+            *out++ = 0xfffd;
+        }
+    }
+    if (decoder.isInSequence())
+        *out++ = 0xfffd;
+    return int(out - destination);
+}
+
+int Utf8Transcoder::widenAscii(const uchar *begin, const uchar *end, ushort *destination)
+{
+    const uchar *it = begin;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; end - it >= 16; it += 16, destination += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+        if (_mm_movemask_epi8(chunk))
+            break;
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination), _mm_unpacklo_epi8(chunk, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + 8), _mm_unpackhi_epi8(chunk, zero));
+    }
+#endif
+    for (; it < end && *it < 0x80; ++it)
+        *destination++ = *it;
+    return int(it - begin);
+}
+
+#endif // UTF8_TRANSCODER_H
@@ -34,6 +34,9 @@
 #include <pty.h>
 #endif
 #include <utmp.h>
+#include <errno.h>
+
+#include <atomic>
 
 #include <QtCore/QSize>
 #include <QtCore/QString>
@@ -41,6 +44,8 @@
 #include <QtCore/QSocketNotifier>
 #include <QtCore/QDebug>
 
+#include "ring_buffer.h"
+
 static char env_variables[][255] = {
     "TERM=xterm-color",
     "COLORTERM=xterm",
@@ -51,8 +56,154 @@ static char env_variables[][255] = {
 };
 static int env_variables_size = sizeof(env_variables) / sizeof(env_variables[0]);
 
+static const int min_read_size = 4 * 1024;
+static const int max_read_size = 1024 * 1024;
+// Number of consecutive reads using less than a quarter of the buffer before
+// it is halved
+static const int shrink_after_reads = 16;
+
+static const quint32 read_buffer_capacity = 1 << 22;
+// Upper bound of what is parsed per pass through the event loop in threaded
+// mode, so painting and input get a chance to run during heavy output
+static const quint32 max_consume_slice = 1 << 18;
+
+// Drains the master device into a RingBuffer when YAT_THREADED_PTY is set.
+// The GUI thread is notified through a queued call to
+// YatPty::consumeReadBuffer, which is only posted when none is pending.
+class PtyReaderThread : public QThread
+{
+public:
+    PtyReaderThread(YatPty *pty, int master_fd, RingBuffer *buffer);
+    ~PtyReaderThread();
+
+    void stop();
+    void wakeUp();
+
+    QAtomicInt notify_pending;
+    QAtomicInt hangup;
+    QAtomicInt waiting_for_space;
+
+protected:
+    void run() override;
+
+private:
+    void notify();
+    void drainWakeUpPipe();
+
+    YatPty *m_pty;
+    int m_master_fd;
+    RingBuffer *m_buffer;
+    int m_wake_up_pipe[2];
+    QAtomicInt m_stop;
+};
+
+PtyReaderThread::PtyReaderThread(YatPty *pty, int master_fd, RingBuffer *buffer)
+    : notify_pending(0)
+    , hangup(0)
+    , waiting_for_space(0)
+    , m_pty(pty)
+    , m_master_fd(master_fd)
+    , m_buffer(buffer)
+    , m_stop(0)
+{
+    if (::pipe(m_wake_up_pipe) < 0) {
+        qWarning() << "Failed to create wake up pipe for pty reader thread";
+        m_wake_up_pipe[0] = m_wake_up_pipe[1] = -1;
+    } else {
+        ::fcntl(m_wake_up_pipe[0], F_SETFL, ::fcntl(m_wake_up_pipe[0], F_GETFL) | O_NONBLOCK);
+    }
+}
+
+PtyReaderThread::~PtyReaderThread()
+{
+    ::close(m_wake_up_pipe[0]);
+    ::close(m_wake_up_pipe[1]);
+}
+
+void PtyReaderThread::stop()
+{
+    m_stop.storeRelease(1);
+    wakeUp();
+}
+
+void PtyReaderThread::wakeUp()
+{
+    char wake_up = 0;
+    if (::write(m_wake_up_pipe[1], &wake_up, 1) < 0)
+        qWarning() << "Failed to wake up pty reader thread";
+}
+
+void PtyReaderThread::run()
+{
+    struct pollfd fds[2];
+    fds[0].fd = m_master_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wake_up_pipe[0];
+    fds[1].events = POLLIN;
+
+    while (!m_stop.loadAcquire()) {
+        char *region;
+        quint32 free = m_buffer->writeRegion(&region);
+        if (!free) {
+            waiting_for_space.storeRelease(1);
+            // The consumer might have made room before it could see the
+            // flag. Release and acquire do not keep the store to the flag
+            // ahead of the load of the read index, only a full fence does,
+            // and consumeReadBuffer has the matching one
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            free = m_buffer->writeRegion(&region);
+            if (!free) {
+                fds[1].revents = 0;
+                if (::poll(&fds[1], 1, -1) > 0)
+                    drainWakeUpPipe();
+                waiting_for_space.storeRelease(0);
+                continue;
+            }
+            waiting_for_space.storeRelease(0);
+        }
+
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN)
+            drainWakeUpPipe();
+        if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+
+        ssize_t read_size = ::read(m_master_fd, region, free);
+        if (read_size < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (read_size <= 0) {
+            hangup.storeRelease(1);
+            notify();
+            return;
+        }
+        m_buffer->commitWrite(quint32(read_size));
+        notify();
+    }
+}
+
+void PtyReaderThread::notify()
+{
+    if (notify_pending.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(m_pty, "consumeReadBuffer", Qt::QueuedConnection);
+}
+
+void PtyReaderThread::drainWakeUpPipe()
+{
+    char buffer[64];
+    while (::read(m_wake_up_pipe[0], buffer, sizeof buffer) == sizeof buffer)
+        ;
+}
+
 YatPty::YatPty()
     : m_winsize(0)
+    , m_small_reads(0)
+    , m_reader(0)
+    , m_reader_thread(0)
+    , m_read_buffer(0)
 {
     m_terminal_pid = forkpty(&m_master_fd,
                              NULL,
@@ -67,18 +218,50 @@ YatPty::YatPty()
         exit(0);
     }
 
-    m_reader = new QSocketNotifier(m_master_fd,QSocketNotifier::Read,this);
-    connect(m_reader, &QSocketNotifier::activated, this, &YatPty::readData);
+    // The master is drained until EAGAIN, so one wake up parses everything
+    // that is available
+    ::fcntl(m_master_fd, F_SETFL, ::fcntl(m_master_fd, F_GETFL) | O_NONBLOCK);
+
+    if (qEnvironmentVariableIntValue("YAT_THREADED_PTY")) {
+        m_read_buffer = new RingBuffer(read_buffer_capacity);
+        m_reader_thread = new PtyReaderThread(this, m_master_fd, m_read_buffer);
+        m_reader_thread->start();
+    } else {
+        m_data_buffer.resize(min_read_size);
+        m_reader = new QSocketNotifier(m_master_fd,QSocketNotifier::Read,this);
+        connect(m_reader, &QSocketNotifier::activated, this, &YatPty::readData);
+    }
 }
 
 YatPty::~YatPty()
 {
+    if (m_reader_thread) {
+        m_reader_thread->stop();
+        m_reader_thread->wait();
+        delete m_reader_thread;
+        delete m_read_buffer;
+    }
 }
 
 void YatPty::write(const QByteArray &data)
 {
-    if (::write(m_master_fd, data.constData(), data.size()) < 0) {
-        qDebug() << "Something whent wrong when writing to m_master_fd";
+    const char *to_write = data.constData();
+    ssize_t remaining = data.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(m_master_fd, to_write, remaining);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                struct pollfd fd = { m_master_fd, POLLOUT, 0 };
+                ::poll(&fd, 1, -1);
+                continue;
+            }
+            qDebug() << "Something whent wrong when writing to m_master_fd";
+            return;
+        }
+        to_write += written;
+        remaining -= written;
     }
 }
 
@@ -126,13 +309,72 @@ int YatPty::masterDevice() const
 
 void YatPty::readData()
 {
-    int size_of_buffer = sizeof m_data_buffer / sizeof *m_data_buffer;
-    ssize_t read_size = ::read(m_master_fd,m_data_buffer,size_of_buffer);
-    if (read_size > 0) {
-        QByteArray to_return = QByteArray::fromRawData(m_data_buffer,read_size);
-        emit readyRead(to_return);
-    } else if (read_size <= 0) {
+    int total = 0;
+    bool hangup = false;
+    forever {
+        if (total == m_data_buffer.size()) {
+            if (m_data_buffer.size() == max_read_size)
+                break;
+            m_data_buffer.resize(qMin(m_data_buffer.size() * 2, max_read_size));
+        }
+        ssize_t read_size = ::read(m_master_fd, m_data_buffer.data() + total, m_data_buffer.size() - total);
+        if (read_size > 0) {
+            total += read_size;
+        } else if (read_size < 0 && errno == EINTR) {
+            continue;
+        } else {
+            hangup = read_size == 0 || errno != EAGAIN;
+            break;
+        }
+    }
+
+    if (total) {
+        emit readyRead(QByteArray::fromRawData(m_data_buffer.constData(), total));
+
+        if (total < m_data_buffer.size() / 4) {
+            if (++m_small_reads >= shrink_after_reads && m_data_buffer.size() > min_read_size) {
+                m_data_buffer.resize(m_data_buffer.size() / 2);
+                m_small_reads = 0;
+            }
+        } else {
+            m_small_reads = 0;
+        }
+    }
+
+    if (hangup) {
         delete m_reader;
+        m_reader = 0;
+        emit hangupReceived();
+    }
+}
+
+void YatPty::consumeReadBuffer()
+{
+    // Cleared first so data committed from here on posts a new call
+    m_reader_thread->notify_pending.storeRelease(0);
+
+    quint32 consumed = 0;
+    const char *data;
+    while (consumed < max_consume_slice) {
+        quint32 size = m_read_buffer->readRegion(&data);
+        if (!size)
+            break;
+        size = qMin(size, max_consume_slice - consumed);
+        emit readyRead(QByteArray::fromRawData(data, int(size)));
+        m_read_buffer->commitRead(size);
+        consumed += size;
+    }
+
+    // Pairs with the fence in PtyReaderThread::run, so either the reader
+    // sees the space committed above or this sees it waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumed && m_reader_thread->waiting_for_space.loadAcquire())
+        m_reader_thread->wakeUp();
+
+    if (m_read_buffer->size()) {
+        if (m_reader_thread->notify_pending.testAndSetOrdered(0, 1))
+            QMetaObject::invokeMethod(this, "consumeReadBuffer", Qt::QueuedConnection);
+    } else if (m_reader_thread->hangup.testAndSetOrdered(1, 2)) {
         emit hangupReceived();
     }
 }
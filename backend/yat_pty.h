@@ -23,11 +23,14 @@
 
 #include <unistd.h>
 
+#include <QtCore/QByteArray>
 #include <QtCore/QObject>
 #include <QtCore/QLinkedList>
 #include <QtCore/QMutex>
 
 class QSocketNotifier;
+class PtyReaderThread;
+class RingBuffer;
 
 class YatPty : public QObject
 {
@@ -48,6 +51,9 @@ signals:
     void hangupReceived();
     void readyRead(const QByteArray &data);
 
+private slots:
+    void consumeReadBuffer();
+
 private:
     void readData();
 
@@ -55,8 +61,11 @@ private:
     int m_master_fd;
     char m_slave_file_name[PATH_MAX];
     struct winsize *m_winsize;
-    char m_data_buffer[1024];
+    QByteArray m_data_buffer;
+    int m_small_reads;
     QSocketNotifier *m_reader;
+    PtyReaderThread *m_reader_thread;
+    RingBuffer *m_read_buffer;
 };
 
 #endif //YAT_PTY_H
@@ -20,6 +20,8 @@
 
 #include "terminal_screen.h"
 
+#include "memory_governor.h"
+
 TerminalScreen::TerminalScreen(QQuickItem *parent)
     : QQuickItem(parent)
     , m_screen(new Screen(this))
@@ -65,6 +67,14 @@ void TerminalScreen::inputMethodEvent(QInputMethodEvent *event)
     m_screen->sendKey(commitString, key, 0);
 }
 
+void TerminalScreen::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    // The tab that is shown is the last one to give up memory
+    if (change == ItemVisibleHasChanged && value.boolValue)
+        MemoryGovernor::instance()->touch(m_screen);
+    QQuickItem::itemChange(change, value);
+}
+
 void TerminalScreen::hangupReceived()
 {
     emit aboutToBeDestroyed(this);
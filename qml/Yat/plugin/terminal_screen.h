@@ -51,6 +51,7 @@ signals:
 
 protected:
     void inputMethodEvent(QInputMethodEvent *event);
+    void itemChange(ItemChange change, const ItemChangeData &value);
 
 private:
     Screen *m_screen;
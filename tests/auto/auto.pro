@@ -1,3 +1,12 @@
 TEMPLATE = subdirs
 SUBDIRS = \
-    block
+    block \
+    cell_grid \
+    chunk_codec \
+    frozen_lines \
+    line_index \
+    parser \
+    search \
+    style_table \
+    trigram_index \
+    utf8_decoder
@@ -17,10 +17,23 @@ public:
             block()->replaceAtPos(0, spaces, screen.defaultTextStyle());
         }
         QCOMPARE(block()->style_list().size(), 1);
-        default_style = block()->style_list().at(0);
+        default_style = screen.styleTable()->style(block()->style_list().at(0).style_id);
         default_text_style = default_style.style;
     }
 
+    // The tests change the fields of copies of the default style, blocks
+    // only take interned styles
+    TextStyle interned(TextStyle style)
+    {
+        style.id = screen.styleTable()->intern(style);
+        return style;
+    }
+
+    TextStyle::Styles flags(const TextStyleLine &style_line)
+    {
+        return screen.styleTable()->style(style_line.style_id).style;
+    }
+
     Block *block() const
     {
         return *screen.currentScreenData()->it_for_row(0);
@@ -55,6 +68,7 @@ private slots:
     void replaceRemoveOverlappedStyles();
     void replaceSwapStyles();
     void replaceEndBlock();
+    void replaceSequentialStyles();
     void clearBlock();
     void clearToEndOfBlock1Segment();
     void clearToEndOfBlock3Segment();
@@ -68,6 +82,7 @@ private slots:
     void insertCharacters();
     void insertCharacters2Segments();
     void insertCharacters3Segments();
+    void releaseSqueezesLongLines();
 };
 
 void tst_Block::replaceStart()
@@ -81,7 +96,7 @@ void tst_Block::replaceStart()
     QString replace_text("This is a test");
     TextStyle textStyle;
     textStyle.style = TextStyle::Overlined;
-    block->replaceAtPos(0,replace_text, textStyle);
+    block->replaceAtPos(0,replace_text, blockHandler.interned(textStyle));
 
     QVector<TextStyleLine> new_style_list = block->style_list();
     TextStyleLine first_style = new_style_list.at(0);
@@ -99,28 +114,28 @@ void tst_Block::replaceEdgeOfStyle()
     QString first_text("This is the First");
     TextStyle textStyle;
     textStyle.style = TextStyle::Overlined;
-    block->replaceAtPos(0,first_text, textStyle);
+    block->replaceAtPos(0,first_text, blockHandler.interned(textStyle));
 
     QString second_text("This is the Second");
     textStyle.style = TextStyle::Bold;
-    block->replaceAtPos(first_text.size(), second_text, textStyle);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(textStyle));
 
     QVector<TextStyleLine> style_list = block->style_list();
 
     QCOMPARE(style_list.size(), 3);
 
     const TextStyleLine &first_style = style_list.at(0);
-    QCOMPARE(first_style.style, TextStyle::Overlined);
+    QCOMPARE(blockHandler.flags(first_style), TextStyle::Overlined);
     QCOMPARE(first_style.start_index, 0);
     QCOMPARE(first_style.end_index, first_text.size() - 1);
 
     const TextStyleLine &second_style = style_list.at(1);
-    QCOMPARE(second_style.style, TextStyle::Bold);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Bold);
     QCOMPARE(second_style.start_index, first_text.size());
     QCOMPARE(second_style.end_index, first_text.size()+ second_text.size() - 1);
 
     const TextStyleLine &third_style = style_list.at(2);
-    QCOMPARE(third_style.style, TextStyle::Normal);
+    QCOMPARE(blockHandler.flags(third_style), TextStyle::Normal);
     QCOMPARE(third_style.start_index, first_text.size()+ second_text.size());
 }
 
@@ -130,11 +145,11 @@ void tst_Block::replaceCompatibleStyle()
     Block *block = blockHandler.block();
 
     QString replace_text("replaceed Text");
-    block->replaceAtPos(10, replace_text, blockHandler.default_style);
+    block->replaceAtPos(10, replace_text, blockHandler.interned(blockHandler.default_style));
 
     QVector<TextStyleLine> after_style_list = block->style_list();
     QCOMPARE(after_style_list.size(), 1);
-    QCOMPARE(after_style_list.at(0).style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(after_style_list.at(0)), blockHandler.default_text_style);
 }
 
 void tst_Block::replaceCompatiblePreviousStyle()
@@ -145,15 +160,15 @@ void tst_Block::replaceCompatiblePreviousStyle()
     TextStyle first_style = blockHandler.default_style;
     first_style.style = TextStyle::Blinking;
     QString first_text("first");
-    block->replaceAtPos(0,first_text, first_style);
+    block->replaceAtPos(0,first_text, blockHandler.interned(first_style));
 
     TextStyle second_style = blockHandler.default_style;
     second_style.style = TextStyle::Bold;
     QString second_text("this is the second text");
-    block->replaceAtPos(first_text.size(), second_text, second_style);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(second_style));
 
     QString third_text("third");
-    block->replaceAtPos(first_text.size(), third_text,first_style);
+    block->replaceAtPos(first_text.size(), third_text,blockHandler.interned(first_style));
 
     blockHandler.doneChanges();
 
@@ -180,15 +195,15 @@ void tst_Block::replaceCompatiblePreviousStyleShouldRemove()
     TextStyle first_style = blockHandler.default_style;
     first_style.style = TextStyle::Blinking;
     QString first_text("first");
-    block->replaceAtPos(0,first_text, first_style);
+    block->replaceAtPos(0,first_text, blockHandler.interned(first_style));
 
     TextStyle second_style = blockHandler.default_style;
     second_style.style = TextStyle::Bold;
     QString second_text("second");
-    block->replaceAtPos(first_text.size(), second_text, second_style);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(second_style));
 
     QString third_text("this is the third");
-    block->replaceAtPos(first_text.size(), third_text,first_style);
+    block->replaceAtPos(first_text.size(), third_text,blockHandler.interned(first_style));
 
     blockHandler.doneChanges();
 
@@ -212,15 +227,15 @@ void tst_Block::replaceCompatibleCurrentStyleShouldRemove()
     TextStyle first_style = blockHandler.default_style;
     first_style.style = TextStyle::Blinking;
     QString first_text("first");
-    block->replaceAtPos(0,first_text, first_style);
+    block->replaceAtPos(0,first_text, blockHandler.interned(first_style));
 
     TextStyle second_style = blockHandler.default_style;
     second_style.style = TextStyle::Bold;
     QString second_text("second");
-    block->replaceAtPos(first_text.size(), second_text, second_style);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(second_style));
 
     QString third_text("second");
-    block->replaceAtPos(first_text.size(), third_text,first_style);
+    block->replaceAtPos(first_text.size(), third_text,blockHandler.interned(first_style));
 
     blockHandler.doneChanges();
 
@@ -245,7 +260,7 @@ void tst_Block::replaceIncompatibleStyle()
     QString replace_text("replaceed Text");
     TextStyle replace_style;
     replace_style.style = TextStyle::Blinking;
-    block->replaceAtPos(10, replace_text, replace_style);
+    block->replaceAtPos(10, replace_text, blockHandler.interned(replace_style));
 
     QVector<TextStyleLine> after_style_list = block->style_list();
     QCOMPARE(after_style_list.size(), 3);
@@ -253,16 +268,16 @@ void tst_Block::replaceIncompatibleStyle()
     const TextStyleLine &first_style = after_style_list.at(0);
     QCOMPARE(first_style.start_index, 0);
     QCOMPARE(first_style.end_index, 9);
-    QCOMPARE(first_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(first_style), blockHandler.default_text_style);
 
     const TextStyleLine &second_style = after_style_list.at(1);
     QCOMPARE(second_style.start_index, 10);
     QCOMPARE(second_style.end_index, 10 + replace_text.size() -1);
-    QCOMPARE(second_style.style, TextStyle::Blinking);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Blinking);
 
     const TextStyleLine &third_style = after_style_list.at(2);
     QCOMPARE(third_style.start_index, 10 + replace_text.size());
-    QCOMPARE(third_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(third_style), blockHandler.default_text_style);
 }
 
 void tst_Block::replaceIncompaitibleStylesCrossesBoundary()
@@ -273,12 +288,12 @@ void tst_Block::replaceIncompaitibleStylesCrossesBoundary()
     QString replace_text("replaceed Text");
     TextStyle replace_style;
     replace_style.style = TextStyle::Blinking;
-    block->replaceAtPos(0, replace_text, replace_style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(replace_style));
 
     QString crosses_boundary("New incompatible text");
     replace_style.style = TextStyle::Framed;
     int replace_pos = replace_text.size()/2;
-    block->replaceAtPos(replace_pos, crosses_boundary, replace_style);
+    block->replaceAtPos(replace_pos, crosses_boundary, blockHandler.interned(replace_style));
 
     QVector<TextStyleLine> after_style_list = block->style_list();
     QCOMPARE(after_style_list.size(), 3);
@@ -286,16 +301,16 @@ void tst_Block::replaceIncompaitibleStylesCrossesBoundary()
     const TextStyleLine &first_style = after_style_list.at(0);
     QCOMPARE(first_style.start_index, 0);
     QCOMPARE(first_style.end_index, replace_pos -1);
-    QCOMPARE(first_style.style, TextStyle::Blinking);
+    QCOMPARE(blockHandler.flags(first_style), TextStyle::Blinking);
 
     const TextStyleLine &second_style = after_style_list.at(1);
     QCOMPARE(second_style.start_index, replace_pos);
     QCOMPARE(second_style.end_index, replace_pos + crosses_boundary.size() -1);
-    QCOMPARE(second_style.style, TextStyle::Framed);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Framed);
 
     const TextStyleLine &third_style = after_style_list.at(2);
     QCOMPARE(third_style.start_index, replace_pos + crosses_boundary.size());
-    QCOMPARE(third_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(third_style), blockHandler.default_text_style);
 }
 
 void tst_Block::replace3IncompatibleStyles()
@@ -306,15 +321,15 @@ void tst_Block::replace3IncompatibleStyles()
     QString first_text("First Text");
     TextStyle replace_style;
     replace_style.style = TextStyle::Blinking;
-    block->replaceAtPos(0, first_text, replace_style);
+    block->replaceAtPos(0, first_text, blockHandler.interned(replace_style));
 
     QString second_text("Second Text");
     replace_style.style = TextStyle::Italic;
-    block->replaceAtPos(first_text.size(), second_text, replace_style);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(replace_style));
 
     QString third_text("Third Text");
     replace_style.style = TextStyle::Encircled;
-    block->replaceAtPos(first_text.size() + second_text.size(), third_text, replace_style);
+    block->replaceAtPos(first_text.size() + second_text.size(), third_text, blockHandler.interned(replace_style));
 
     QCOMPARE(block->style_list().size(), 4);
 
@@ -327,12 +342,12 @@ void tst_Block::replace3IncompatibleStyles()
     const TextStyleLine &second_style = after_style_list.at(1);
     QCOMPARE(second_style.start_index, first_text.size());
     QCOMPARE(second_style.end_index, first_text.size() + second_text.size() - 1);
-    QCOMPARE(second_style.style, TextStyle::Italic);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Italic);
 
     const TextStyleLine &third_style = after_style_list.at(2);
     QCOMPARE(third_style.start_index, first_text.size() + second_text.size());
     QCOMPARE(third_style.end_index, first_text.size() + second_text.size() + third_text.size() - 1);
-    QCOMPARE(third_style.style, TextStyle::Encircled);
+    QCOMPARE(blockHandler.flags(third_style), TextStyle::Encircled);
 
     const TextStyleLine &fourth_style = after_style_list.at(3);
     QCOMPARE(fourth_style.start_index, first_text.size() + second_text.size() + third_text.size());
@@ -345,15 +360,15 @@ void tst_Block::replaceIncomaptibleStylesCrosses2Boundaries()
     QString first_text("First Text");
     TextStyle replace_style;
     replace_style.style = TextStyle::Blinking;
-    block->replaceAtPos(0, first_text, replace_style);
+    block->replaceAtPos(0, first_text, blockHandler.interned(replace_style));
 
     QString second_text("Second Text");
     replace_style.style = TextStyle::Italic;
-    block->replaceAtPos(first_text.size(), second_text, replace_style);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(replace_style));
 
     QString third_text("Third Text");
     replace_style.style = TextStyle::Encircled;
-    block->replaceAtPos(first_text.size() + second_text.size(), third_text, replace_style);
+    block->replaceAtPos(first_text.size() + second_text.size(), third_text, blockHandler.interned(replace_style));
 
     QCOMPARE(block->style_list().size(), 4);
 
@@ -362,7 +377,7 @@ void tst_Block::replaceIncomaptibleStylesCrosses2Boundaries()
     QString overlap_first_third;
     overlap_first_third.fill(QChar('A'), second_text.size() + 4);
     replace_style.style = TextStyle::DoubleUnderlined;
-    block->replaceAtPos(first_text.size() -2, overlap_first_third, replace_style);
+    block->replaceAtPos(first_text.size() -2, overlap_first_third, blockHandler.interned(replace_style));
 
     QVector<TextStyleLine> after_style_list = block->style_list();
     QCOMPARE(block->style_list().size(), 4);
@@ -370,20 +385,20 @@ void tst_Block::replaceIncomaptibleStylesCrosses2Boundaries()
     const TextStyleLine &first_style = after_style_list.at(0);
     QCOMPARE(first_style.start_index, 0);
     QCOMPARE(first_style.end_index, first_text.size() - 3);
-    QCOMPARE(first_style.style, TextStyle::Blinking);
+    QCOMPARE(blockHandler.flags(first_style), TextStyle::Blinking);
 
     const TextStyleLine &second_style = after_style_list.at(1);
-    QCOMPARE(second_style.style, TextStyle::DoubleUnderlined);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::DoubleUnderlined);
     QCOMPARE(second_style.start_index, first_text.size() - 2);
     QCOMPARE(second_style.end_index, first_text.size() - 2 + overlap_first_third.size() -1);
 
     const TextStyleLine &third_style = after_style_list.at(2);
-    QCOMPARE(third_style.style, TextStyle::Encircled);
+    QCOMPARE(blockHandler.flags(third_style), TextStyle::Encircled);
     QCOMPARE(third_style.start_index, first_text.size() - 2 + overlap_first_third.size());
     QCOMPARE(third_style.end_index, first_text.size() - 2 + overlap_first_third.size() + third_text.size() - 1 - 2);
 
     const TextStyleLine &fourth_style = after_style_list.at(3);
-    QCOMPARE(fourth_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(fourth_style), blockHandler.default_text_style);
     QCOMPARE(fourth_style.start_index, first_text.size() - 2 + overlap_first_third.size() + third_text.size() - 2);
 }
 
@@ -396,19 +411,19 @@ void tst_Block::replaceIncompatibleColor()
     QString first_text("291 ");
     TextStyleLine replace_style;
     replace_style.foreground = ColorPalette::Yellow;
-    block->replaceAtPos(0,first_text, replace_style);
+    block->replaceAtPos(0,first_text, blockHandler.interned(replace_style));
 
     QString second_text("QPointF Screen::selectionAreaStart() ");
     replace_style.foreground = blockHandler.default_style.foreground;
-    block->replaceAtPos(first_text.size(), second_text, replace_style);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(replace_style));
 
     QString third_text("const");
     replace_style.foreground = ColorPalette::Green;
-    block->replaceAtPos(first_text.size() + second_text.size(), third_text, replace_style);
+    block->replaceAtPos(first_text.size() + second_text.size(), third_text, blockHandler.interned(replace_style));
 
     QString brackets("()");
     replace_style.foreground = ColorPalette::Cyan;
-    block->replaceAtPos(38, brackets, replace_style);
+    block->replaceAtPos(38, brackets, blockHandler.interned(replace_style));
 
     QVector<TextStyleLine> after_style_list = block->style_list();
 
@@ -443,20 +458,20 @@ void tst_Block::replaceRemoveOverlappedStyles()
     QString first_text("First Text");
     TextStyle replace_style;
     replace_style.style = TextStyle::Blinking;
-    block->replaceAtPos(0, first_text, replace_style);
+    block->replaceAtPos(0, first_text, blockHandler.interned(replace_style));
 
     QString second_text("Second Text");
     replace_style.style = TextStyle::Italic;
-    block->replaceAtPos(first_text.size(), second_text, replace_style);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(replace_style));
 
     QString third_text("Third Text");
     replace_style.style = TextStyle::Encircled;
-    block->replaceAtPos(first_text.size() + second_text.size(), third_text, replace_style);
+    block->replaceAtPos(first_text.size() + second_text.size(), third_text, blockHandler.interned(replace_style));
 
     QString fourth_text = third_text + second_text;
     fourth_text.chop(1);
     replace_style.style = TextStyle::Bold;
-    block->replaceAtPos(first_text.size(), fourth_text, replace_style);
+    block->replaceAtPos(first_text.size(), fourth_text, blockHandler.interned(replace_style));
 
     QCOMPARE(block->style_list().size(), 4);
 }
@@ -468,19 +483,19 @@ void tst_Block::replaceSwapStyles()
     QString first_text("First Text");
     TextStyle replace_style;
     replace_style.style = TextStyle::Blinking;
-    block->replaceAtPos(0, first_text, replace_style);
+    block->replaceAtPos(0, first_text, blockHandler.interned(replace_style));
 
     QString second_text("Second Text");
     replace_style.style = TextStyle::Italic;
-    block->replaceAtPos(first_text.size(), second_text, replace_style);
+    block->replaceAtPos(first_text.size(), second_text, blockHandler.interned(replace_style));
 
     QString third_text("Third Text");
     replace_style.style = TextStyle::Encircled;
-    block->replaceAtPos(first_text.size() + second_text.size(), third_text, replace_style);
+    block->replaceAtPos(first_text.size() + second_text.size(), third_text, blockHandler.interned(replace_style));
 
     QString replace_second("Dnoces Text");
     replace_style.style = TextStyle::Bold;
-    block->replaceAtPos(first_text.size(), replace_second, replace_style);
+    block->replaceAtPos(first_text.size(), replace_second, blockHandler.interned(replace_style));
 
     QCOMPARE(block->style_list().size(), 4);
 }
@@ -495,7 +510,7 @@ void tst_Block::replaceEndBlock()
     QString replace_text("at the end of the string");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Bold;
-    block->replaceAtPos(block_size - replace_text.size(), replace_text, style);
+    block->replaceAtPos(block_size - replace_text.size(), replace_text, blockHandler.interned(style));
 
     QCOMPARE(block->textLine().size(), block_size);
 
@@ -505,12 +520,38 @@ void tst_Block::replaceEndBlock()
     const TextStyleLine &first_style = style_list.at(0);
     QCOMPARE(first_style.start_index, 0);
     QCOMPARE(first_style.end_index, block_size - replace_text.size() -1);
-    QCOMPARE(first_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(first_style), blockHandler.default_text_style);
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, block_size - replace_text.size());
     QCOMPARE(second_style.end_index, block_size - 1);
-    QCOMPARE(second_style.style, TextStyle::Bold);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Bold);
+}
+
+void tst_Block::replaceSequentialStyles()
+{
+    BlockHandler blockHandler(true);
+    Block *block = blockHandler.block();
+
+    int block_size = block->textLine().size();
+
+    QString replace_text("ab");
+    TextStyle style = blockHandler.default_style;
+    for (int i = 0; i + replace_text.size() <= block_size; i += replace_text.size()) {
+        style.style = (i / replace_text.size()) % 2 ? TextStyle::Italic : TextStyle::Bold;
+        block->replaceAtPos(i, replace_text, blockHandler.interned(style));
+    }
+
+    QCOMPARE(block->textLine().size(), block_size);
+
+    QVector<TextStyleLine> style_list = block->style_list();
+    QCOMPARE(style_list.size(), block_size / replace_text.size());
+    for (int i = 0; i < style_list.size(); i++) {
+        const TextStyleLine &current_style = style_list.at(i);
+        QCOMPARE(current_style.start_index, i * replace_text.size());
+        QCOMPARE(current_style.end_index, i * replace_text.size() + replace_text.size() - 1);
+        QCOMPARE(blockHandler.flags(current_style), i % 2 ? TextStyle::Italic : TextStyle::Bold);
+    }
 }
 
 void tst_Block::clearBlock()
@@ -530,7 +571,7 @@ void tst_Block::clearToEndOfBlock1Segment()
     QString replace_text("To be replaceed");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(0, replace_text, style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(style));
 
     int before_clear_size = block->textLine().size();
 
@@ -562,11 +603,11 @@ void tst_Block::clearToEndOfBlock3Segment()
     QString replace_text("To be");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(0, replace_text, style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(style));
 
     QString replace_text2(" or not to be");
     style.style = TextStyle::Bold;
-    block ->replaceAtPos(replace_text.size(), replace_text2, style);
+    block ->replaceAtPos(replace_text.size(), replace_text2, blockHandler.interned(style));
 
     block->clearCharacters(replace_text.size(), blockHandler.screen.width() - 1);
 
@@ -581,7 +622,7 @@ void tst_Block::clearToEndOfBlock3Segment()
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, replace_text.size());
-    QCOMPARE(second_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(second_style), blockHandler.default_text_style);
 }
 
 void tst_Block::clearToEndOfBlockMiddle3Segment()
@@ -592,11 +633,11 @@ void tst_Block::clearToEndOfBlockMiddle3Segment()
     QString replace_text("To be");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(0, replace_text, style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(style));
 
     QString replace_text2(" or not to be");
     style.style = TextStyle::Bold;
-    block ->replaceAtPos(replace_text.size(), replace_text2, style);
+    block ->replaceAtPos(replace_text.size(), replace_text2, blockHandler.interned(style));
 
     block->clearCharacters(replace_text.size() + 3, blockHandler.screen.width() - 1);
 
@@ -615,7 +656,7 @@ void tst_Block::clearToEndOfBlockMiddle3Segment()
 
     const TextStyleLine &third_style = style_list.at(2);
     QCOMPARE(third_style.start_index, replace_text.size() + 3);
-    QCOMPARE(third_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(third_style), blockHandler.default_text_style);
 }
 
 void tst_Block::deleteCharacters1Segment()
@@ -626,7 +667,7 @@ void tst_Block::deleteCharacters1Segment()
     QString replace_text("replaceing some text");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(0, replace_text, style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(style));
 
     QString full_block = block->textLine();
     int block_size = full_block.size();
@@ -644,7 +685,7 @@ void tst_Block::deleteCharacters1Segment()
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, 15);
-    QCOMPARE(second_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(second_style), blockHandler.default_text_style);
 }
 
 void tst_Block::deleteCharacters2Segments()
@@ -655,7 +696,7 @@ void tst_Block::deleteCharacters2Segments()
     QString replace_text("replaceing some text");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(0, replace_text, style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(style));
 
     int block_size = block->textLine().size();
 
@@ -672,7 +713,7 @@ void tst_Block::deleteCharacters2Segments()
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, 15);
-    QCOMPARE(second_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(second_style), blockHandler.default_text_style);
 
 }
 
@@ -684,11 +725,11 @@ void tst_Block::deleteCharacters3Segments()
     QString replace_text("replaceing some text");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(0, replace_text, style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(style));
 
     QString replace_more_text("Some more text");
     style.style = TextStyle::Bold;
-    block->replaceAtPos(replace_text.size(), replace_more_text, style);
+    block->replaceAtPos(replace_text.size(), replace_more_text, blockHandler.interned(style));
 
     int block_size = block->textLine().size();
 
@@ -706,11 +747,11 @@ void tst_Block::deleteCharacters3Segments()
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, 14);
     QCOMPARE(second_style.end_index, 14 + replace_more_text.size() -1);
-    QCOMPARE(second_style.style, TextStyle::Bold);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Bold);
 
     const TextStyleLine &third_style = style_list.at(2);
     QCOMPARE(third_style.start_index, 14 + replace_more_text.size());
-    QCOMPARE(third_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(third_style), blockHandler.default_text_style);
 }
 
 void tst_Block::deleteCharactersRemoveSegmentEnd()
@@ -721,11 +762,11 @@ void tst_Block::deleteCharactersRemoveSegmentEnd()
     QString replace_text("replaceing some text");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(0, replace_text, style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(style));
 
     QString replace_more_text("Some more text");
     style.style = TextStyle::Bold;
-    block->replaceAtPos(replace_text.size(), replace_more_text, style);
+    block->replaceAtPos(replace_text.size(), replace_more_text, blockHandler.interned(style));
 
     int block_size = block->textLine().size();
 
@@ -742,7 +783,7 @@ void tst_Block::deleteCharactersRemoveSegmentEnd()
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, 16);
-    QCOMPARE(second_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(second_style), blockHandler.default_text_style);
 
 }
 
@@ -754,11 +795,11 @@ void tst_Block::deleteCharactersRemoveSegmentBeginning()
     QString replace_text("replaceing some text");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(0, replace_text, style);
+    block->replaceAtPos(0, replace_text, blockHandler.interned(style));
 
     QString replace_more_text("Some more text");
     style.style = TextStyle::Bold;
-    block->replaceAtPos(replace_text.size(), replace_more_text, style);
+    block->replaceAtPos(replace_text.size(), replace_more_text, blockHandler.interned(style));
 
     int block_size = block->textLine().size();
 
@@ -776,7 +817,7 @@ void tst_Block::deleteCharactersRemoveSegmentBeginning()
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, replace_text.size());
-    QCOMPARE(second_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(second_style), blockHandler.default_text_style);
 }
 
 void tst_Block::deleteCharactersRemoveMiddle()
@@ -788,7 +829,7 @@ void tst_Block::deleteCharactersRemoveMiddle()
     int old_width = blockHandler.screen.width();
     QString empty(old_width - 2, ' ');
     insert_text += empty + 'B';
-    block->replaceAtPos(0, insert_text, blockHandler.default_style);
+    block->replaceAtPos(0, insert_text, blockHandler.interned(blockHandler.default_style));
 
     Q_ASSERT(old_width == blockHandler.screen.width());
     Q_ASSERT(insert_text == block->textLine());
@@ -808,7 +849,7 @@ void tst_Block::insertCharacters()
     QString insert_text("inserting some text");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Encircled;
-    block->insertAtPos(5, insert_text, style);
+    block->insertAtPos(5, insert_text, blockHandler.interned(style));
 
     int expected_size = block_size + insert_text.size();
 
@@ -820,17 +861,17 @@ void tst_Block::insertCharacters()
     const TextStyleLine &first_style = style_list.at(0);
     QCOMPARE(first_style.start_index, 0);
     QCOMPARE(first_style.end_index, 4);
-    QCOMPARE(first_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(first_style), blockHandler.default_text_style);
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, 5);
     QCOMPARE(second_style.end_index, 5 + insert_text.size()  -1);
-    QCOMPARE(second_style.style, TextStyle::Encircled);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Encircled);
 
     const TextStyleLine &third_style = style_list.at(2);
     QCOMPARE(third_style.start_index, 5 + insert_text.size());
     QCOMPARE(third_style.end_index, expected_size - 1);
-    QCOMPARE(third_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(third_style), blockHandler.default_text_style);
 }
 
 void tst_Block::insertCharacters2Segments()
@@ -843,11 +884,11 @@ void tst_Block::insertCharacters2Segments()
     QString replace_text("at the end of the string");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Bold;
-    block->replaceAtPos(block_size - replace_text.size(), replace_text, style);
+    block->replaceAtPos(block_size - replace_text.size(), replace_text, blockHandler.interned(style));
 
     QString insert_text("inserting some text");
     style.style = TextStyle::Encircled;
-    block->insertAtPos(5, insert_text, style);
+    block->insertAtPos(5, insert_text, blockHandler.interned(style));
 
     int expected_size = block_size + insert_text.size();
     QCOMPARE(block->textLine().size(), expected_size);
@@ -858,22 +899,22 @@ void tst_Block::insertCharacters2Segments()
     const TextStyleLine &first_style = style_list.at(0);
     QCOMPARE(first_style.start_index, 0);
     QCOMPARE(first_style.end_index, 4);
-    QCOMPARE(first_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(first_style), blockHandler.default_text_style);
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, 5);
     QCOMPARE(second_style.end_index, 5 + insert_text.size()  -1);
-    QCOMPARE(second_style.style, TextStyle::Encircled);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Encircled);
 
     const TextStyleLine &third_style = style_list.at(2);
     QCOMPARE(third_style.start_index, 5 + insert_text.size());
     QCOMPARE(third_style.end_index, block_size -1 - replace_text.size() + insert_text.size());
-    QCOMPARE(third_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(third_style), blockHandler.default_text_style);
 
     const TextStyleLine &fourth_style = style_list.at(3);
     QCOMPARE(fourth_style.start_index, block_size - replace_text.size() + insert_text.size());
     QCOMPARE(fourth_style.end_index, expected_size - 1 );
-    QCOMPARE(fourth_style.style, TextStyle::Bold);
+    QCOMPARE(blockHandler.flags(fourth_style), TextStyle::Bold);
 }
 
 void tst_Block::insertCharacters3Segments()
@@ -886,18 +927,18 @@ void tst_Block::insertCharacters3Segments()
     QString replace_text("at the end of the string");
     TextStyle style = blockHandler.default_style;
     style.style = TextStyle::Bold;
-    block->replaceAtPos(block_size - replace_text.size(), replace_text, style);
+    block->replaceAtPos(block_size - replace_text.size(), replace_text, blockHandler.interned(style));
 
     QString replace_text2("somewhere in the string");
     style.style = TextStyle::Encircled;
-    block->replaceAtPos(20,replace_text2, style);
+    block->replaceAtPos(20,replace_text2, blockHandler.interned(style));
 
     QVector<TextStyleLine> tmp_style_list = block->style_list();
     QCOMPARE(tmp_style_list.size(), 4);
 
     QString insert_text("this text is longer than last segment");
     style.style = TextStyle::Italic;
-    block->insertAtPos(10, insert_text, style);
+    block->insertAtPos(10, insert_text, blockHandler.interned(style));
 
     blockHandler.doneChanges();
 
@@ -910,37 +951,57 @@ void tst_Block::insertCharacters3Segments()
     const TextStyleLine &first_style = style_list.at(0);
     QCOMPARE(first_style.start_index, 0);
     QCOMPARE(first_style.end_index, 9);
-    QCOMPARE(first_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(first_style), blockHandler.default_text_style);
 
     const TextStyleLine &second_style = style_list.at(1);
     QCOMPARE(second_style.start_index, 10);
     QCOMPARE(second_style.end_index, 10 + insert_text.size()  -1);
-    QCOMPARE(second_style.style, TextStyle::Italic);
+    QCOMPARE(blockHandler.flags(second_style), TextStyle::Italic);
 
     const TextStyleLine &third_style = style_list.at(2);
     QCOMPARE(third_style.start_index, 10 + insert_text.size());
     QCOMPARE(third_style.end_index, 20 + insert_text.size() - 1);
-    QCOMPARE(third_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(third_style), blockHandler.default_text_style);
 
     const TextStyleLine &fourth_style = style_list.at(3);
     QCOMPARE(fourth_style.start_index, 20 + insert_text.size());
     QCOMPARE(fourth_style.end_index, 20 + insert_text.size() + replace_text2.size() - 1);
-    QCOMPARE(fourth_style.style, TextStyle::Encircled);
+    QCOMPARE(blockHandler.flags(fourth_style), TextStyle::Encircled);
 
     const TextStyleLine &fith_style = style_list.at(4);
     QCOMPARE(fith_style.start_index, 20 + insert_text.size() + replace_text2.size());
     QCOMPARE(fith_style.end_index, 99);
-    QCOMPARE(fith_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(fith_style), blockHandler.default_text_style);
 
     const TextStyleLine &sixth_style = style_list.at(5);
     QCOMPARE(sixth_style.start_index, 100);
     QCOMPARE(sixth_style.end_index, 112);
-    QCOMPARE(sixth_style.style, blockHandler.default_text_style);
+    QCOMPARE(blockHandler.flags(sixth_style), blockHandler.default_text_style);
 
     const TextStyleLine &seventh_style = style_list.at(6);
     QCOMPARE(seventh_style.start_index, 113);
     QCOMPARE(seventh_style.end_index, block->textSize() -1);
-    QCOMPARE(seventh_style.style, TextStyle::Bold);
+    QCOMPARE(blockHandler.flags(seventh_style), TextStyle::Bold);
+}
+
+void tst_Block::releaseSqueezesLongLines()
+{
+    BlockHandler blockHandler(false);
+    BlockPool *pool = blockHandler.screen.blockPool();
+    const int width = blockHandler.block()->width();
+
+    Block *short_block = pool->acquire();
+    short_block->replaceAtPos(0, QString(width, QChar('a')), blockHandler.screen.defaultTextStyle());
+    Block *long_block = pool->acquire();
+    long_block->replaceAtPos(0, QString(width * 10, QChar('a')), blockHandler.screen.defaultTextStyle());
+
+    // Both stay in the free list, only the long one gives back its buffer
+    pool->release(short_block);
+    pool->release(long_block);
+    QCOMPARE(short_block->textSize(), 0);
+    QVERIFY(short_block->textCapacity() >= width);
+    QCOMPARE(long_block->textSize(), 0);
+    QVERIFY(long_block->textCapacity() < width);
 }
 
 #include <tst_block.moc>
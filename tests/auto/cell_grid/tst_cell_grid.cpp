@@ -0,0 +1,173 @@
+#include "../../../backend/cell_grid.h"
+#include <QtTest/QtTest>
+
+#include "../../../backend/block.h"
+#include "../../../backend/screen.h"
+
+// Runs the same operations on a row of the grid and on a plain block, and
+// compares the two once the grid is flushed
+class GridHandler
+{
+public:
+    GridHandler()
+        : grid(&screen)
+    {
+        screen.setHeight(5);
+        screen.setWidth(width);
+        grid.resize(width, 5);
+        grid_block = screen.blockPool()->acquire();
+        block = screen.blockPool()->acquire();
+
+        red = screen.defaultTextStyle();
+        red.foreground = qRgb(0xff, 0, 0);
+        red.id = screen.styleTable()->intern(red);
+        bold = screen.defaultTextStyle();
+        bold.style = TextStyle::Bold;
+        bold.id = screen.styleTable()->intern(bold);
+    }
+
+    ~GridHandler()
+    {
+        screen.blockPool()->release(grid_block);
+        screen.blockPool()->release(block);
+    }
+
+    void setText(const QString &text, const TextStyle &style)
+    {
+        grid_block->replaceAtPos(0, text, style);
+        block->replaceAtPos(0, text, style);
+    }
+
+    void load()
+    {
+        if (!grid.isRowLoaded(0))
+            grid.loadRow(0, grid_block);
+    }
+
+    void replace(int column, const QString &text, const TextStyle &style)
+    {
+        load();
+        QVERIFY(grid.replace(0, column, text, style, true));
+        block->replaceAtPos(column, text, style);
+    }
+
+    void clearCharacters(int from, int to)
+    {
+        load();
+        QVERIFY(grid.clearCharacters(0, from, to));
+        block->clearCharacters(from, to);
+    }
+
+    void clearToEnd(int from)
+    {
+        load();
+        QVERIFY(grid.clearToEnd(0, from));
+        block->clearToEnd(from);
+    }
+
+    void compare()
+    {
+        grid.flush();
+        QCOMPARE(grid_block->textLine(), block->textLine());
+        for (int column = 0; column < block->textSize(); column++)
+            QCOMPARE(styleAt(grid_block, column), styleAt(block, column));
+    }
+
+    // Both blocks use the style table of the screen, so equal styles have
+    // equal ids
+    static int styleAt(Block *block, int column)
+    {
+        const QVector<TextStyleLine> styles = block->style_list();
+        for (const TextStyleLine &style : styles) {
+            if (style.start_index <= column && style.end_index >= column)
+                return style.style_id;
+        }
+        return -1;
+    }
+
+    static const int width = 40;
+    Screen screen;
+    CellGrid grid;
+    Block *grid_block;
+    Block *block;
+    TextStyle red;
+    TextStyle bold;
+};
+
+class tst_CellGrid: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void replaceInside();
+    void replacePastEnd();
+    void clearInside();
+    void clearPastEnd();
+    void clearToEnd();
+    void gapBetweenRuns();
+};
+
+void tst_CellGrid::replaceInside()
+{
+    GridHandler handler;
+    handler.setText(QStringLiteral("hello world"), handler.screen.defaultTextStyle());
+    handler.replace(6, QStringLiteral("there"), handler.bold);
+    handler.replace(0, QStringLiteral("J"), handler.red);
+    handler.compare();
+}
+
+void tst_CellGrid::replacePastEnd()
+{
+    GridHandler handler;
+    handler.setText(QStringLiteral("abc"), handler.red);
+    handler.replace(10, QStringLiteral("def"), handler.bold);
+    handler.compare();
+}
+
+void tst_CellGrid::clearInside()
+{
+    GridHandler handler;
+    handler.setText(QStringLiteral("0123456789"), handler.red);
+    handler.clearCharacters(2, 5);
+    handler.compare();
+}
+
+void tst_CellGrid::clearPastEnd()
+{
+    GridHandler handler;
+    handler.setText(QStringLiteral("short"), handler.red);
+    handler.clearCharacters(10, 20);
+    handler.compare();
+    QCOMPARE(handler.grid_block->textSize(), 5);
+}
+
+void tst_CellGrid::clearToEnd()
+{
+    GridHandler handler;
+    handler.setText(QStringLiteral("prompt$ partial input"), handler.bold);
+    handler.clearToEnd(8);
+    handler.compare();
+}
+
+void tst_CellGrid::gapBetweenRuns()
+{
+    GridHandler handler;
+    // Leaves other characters in the cells of the row first
+    handler.setText(QStringLiteral("XXXXXXXXXXXXXXXX"), handler.red);
+    handler.replace(0, QStringLiteral("Y"), handler.red);
+    handler.compare();
+
+    const QString text = QStringLiteral("left  gap  right");
+    QVector<TextStyleLine> runs;
+    runs.append(TextStyleLine(handler.red, 0, 3));
+    runs.append(TextStyleLine(handler.bold, 11, text.size() - 1));
+    handler.grid_block->setContent(text, runs, true, 0, text.size() - 1);
+    handler.block->setContent(text, runs, true, 0, text.size() - 1);
+
+    handler.replace(text.size(), QStringLiteral("!"), handler.bold);
+    handler.grid.flush();
+    QCOMPARE(handler.grid_block->textLine(), handler.block->textLine());
+}
+
+#include <tst_cell_grid.moc>
+QTEST_MAIN(tst_CellGrid);
@@ -0,0 +1,8 @@
+CONFIG += testcase
+QT += testlib quick
+
+include(../../../backend/backend.pri)
+
+SOURCES += \
+    tst_chunk_codec.cpp \
+
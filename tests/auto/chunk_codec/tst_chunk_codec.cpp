@@ -0,0 +1,79 @@
+#include "../../../backend/chunk_codec.h"
+#include <QtTest/QtTest>
+
+class tst_ChunkCodec: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void repetitiveTextShrinks();
+    void rejectsWrongSize();
+    void rejectsTruncatedData();
+};
+
+void tst_ChunkCodec::roundTrip_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("short") << QByteArray("abc");
+    QTest::newRow("line") << QByteArray("drwxr-xr-x  2 user user  4096 Oct 12 12:00 src\n");
+
+    QByteArray runs;
+    for (int i = 0; i < 1000; i++)
+        runs.append(char('a' + (i / 100)));
+    QTest::newRow("runs") << runs;
+
+    QByteArray long_match(70000, 'x');
+    QTest::newRow("long_match") << long_match;
+
+    QByteArray noise(20000, Qt::Uninitialized);
+    quint32 seed = 1;
+    for (int i = 0; i < noise.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        noise[i] = char(seed >> 16);
+    }
+    QTest::newRow("noise") << noise;
+}
+
+void tst_ChunkCodec::roundTrip()
+{
+    QFETCH(QByteArray, data);
+
+    QByteArray compressed = ChunkCodec::compress(data);
+    QByteArray decompressed = ChunkCodec::decompress(compressed, data.size());
+    QVERIFY(!decompressed.isNull());
+    QCOMPARE(decompressed, data);
+}
+
+void tst_ChunkCodec::repetitiveTextShrinks()
+{
+    QByteArray data;
+    for (int i = 0; i < 1000; i++)
+        data.append(QByteArray("-rw-r--r--  1 user user  1024 Oct 12 12:00 file_") + QByteArray::number(i) + ".txt\n");
+
+    QByteArray compressed = ChunkCodec::compress(data);
+    QVERIFY(compressed.size() < data.size() / 3);
+    QCOMPARE(ChunkCodec::decompress(compressed, data.size()), data);
+}
+
+void tst_ChunkCodec::rejectsWrongSize()
+{
+    QByteArray data(1000, 'y');
+    QByteArray compressed = ChunkCodec::compress(data);
+    QVERIFY(ChunkCodec::decompress(compressed, data.size() + 1).isNull());
+    QVERIFY(ChunkCodec::decompress(compressed, data.size() - 1).isNull());
+}
+
+void tst_ChunkCodec::rejectsTruncatedData()
+{
+    QByteArray data(1000, 'z');
+    QByteArray compressed = ChunkCodec::compress(data);
+    compressed.chop(2);
+    QVERIFY(ChunkCodec::decompress(compressed, data.size()).isNull());
+}
+
+#include <tst_chunk_codec.moc>
+QTEST_MAIN(tst_ChunkCodec);
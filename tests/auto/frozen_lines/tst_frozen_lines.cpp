@@ -0,0 +1,183 @@
+#include "../../../backend/frozen_lines.h"
+#include <QtTest/QtTest>
+
+#include "../../../backend/block.h"
+#include "../../../backend/screen.h"
+
+class tst_FrozenLines: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void styleRuns();
+    void stylesOutliveTheirIds();
+    void popFrontAndBack();
+};
+
+void tst_FrozenLines::roundTrip_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("only_latin");
+
+    QTest::newRow("empty") << QString() << true;
+    QTest::newRow("ascii") << QStringLiteral("drwxr-xr-x  2 user user  4096 Oct 12 12:00 src") << true;
+    QTest::newRow("latin1") << QString::fromUtf8("caf\xc3\xa9 cr\xc3\xa8me br\xc3\xbbl\xc3\xa9""e") << true;
+    QTest::newRow("not_latin") << QString::fromUtf8("\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e text") << false;
+    // The parser marks text mapped through a character set as latin, and
+    // the replacement for a broken utf-8 sequence too. What DEC special
+    // graphics maps "lqqqk" to:
+    QTest::newRow("dec_graphics") << QString::fromUtf8("\xe2\x94\x8c\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\x90") << true;
+    QTest::newRow("replacement") << QString::fromUtf8("bad \xef\xbf\xbd byte") << true;
+}
+
+void tst_FrozenLines::roundTrip()
+{
+    QFETCH(QString, text);
+    QFETCH(bool, only_latin);
+
+    Screen screen;
+    screen.setWidth(80);
+    FrozenLines lines(screen.styleTable());
+
+    Block *block = screen.blockPool()->acquire();
+    block->replaceAtPos(0, text, screen.defaultTextStyle(), only_latin);
+    lines.push_back(block);
+    screen.blockPool()->release(block);
+
+    QCOMPARE(lines.size(), 1);
+    QCOMPARE(lines.textSize(0), text.size());
+    QCOMPARE(lines.textMid(0, 0), text);
+    if (text.size() > 2)
+        QCOMPARE(lines.textMid(0, 1, 2), text.mid(1, 2));
+
+    Block *thawed = screen.blockPool()->acquire();
+    lines.thaw(0, thawed);
+    QCOMPARE(thawed->textLine(), text);
+    screen.blockPool()->release(thawed);
+}
+
+void tst_FrozenLines::styleRuns()
+{
+    Screen screen;
+    screen.setWidth(80);
+    FrozenLines lines(screen.styleTable());
+
+    TextStyle red = screen.defaultTextStyle();
+    red.foreground = qRgb(0xff, 0, 0);
+    red.id = screen.styleTable()->intern(red);
+    TextStyle bold = screen.defaultTextStyle();
+    bold.style = TextStyle::Bold;
+    bold.id = screen.styleTable()->intern(bold);
+
+    Block *block = screen.blockPool()->acquire();
+    block->replaceAtPos(0, QStringLiteral("error: "), red);
+    block->replaceAtPos(7, QStringLiteral("file.cpp"), bold);
+    const QVector<TextStyleLine> styles = block->style_list();
+    lines.push_back(block);
+    screen.blockPool()->release(block);
+
+    Block *thawed = screen.blockPool()->acquire();
+    lines.thaw(0, thawed);
+    const QVector<TextStyleLine> thawed_styles = thawed->style_list();
+    QCOMPARE(thawed_styles.size(), styles.size());
+    for (int i = 0; i < styles.size(); i++) {
+        QCOMPARE(thawed_styles.at(i).start_index, styles.at(i).start_index);
+        QCOMPARE(thawed_styles.at(i).end_index, styles.at(i).end_index);
+        QCOMPARE(thawed_styles.at(i).style_id, styles.at(i).style_id);
+    }
+    screen.blockPool()->release(thawed);
+}
+
+void tst_FrozenLines::stylesOutliveTheirIds()
+{
+    Screen screen;
+    screen.setWidth(80);
+    FrozenLines lines(screen.styleTable());
+    StyleTable *table = screen.styleTable();
+
+    TextStyle first = screen.defaultTextStyle();
+    first.foreground = qRgb(0x12, 0x34, 0x56);
+    first.id = table->intern(first);
+    TextStyle second = screen.defaultTextStyle();
+    second.foreground = qRgb(0x65, 0x43, 0x21);
+    second.style = TextStyle::Underlined;
+    second.id = table->intern(second);
+
+    Block *block = screen.blockPool()->acquire();
+    block->replaceAtPos(0, QStringLiteral("gradient"), first);
+    block->replaceAtPos(4, QStringLiteral("ient"), second);
+    lines.push_back(block);
+    screen.blockPool()->release(block);
+
+    // Nothing on the screen uses the styles, so their ids go to other styles
+    const quint32 generation = table->generation();
+    screen.collectStyles();
+    QVERIFY(table->generation() != generation);
+    TextStyle other = screen.defaultTextStyle();
+    other.background = qRgb(0x33, 0x33, 0x33);
+    const quint16 other_id = table->intern(other);
+    QVERIFY(other_id == first.id || other_id == second.id);
+
+    Block *thawed = screen.blockPool()->acquire();
+    lines.thaw(0, thawed);
+    QCOMPARE(thawed->textLine(), QStringLiteral("gradient"));
+    const QVector<TextStyleLine> styles = thawed->style_list();
+    QCOMPARE(styles.size(), 2);
+    QCOMPARE(styles.at(0).end_index, 3);
+    QCOMPARE(styles.at(1).start_index, 4);
+    const TextStyle &thawed_first = table->style(styles.at(0).style_id);
+    QCOMPARE(thawed_first.foreground, first.foreground);
+    QCOMPARE(thawed_first.style, first.style);
+    const TextStyle &thawed_second = table->style(styles.at(1).style_id);
+    QCOMPARE(thawed_second.foreground, second.foreground);
+    QCOMPARE(thawed_second.style, second.style);
+    screen.blockPool()->release(thawed);
+}
+
+void tst_FrozenLines::popFrontAndBack()
+{
+    Screen screen;
+    screen.setWidth(80);
+    FrozenLines lines(screen.styleTable());
+
+    // Enough lines to fill a few chunks
+    const int count = 5000;
+    for (int i = 0; i < count; i++) {
+        Block *block = screen.blockPool()->acquire();
+        block->replaceAtPos(0, QStringLiteral("line %1 of the scrollback").arg(i), screen.defaultTextStyle());
+        lines.push_back(block);
+        screen.blockPool()->release(block);
+    }
+    QCOMPARE(lines.size(), count);
+
+    for (int i = 0; i < 100; i++)
+        lines.pop_front();
+    for (int i = 0; i < 100; i++)
+        lines.pop_back();
+    QCOMPARE(lines.size(), count - 200);
+    QCOMPARE(lines.textMid(0, 0), QStringLiteral("line 100 of the scrollback"));
+    QCOMPARE(lines.textMid(lines.size() - 1, 0), QStringLiteral("line 4899 of the scrollback"));
+
+    while (!lines.isEmpty())
+        lines.pop_front();
+    QCOMPARE(lines.byteSize(), qint64(0));
+    QCOMPARE(lines.recordSize(), qint64(0));
+
+    // The last records of a chunk go from the back after the first ones
+    // went from the front
+    for (int i = 0; i < 3; i++) {
+        Block *block = screen.blockPool()->acquire();
+        block->replaceAtPos(0, QStringLiteral("line %1").arg(i), screen.defaultTextStyle());
+        lines.push_back(block);
+        screen.blockPool()->release(block);
+    }
+    lines.pop_front();
+    lines.pop_back();
+    lines.pop_back();
+    QCOMPARE(lines.byteSize(), qint64(0));
+}
+
+#include <tst_frozen_lines.moc>
+QTEST_MAIN(tst_FrozenLines);
@@ -0,0 +1,8 @@
+CONFIG += testcase
+QT += testlib quick
+
+include(../../../backend/backend.pri)
+
+SOURCES += \
+    tst_line_index.cpp \
+
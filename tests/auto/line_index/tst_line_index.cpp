@@ -0,0 +1,129 @@
+#include "../../../backend/line_index.h"
+#include <QtTest/QtTest>
+
+class tst_LineIndex: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void lookupAfterPushBack();
+    void popFrontShiftsLines();
+    void setLines();
+    void reset();
+    void growPastCapacity();
+    void outOfRange();
+};
+
+void tst_LineIndex::lookupAfterPushBack()
+{
+    LineIndex index;
+    index.push_back(1);
+    index.push_back(3);
+    index.push_back(2);
+    QCOMPARE(index.totalLines(), qint64(6));
+    QCOMPARE(index.lineForIndex(1), qint64(1));
+    QCOMPARE(index.lineForIndex(2), qint64(4));
+
+    int line_in_block = -1;
+    QCOMPARE(index.indexForLine(0, &line_in_block), 0);
+    QCOMPARE(line_in_block, 0);
+    QCOMPARE(index.indexForLine(3, &line_in_block), 1);
+    QCOMPARE(line_in_block, 2);
+    QCOMPARE(index.indexForLine(5, &line_in_block), 2);
+    QCOMPARE(line_in_block, 1);
+}
+
+void tst_LineIndex::popFrontShiftsLines()
+{
+    LineIndex index;
+    index.push_back(2);
+    index.push_back(1);
+    index.push_back(4);
+    index.pop_front();
+    QCOMPARE(index.size(), 2);
+    QCOMPARE(index.totalLines(), qint64(5));
+    QCOMPARE(index.lineForIndex(1), qint64(1));
+    QCOMPARE(index.indexForLine(0), 0);
+    QCOMPARE(index.indexForLine(1), 1);
+
+    index.pop_back();
+    QCOMPARE(index.size(), 1);
+    QCOMPARE(index.totalLines(), qint64(1));
+}
+
+void tst_LineIndex::setLines()
+{
+    LineIndex index;
+    for (int i = 0; i < 10; i++)
+        index.push_back(1);
+    index.setLines(4, 3);
+    QCOMPARE(index.totalLines(), qint64(12));
+    QCOMPARE(index.indexForLine(6), 4);
+    QCOMPARE(index.indexForLine(7), 5);
+    QCOMPARE(index.lineForIndex(9), qint64(11));
+}
+
+void tst_LineIndex::reset()
+{
+    LineIndex index;
+    for (int i = 0; i < 10; i++)
+        index.push_back(1);
+    index.pop_front();
+
+    QVector<int> lines;
+    for (int i = 0; i < 100; i++)
+        lines.append(i % 4 + 1);
+    index.reset(lines);
+    QCOMPARE(index.size(), 100);
+
+    qint64 line = 0;
+    for (int i = 0; i < index.size(); i++) {
+        QCOMPARE(index.lines(i), lines.at(i));
+        QCOMPARE(index.lineForIndex(i), line);
+        QCOMPARE(index.indexForLine(line), i);
+        line += lines.at(i);
+    }
+    QCOMPARE(index.totalLines(), line);
+
+    // Still grows and shrinks from both ends afterwards
+    index.push_back(7);
+    index.pop_front();
+    QCOMPARE(index.totalLines(), line + 7 - 1);
+    QCOMPARE(index.indexForLine(line + 7 - 2), 99);
+}
+
+void tst_LineIndex::growPastCapacity()
+{
+    LineIndex index;
+    qint64 total = 0;
+    for (int i = 0; i < 1000; i++) {
+        index.push_back(i % 3 + 1);
+        total += i % 3 + 1;
+        if (i % 4 == 0) {
+            total -= index.lines(0);
+            index.pop_front();
+        }
+    }
+    QCOMPARE(index.totalLines(), total);
+
+    qint64 line = 0;
+    for (int i = 0; i < index.size(); i++) {
+        QCOMPARE(index.lineForIndex(i), line);
+        int line_in_block = -1;
+        QCOMPARE(index.indexForLine(line + index.lines(i) - 1, &line_in_block), i);
+        QCOMPARE(line_in_block, index.lines(i) - 1);
+        line += index.lines(i);
+    }
+}
+
+void tst_LineIndex::outOfRange()
+{
+    LineIndex index;
+    QCOMPARE(index.indexForLine(0), 0);
+    index.push_back(2);
+    QCOMPARE(index.indexForLine(2), 1);
+    QCOMPARE(index.indexForLine(-1), 1);
+}
+
+#include <tst_line_index.moc>
+QTEST_MAIN(tst_LineIndex);
@@ -0,0 +1,255 @@
+#include "../../../backend/parser.h"
+#include <QtTest/QtTest>
+
+#include "../../../backend/block.h"
+#include "../../../backend/cursor.h"
+#include "../../../backend/screen.h"
+#include "../../../backend/screen_data.h"
+
+class tst_Parser: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void csiDispatch();
+    void sgrStyles();
+    void oscTitle();
+    void dcsAndStringsAreSwallowed();
+    void invalidCsiIsIgnored();
+    void cancelAbortsSequence();
+    void encodedC1Controls();
+    void splitSequences();
+    void splitEveryByte();
+};
+
+static void setupScreen(Screen *screen)
+{
+    screen->setHeight(5);
+    screen->setWidth(40);
+}
+
+static QString rowText(Screen *screen, int row)
+{
+    Block *block = *screen->currentScreenData()->it_for_row(row);
+    return block->textLine();
+}
+
+static TextStyle styleAt(Screen *screen, int row, int column)
+{
+    Block *block = *screen->currentScreenData()->it_for_row(row);
+    const QVector<TextStyleLine> styles = block->style_list();
+    for (const TextStyleLine &style : styles) {
+        if (style.start_index <= column && style.end_index >= column)
+            return screen->styleTable()->style(style.style_id);
+    }
+    return TextStyle();
+}
+
+static QPoint cursorPosition(Screen *screen)
+{
+    Cursor *cursor = screen->currentCursor();
+    return QPoint(cursor->new_x(), cursor->new_y());
+}
+
+void tst_Parser::csiDispatch()
+{
+    Screen screen;
+    setupScreen(&screen);
+
+    screen.readData("\x1b[3;5H");
+    QCOMPARE(cursorPosition(&screen), QPoint(4, 2));
+
+    screen.readData("\x1b[Habc\x1b[2Dx");
+    QCOMPARE(rowText(&screen, 0), QStringLiteral("axc"));
+    QCOMPARE(cursorPosition(&screen), QPoint(2, 0));
+
+    screen.readData("\x1b[2;1Hhello\x1b[3G\x1b[K");
+    QCOMPARE(rowText(&screen, 1), QStringLiteral("he   "));
+    QCOMPARE(cursorPosition(&screen), QPoint(2, 1));
+
+    // DECSEL is handled as EL
+    screen.readData("\x1b[3;1Habcd\x1b[2D\x1b[?1K");
+    QCOMPARE(rowText(&screen, 2), QStringLiteral("   d"));
+}
+
+void tst_Parser::sgrStyles()
+{
+    Screen screen;
+    setupScreen(&screen);
+    const TextStyle default_style = screen.defaultTextStyle();
+
+    screen.readData("a\x1b[1mb\x1b[4;38;2;1;2;3mc\x1b[0md\x1b[38:2::4:5:6;4:2me");
+    QCOMPARE(rowText(&screen, 0), QStringLiteral("abcde"));
+
+    QCOMPARE(styleAt(&screen, 0, 0).style, TextStyle::Styles(TextStyle::Normal));
+    QCOMPARE(styleAt(&screen, 0, 1).style, TextStyle::Styles(TextStyle::Bold));
+    QCOMPARE(styleAt(&screen, 0, 2).style, TextStyle::Styles(TextStyle::Bold) | TextStyle::Underlined);
+    QCOMPARE(styleAt(&screen, 0, 2).foreground, qRgb(1, 2, 3));
+    QCOMPARE(styleAt(&screen, 0, 3).style, TextStyle::Styles(TextStyle::Normal));
+    QCOMPARE(styleAt(&screen, 0, 3).foreground, default_style.foreground);
+    QCOMPARE(styleAt(&screen, 0, 4).style, TextStyle::Styles(TextStyle::DoubleUnderlined));
+    QCOMPARE(styleAt(&screen, 0, 4).foreground, qRgb(4, 5, 6));
+}
+
+void tst_Parser::oscTitle()
+{
+    Screen screen;
+    setupScreen(&screen);
+
+    screen.readData("\x1b]2;bell terminated\x07");
+    QCOMPARE(screen.title(), QStringLiteral("bell terminated"));
+
+    screen.readData("\x1b]0;string terminator\x1b\\after");
+    QCOMPARE(screen.title(), QStringLiteral("string terminator"));
+    QCOMPARE(rowText(&screen, 0), QStringLiteral("after"));
+
+    // The title is utf-8, and the continuation bytes are not C1 controls
+    screen.readData("\x1b]2;\xc3\xa5\xc2\x9b\x07");
+    QCOMPARE(screen.title(), QString::fromUtf8("\xc3\xa5\xc2\x9b"));
+    QCOMPARE(cursorPosition(&screen), QPoint(5, 0));
+}
+
+void tst_Parser::dcsAndStringsAreSwallowed()
+{
+    Screen screen;
+    setupScreen(&screen);
+
+    // Passthrough
+    screen.readData("\x1bPq#0;2;0;0;0#0~~@@\x1b\\a");
+    // Ignored since the parameters hold a colon
+    screen.readData("\x1bP1:2q junk\x1b\\b");
+    // SOS, PM and APC strings
+    screen.readData("\x1bXsos\x1b\\c\x1b^pm\x1b\\d\x1b_apc\x1b\\e");
+
+    QCOMPARE(rowText(&screen, 0), QStringLiteral("abcde"));
+    QCOMPARE(cursorPosition(&screen), QPoint(5, 0));
+    QCOMPARE(styleAt(&screen, 0, 1).style, TextStyle::Styles(TextStyle::Normal));
+}
+
+void tst_Parser::invalidCsiIsIgnored()
+{
+    Screen screen;
+    setupScreen(&screen);
+
+    // A private marker after a parameter and a parameter after an
+    // intermediate both make the sequence invalid up to its final byte
+    screen.readData("a\x1b[1?2Hb\x1b[ 1Hc");
+    QCOMPARE(rowText(&screen, 0), QStringLiteral("abc"));
+    QCOMPARE(cursorPosition(&screen), QPoint(3, 0));
+
+    // Bytes above 0x7f are dropped inside a sequence
+    screen.readData("\x1b[\xc3\xa5" "1md");
+    QCOMPARE(rowText(&screen, 0), QStringLiteral("abcd"));
+    QCOMPARE(styleAt(&screen, 0, 3).style, TextStyle::Styles(TextStyle::Bold));
+}
+
+void tst_Parser::cancelAbortsSequence()
+{
+    Screen screen;
+    setupScreen(&screen);
+
+    screen.readData("\x1b[1\x18" "a\x1b[5;5\x1a" "b\x1b#\x18" "c");
+    QCOMPARE(rowText(&screen, 0), QStringLiteral("abc"));
+    QCOMPARE(cursorPosition(&screen), QPoint(3, 0));
+    QCOMPARE(styleAt(&screen, 0, 0).style, TextStyle::Styles(TextStyle::Normal));
+
+    // Control characters are executed in the middle of a sequence
+    screen.readData("\x1b[2\r;3Hd");
+    QCOMPARE(cursorPosition(&screen), QPoint(3, 1));
+    QCOMPARE(rowText(&screen, 1), QStringLiteral("  d"));
+}
+
+void tst_Parser::encodedC1Controls()
+{
+    Screen screen;
+    setupScreen(&screen);
+
+    // CSI
+    screen.readData("ab\xc2\x9b" "1mcd");
+    QCOMPARE(rowText(&screen, 0), QStringLiteral("abcd"));
+    QCOMPARE(styleAt(&screen, 0, 1).style, TextStyle::Styles(TextStyle::Normal));
+    QCOMPARE(styleAt(&screen, 0, 2).style, TextStyle::Styles(TextStyle::Bold));
+
+    // NEL
+    screen.readData("\xc2\x85" "ef");
+    QCOMPARE(rowText(&screen, 1), QStringLiteral("ef"));
+    QCOMPARE(cursorPosition(&screen), QPoint(2, 1));
+
+    // OSC
+    screen.readData("\xc2\x9d" "2;c1 title\x07g");
+    QCOMPARE(screen.title(), QStringLiteral("c1 title"));
+    QCOMPARE(rowText(&screen, 1), QStringLiteral("efg"));
+
+    // DCS
+    screen.readData("\xc2\x90" "q~~\x1b\\h");
+    QCOMPARE(rowText(&screen, 1), QStringLiteral("efgh"));
+}
+
+void tst_Parser::splitSequences()
+{
+    Screen screen;
+    setupScreen(&screen);
+
+    screen.readData("\x1b");
+    screen.readData("[2");
+    screen.readData(";4");
+    screen.readData("Hx");
+    QCOMPARE(rowText(&screen, 1), QStringLiteral("   x"));
+
+    screen.readData("\x1b]2;ti");
+    screen.readData("tle\x1b");
+    screen.readData("\\y");
+    QCOMPARE(screen.title(), QStringLiteral("title"));
+
+    // Utf-8 characters and encoded C1 controls split between the lead and
+    // continuation bytes
+    screen.readData("\xc3");
+    screen.readData("\xa5\xc2");
+    screen.readData("\x9b" "1mz");
+    QCOMPARE(rowText(&screen, 1), QString::fromUtf8("   xy\xc3\xa5z"));
+    QCOMPARE(styleAt(&screen, 1, 5).style, TextStyle::Styles(TextStyle::Normal));
+    QCOMPARE(styleAt(&screen, 1, 6).style, TextStyle::Styles(TextStyle::Bold));
+}
+
+void tst_Parser::splitEveryByte()
+{
+    const QByteArray data =
+        "plain\r\n"
+        "\x1b[1;31mred\x1b[0m \xc3\xa5\xe2\x82\xac\r\n"
+        "\x1b]2;the title\x07"
+        "\x1bPq~~\x1b\\\xc2\x9b" "4mline\x1b[m\r\n"
+        "\x1b[5;10Hend\x1b[1D\x1b[K";
+
+    Screen whole;
+    setupScreen(&whole);
+    whole.readData(data);
+
+    Screen split;
+    setupScreen(&split);
+    for (int i = 0; i < data.size(); i++)
+        split.readData(data.mid(i, 1));
+
+    QCOMPARE(split.title(), whole.title());
+    QCOMPARE(whole.title(), QStringLiteral("the title"));
+    QCOMPARE(cursorPosition(&split), cursorPosition(&whole));
+    QCOMPARE(cursorPosition(&whole), QPoint(11, 4));
+    for (int row = 0; row < 5; row++) {
+        const QString text = rowText(&whole, row);
+        QCOMPARE(rowText(&split, row), text);
+        for (int column = 0; column < text.size(); column++) {
+            const TextStyle expected = styleAt(&whole, row, column);
+            const TextStyle actual = styleAt(&split, row, column);
+            QCOMPARE(actual.style, expected.style);
+            QCOMPARE(actual.foreground, expected.foreground);
+            QCOMPARE(actual.background, expected.background);
+        }
+    }
+    QCOMPARE(rowText(&whole, 1), QString::fromUtf8("red \xc3\xa5\xe2\x82\xac"));
+    QCOMPARE(rowText(&whole, 2), QStringLiteral("line"));
+    QCOMPARE(rowText(&whole, 4), QStringLiteral("         en "));
+    QCOMPARE(styleAt(&whole, 1, 0).style, TextStyle::Styles(TextStyle::Bold));
+    QCOMPARE(styleAt(&whole, 2, 0).style, TextStyle::Styles(TextStyle::Underlined));
+}
+
+#include <tst_parser.moc>
+QTEST_MAIN(tst_Parser);
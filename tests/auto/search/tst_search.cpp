@@ -0,0 +1,146 @@
+#include "../../../backend/search.h"
+#include <QtTest/QtTest>
+
+#include "../../../backend/screen.h"
+
+class tst_Search: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void findsScrollbackAndScreen();
+    void positionsFollowTrimming();
+    void findsLinesScrolledInWhileSearching();
+    void screenSwitchEndsSearch();
+};
+
+static void feedLine(Screen *screen, const QString &line)
+{
+    screen->readData(line.toUtf8() + "\r\n");
+}
+
+// Lines i with i % 100 == 42 hold the text looked for, 2 characters in
+static void feedLines(Screen *screen, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (i % 100 == 42)
+            feedLine(screen, QStringLiteral("a needle %1").arg(i));
+        else
+            feedLine(screen, QStringLiteral("line %1").arg(i));
+    }
+}
+
+static QVariantList allResults(const QSignalSpy &spy)
+{
+    QVariantList results;
+    for (int i = 0; i < spy.count(); i++)
+        results += spy.at(i).at(0).toList();
+    return results;
+}
+
+static QPoint resultPosition(const Screen &screen, const QVariant &result)
+{
+    const QVariantMap match = result.toMap();
+    return screen.searchResultPosition(match.value(QStringLiteral("sequence")).toDouble(),
+                                       match.value(QStringLiteral("position")).toInt());
+}
+
+void tst_Search::findsScrollbackAndScreen()
+{
+    Screen screen;
+    screen.setHeight(5);
+    screen.setWidth(40);
+    feedLines(&screen, 1000);
+    feedLine(&screen, QStringLiteral("a needle on the screen"));
+
+    QSignalSpy results(&screen, &Screen::searchResultsFound);
+    QSignalSpy finished(&screen, &Screen::searchFinished);
+    screen.search(QStringLiteral("needle"));
+    QVERIFY(finished.wait());
+
+    const QVariantList found = allResults(results);
+    QCOMPARE(found.size(), 11);
+    for (int i = 0; i < found.size(); i++) {
+        const QVariantMap match = found.at(i).toMap();
+        QCOMPARE(match.value(QStringLiteral("position")).toInt(), 2);
+        QCOMPARE(match.value(QStringLiteral("length")).toInt(), 6);
+        // Every line is a single screen line, one per fed line
+        QCOMPARE(resultPosition(screen, match), QPoint(2, i < 10 ? 42 + i * 100 : 1000));
+    }
+}
+
+void tst_Search::positionsFollowTrimming()
+{
+    Screen screen;
+    screen.setHeight(5);
+    screen.setWidth(40);
+    feedLines(&screen, 1000);
+
+    QSignalSpy results(&screen, &Screen::searchResultsFound);
+    QSignalSpy finished(&screen, &Screen::searchFinished);
+    screen.search(QStringLiteral("needle"));
+    QVERIFY(finished.wait());
+    const QVariantList found = allResults(results);
+    QCOMPARE(found.size(), 10);
+
+    // The results stay valid while the scrollback drops its front, the
+    // lines that are gone say so
+    const int height = screen.contentHeight();
+    screen.setScrollbackLineLimit(500);
+    const int dropped = height - screen.contentHeight();
+    QVERIFY(dropped > 0);
+    for (int i = 0; i < found.size(); i++) {
+        const int line = 42 + i * 100;
+        if (line < dropped)
+            QCOMPARE(resultPosition(screen, found.at(i)), QPoint(-1, -1));
+        else
+            QCOMPARE(resultPosition(screen, found.at(i)), QPoint(2, line - dropped));
+    }
+}
+
+void tst_Search::findsLinesScrolledInWhileSearching()
+{
+    Screen screen;
+    screen.setHeight(5);
+    screen.setWidth(40);
+    feedLines(&screen, 20000);
+
+    QSignalSpy results(&screen, &Screen::searchResultsFound);
+    QSignalSpy finished(&screen, &Screen::searchFinished);
+    screen.search(QStringLiteral("needle"));
+
+    // Each round scrolls more lines with the text than the screen holds
+    // past the range the search started with
+    int added = 0;
+    while (!finished.count()) {
+        for (int i = 0; i < 10; i++)
+            feedLine(&screen, QStringLiteral("another needle %1").arg(added++));
+        QCoreApplication::processEvents();
+    }
+
+    const QVariantList found = allResults(results);
+    QCOMPARE(found.size(), 200 + added);
+    for (const QVariant &result : found)
+        QVERIFY(resultPosition(screen, result).y() >= 0);
+}
+
+void tst_Search::screenSwitchEndsSearch()
+{
+    Screen screen;
+    screen.setHeight(5);
+    screen.setWidth(40);
+    feedLines(&screen, 1000);
+
+    QSignalSpy finished(&screen, &Screen::searchFinished);
+    screen.search(QStringLiteral("needle"));
+    screen.useAlternateScreenBuffer();
+    QCOMPARE(finished.count(), 1);
+
+    QSignalSpy results(&screen, &Screen::searchResultsFound);
+    QTest::qWait(10);
+    QCOMPARE(results.count(), 0);
+    QCOMPARE(finished.count(), 1);
+}
+
+#include <tst_search.moc>
+QTEST_MAIN(tst_Search);
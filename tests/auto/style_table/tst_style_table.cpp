@@ -0,0 +1,126 @@
+#include "../../../backend/style_table.h"
+#include <QtTest/QtTest>
+
+#include "../../../backend/block.h"
+#include "../../../backend/screen.h"
+#include "../../../backend/screen_data.h"
+
+class tst_StyleTable: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void internOncePerStyle();
+    void collectFreesUnusedIds();
+    void fullTableFallsBackToClosest();
+    void screenCollectsWhenFull();
+};
+
+static TextStyle styleWithForeground(QRgb foreground)
+{
+    TextStyle style;
+    style.foreground = foreground;
+    style.background = qRgb(0, 0, 0);
+    return style;
+}
+
+// Interns styles with new foregrounds until every id is taken
+static void fillTable(StyleTable *table)
+{
+    uint color = 0x100000;
+    while (!table->isFull())
+        table->intern(styleWithForeground(qRgb(0, 0, 0) + color++));
+}
+
+void tst_StyleTable::internOncePerStyle()
+{
+    StyleTable table;
+    const TextStyle red = styleWithForeground(qRgb(0xff, 0, 0));
+    TextStyle bold = red;
+    bold.style = TextStyle::Bold;
+
+    const quint16 red_id = table.intern(red);
+    const quint16 bold_id = table.intern(bold);
+    QVERIFY(red_id != bold_id);
+    QCOMPARE(table.intern(red), red_id);
+    QCOMPARE(table.style(red_id).foreground, red.foreground);
+    QCOMPARE(table.style(red_id).id, red_id);
+    QCOMPARE(table.style(bold_id).style, TextStyle::Styles(TextStyle::Bold));
+}
+
+void tst_StyleTable::collectFreesUnusedIds()
+{
+    StyleTable table;
+    const quint16 kept = table.intern(styleWithForeground(qRgb(1, 0, 0)));
+    const quint16 dropped = table.intern(styleWithForeground(qRgb(2, 0, 0)));
+
+    QBitArray live(table.size());
+    live.setBit(kept);
+    const quint32 generation = table.generation();
+    table.collect(live);
+    QVERIFY(table.generation() != generation);
+
+    // The freed id goes to the next new style, the kept one stays
+    QCOMPARE(table.intern(styleWithForeground(qRgb(3, 0, 0))), dropped);
+    QCOMPARE(table.intern(styleWithForeground(qRgb(1, 0, 0))), kept);
+    QCOMPARE(table.size(), 2);
+
+    // Nothing freed, nothing changes
+    live.fill(true);
+    const quint32 unchanged = table.generation();
+    table.collect(live);
+    QCOMPARE(table.generation(), unchanged);
+}
+
+void tst_StyleTable::fullTableFallsBackToClosest()
+{
+    StyleTable table;
+    fillTable(&table);
+    QCOMPARE(table.size(), int(TextStyle::InvalidId));
+
+    TextStyle missing = styleWithForeground(qRgb(0x10, 0x12, 0x34));
+    missing.background = qRgb(0, 0, 1);
+    QCOMPARE(table.intern(missing), quint16(TextStyle::InvalidId));
+
+    const quint16 closest = table.closest(missing);
+    QVERIFY(closest != TextStyle::InvalidId);
+    QCOMPARE(table.style(closest).foreground, missing.foreground);
+
+    // Other flags weigh more than the colors
+    TextStyle bold = table.style(0);
+    bold.style = TextStyle::Bold;
+    bold.foreground = qRgb(0xff, 0xff, 0xff);
+    QCOMPARE(table.intern(bold), quint16(TextStyle::InvalidId));
+    QCOMPARE(table.style(table.closest(bold)).style, TextStyle::Styles(TextStyle::Normal));
+
+    QBitArray live(table.size());
+    table.collect(live);
+    QVERIFY(!table.isFull());
+    QVERIFY(table.intern(bold) != TextStyle::InvalidId);
+}
+
+void tst_StyleTable::screenCollectsWhenFull()
+{
+    Screen screen;
+    screen.setHeight(5);
+    screen.setWidth(40);
+    fillTable(screen.styleTable());
+
+    screen.readData("\x1b[1mbold");
+    QVERIFY(!screen.styleTable()->isFull());
+
+    Block *block = *screen.currentScreenData()->it_for_row(0);
+    QCOMPARE(block->textLine(), QStringLiteral("bold"));
+    const QVector<TextStyleLine> styles = block->style_list();
+    QVERIFY(styles.size() >= 1);
+    const TextStyle &bold = screen.styleTable()->style(styles.at(0).style_id);
+    QCOMPARE(bold.style, TextStyle::Styles(TextStyle::Bold));
+
+    // The default style is still in use, so it kept its id
+    const TextStyle &default_style = screen.defaultTextStyle();
+    QCOMPARE(screen.styleTable()->style(default_style.id).id, default_style.id);
+    QCOMPARE(screen.styleTable()->style(default_style.id).foreground, default_style.foreground);
+}
+
+#include <tst_style_table.moc>
+QTEST_MAIN(tst_StyleTable);
@@ -0,0 +1,101 @@
+#include "../../../backend/trigram_index.h"
+#include <QtTest/QtTest>
+
+class tst_TrigramIndex: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void shortTextIsNotIndexed();
+    void findsBucketsOfLines();
+    void caseInsensitive();
+    void missingTrigram();
+    void frontLinesAreDropped();
+    void linesAddedAgainStaySorted();
+};
+
+static quint32 bucket(quint64 sequence)
+{
+    return quint32(sequence / TrigramIndex::BucketLines);
+}
+
+void tst_TrigramIndex::shortTextIsNotIndexed()
+{
+    TrigramIndex index;
+    index.addLine(0, QStringLiteral("ab"));
+
+    QVector<quint32> buckets;
+    QVERIFY(!index.findBuckets(QStringLiteral("ab"), &buckets));
+    QVERIFY(buckets.isEmpty());
+}
+
+void tst_TrigramIndex::findsBucketsOfLines()
+{
+    TrigramIndex index;
+    for (int i = 0; i < 10 * TrigramIndex::BucketLines; i++)
+        index.addLine(i, QStringLiteral("line number %1").arg(i));
+    index.addLine(3 * TrigramIndex::BucketLines + 5, QStringLiteral("make: *** [all] Error 2"));
+    index.addLine(7 * TrigramIndex::BucketLines, QStringLiteral("ld: Error: undefined reference"));
+
+    QVector<quint32> buckets;
+    QVERIFY(index.findBuckets(QStringLiteral("Error"), &buckets));
+    QCOMPARE(buckets, QVector<quint32>() << 3 << 7);
+
+    QVERIFY(index.findBuckets(QStringLiteral("number 2"), &buckets));
+    QVERIFY(buckets.contains(bucket(2)));
+    QVERIFY(buckets.contains(bucket(200)));
+}
+
+void tst_TrigramIndex::caseInsensitive()
+{
+    TrigramIndex index;
+    index.addLine(0, QStringLiteral("WARNING: disk almost full"));
+
+    QVector<quint32> buckets;
+    QVERIFY(index.findBuckets(QStringLiteral("warning"), &buckets));
+    QCOMPARE(buckets, QVector<quint32>() << 0);
+    QVERIFY(index.findBuckets(QStringLiteral("Almost"), &buckets));
+    QCOMPARE(buckets, QVector<quint32>() << 0);
+}
+
+void tst_TrigramIndex::missingTrigram()
+{
+    TrigramIndex index;
+    index.addLine(0, QStringLiteral("hello world"));
+
+    QVector<quint32> buckets;
+    QVERIFY(index.findBuckets(QStringLiteral("hello there"), &buckets));
+    QVERIFY(buckets.isEmpty());
+}
+
+void tst_TrigramIndex::frontLinesAreDropped()
+{
+    TrigramIndex index;
+    const int lines = 100 * TrigramIndex::BucketLines;
+    for (int i = 0; i < lines; i++)
+        index.addLine(i, i % 2 ? QStringLiteral("odd line") : QStringLiteral("even line"));
+    const qint64 full_size = index.byteSize();
+
+    index.setFrontSequence(lines - TrigramIndex::BucketLines);
+    QVERIFY(index.byteSize() < full_size);
+
+    QVector<quint32> buckets;
+    QVERIFY(index.findBuckets(QStringLiteral("odd"), &buckets));
+    QCOMPARE(buckets, QVector<quint32>() << bucket(lines - 1));
+}
+
+void tst_TrigramIndex::linesAddedAgainStaySorted()
+{
+    TrigramIndex index;
+    index.addLine(0, QStringLiteral("first"));
+    index.addLine(3 * TrigramIndex::BucketLines, QStringLiteral("first again"));
+    // The scrollback gave back lines, so a lower sequence number comes again
+    index.addLine(TrigramIndex::BucketLines, QStringLiteral("first once more"));
+
+    QVector<quint32> buckets;
+    QVERIFY(index.findBuckets(QStringLiteral("first"), &buckets));
+    QCOMPARE(buckets, QVector<quint32>() << 0 << 1 << 3);
+}
+
+#include <tst_trigram_index.moc>
+QTEST_MAIN(tst_TrigramIndex);
@@ -0,0 +1,88 @@
+#include "../../../backend/utf8_decoder.h"
+#include <QtTest/QtTest>
+
+class tst_Utf8Decoder: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void decodeTwoByte();
+    void decodeFourByteAcrossCalls();
+    void decodeC1();
+    void rejectOverlong();
+    void rejectSurrogate();
+    void rejectFiveByte();
+    void recoverAfterTruncatedSequence();
+};
+
+static Utf8Decoder::State feed(Utf8Decoder &decoder, const QByteArray &data)
+{
+    Utf8Decoder::State state = decoder.state();
+    for (int i = 0; i < data.size(); i++)
+        state = decoder.addChar(uchar(data.at(i)));
+    return state;
+}
+
+void tst_Utf8Decoder::decodeTwoByte()
+{
+    Utf8Decoder decoder;
+    QCOMPARE(feed(decoder, QByteArray("\xc3\xa6")), Utf8Decoder::Accept);
+    QCOMPARE(decoder.codePoint(), uint32_t(0xe6));
+    QVERIFY(decoder.isLatin());
+    QVERIFY(!decoder.isC1());
+}
+
+void tst_Utf8Decoder::decodeFourByteAcrossCalls()
+{
+    Utf8Decoder decoder;
+    feed(decoder, QByteArray("\xf0\x9f"));
+    QVERIFY(decoder.isInSequence());
+    QCOMPARE(feed(decoder, QByteArray("\x98\x80")), Utf8Decoder::Accept);
+    QCOMPARE(decoder.codePoint(), uint32_t(0x1f600));
+    QVERIFY(!decoder.isLatin());
+}
+
+void tst_Utf8Decoder::decodeC1()
+{
+    Utf8Decoder decoder;
+    QCOMPARE(feed(decoder, QByteArray("\xc2\x9b")), Utf8Decoder::Accept);
+    QVERIFY(decoder.isC1());
+    QCOMPARE(decoder.codePoint(), uint32_t(0x9b));
+
+    QCOMPARE(feed(decoder, QByteArray("\xc2\xa0")), Utf8Decoder::Accept);
+    QVERIFY(!decoder.isC1());
+}
+
+void tst_Utf8Decoder::rejectOverlong()
+{
+    Utf8Decoder decoder;
+    QCOMPARE(feed(decoder, QByteArray("\xc0\xaf")), Utf8Decoder::Reject);
+
+    decoder.clear();
+    QCOMPARE(feed(decoder, QByteArray("\xe0\x80\xaf")), Utf8Decoder::Reject);
+}
+
+void tst_Utf8Decoder::rejectSurrogate()
+{
+    Utf8Decoder decoder;
+    QCOMPARE(feed(decoder, QByteArray("\xed\xa0\x80")), Utf8Decoder::Reject);
+}
+
+void tst_Utf8Decoder::rejectFiveByte()
+{
+    Utf8Decoder decoder;
+    QCOMPARE(decoder.addChar(0xf8), Utf8Decoder::Reject);
+    QCOMPARE(decoder.addChar(0xfc), Utf8Decoder::Reject);
+}
+
+void tst_Utf8Decoder::recoverAfterTruncatedSequence()
+{
+    Utf8Decoder decoder;
+    decoder.addChar(0xe2);
+    QVERIFY(decoder.isInSequence());
+    QCOMPARE(feed(decoder, QByteArray("\xc3\xb8")), Utf8Decoder::Accept);
+    QCOMPARE(decoder.codePoint(), uint32_t(0xf8));
+}
+
+#include <tst_utf8_decoder.moc>
+QTEST_MAIN(tst_Utf8Decoder);
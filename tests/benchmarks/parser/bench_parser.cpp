@@ -0,0 +1,226 @@
+#include "../../../backend/screen.h"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTextStream>
+#include <QtGui/QGuiApplication>
+
+#include <cstring>
+#include <functional>
+#include <limits>
+
+static const int chunk_size = 4096;
+
+struct Corpus
+{
+    const char *name;
+    std::function<QByteArray(int size)> generate;
+};
+
+static const char *words[] = {
+    "terminal", "parser", "screen", "block", "cursor", "scrollback", "style",
+    "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "0x1f",
+    "src/main.cpp:42:", "warning:", "unused", "variable", "[-Wunused]"
+};
+static const int word_count = sizeof(words) / sizeof *words;
+
+static QByteArray asciiCorpus(int size)
+{
+    QByteArray data;
+    data.reserve(size + 128);
+    int word = 0;
+    int column = 0;
+    while (data.size() < size) {
+        const char *w = words[word++ % word_count];
+        data.append(w);
+        data.append(' ');
+        column += int(strlen(w)) + 1;
+        if (column > 70) {
+            data.append("\r\n");
+            column = 0;
+        }
+    }
+    return data;
+}
+
+static QByteArray sgrCorpus(int size)
+{
+    QByteArray data;
+    data.reserve(size + 128);
+    int word = 0;
+    int column = 0;
+    while (data.size() < size) {
+        switch (word % 4) {
+        case 0:
+            data.append("\x1b[38;5;" + QByteArray::number(word % 256) + "m");
+            break;
+        case 1:
+            data.append("\x1b[1;3" + QByteArray::number(word % 8) + "m");
+            break;
+        case 2:
+            data.append("\x1b[48;2;" + QByteArray::number(word % 256) + ";64;" + QByteArray::number(255 - word % 256) + "m");
+            break;
+        default:
+            data.append("\x1b[4m");
+            break;
+        }
+        const char *w = words[word++ % word_count];
+        data.append(w);
+        data.append("\x1b[0m ");
+        column += int(strlen(w)) + 1;
+        if (column > 70) {
+            data.append("\r\n");
+            column = 0;
+        }
+    }
+    return data;
+}
+
+static QByteArray cjkCorpus(int size)
+{
+    QByteArray data;
+    data.reserve(size + 128);
+    uint code_point = 0x4e00;
+    int column = 0;
+    while (data.size() < size) {
+        data.append(char(0xe0 | (code_point >> 12)));
+        data.append(char(0x80 | ((code_point >> 6) & 0x3f)));
+        data.append(char(0x80 | (code_point & 0x3f)));
+        code_point = code_point == 0x9fff ? 0x4e00 : code_point + 1;
+        if (++column == 38) {
+            data.append("\r\n");
+            column = 0;
+        }
+    }
+    return data;
+}
+
+static QByteArray tuiCorpus(int size)
+{
+    QByteArray data;
+    data.reserve(size + 1024);
+    int frame = 0;
+    while (data.size() < size) {
+        data.append("\x1b[?25l\x1b[1;1H\x1b[7m");
+        data.append(QByteArray(" frame ").append(QByteArray::number(frame)).leftJustified(80, ' '));
+        data.append("\x1b[0m");
+        for (int row = 2; row < 24; row++) {
+            data.append("\x1b[" + QByteArray::number(row) + ";1H\x1b[2K");
+            data.append("\x1b[3" + QByteArray::number((row + frame) % 8) + "m");
+            data.append(QByteArray::number(row * frame).rightJustified(6, ' '));
+            data.append("\x1b[0m ");
+            data.append(words[(row + frame) % word_count]);
+            data.append("\x1b[" + QByteArray::number(row) + ";60H");
+            data.append(QByteArray::number((row * 37 + frame) % 1000).rightJustified(5, ' '));
+        }
+        data.append("\x1b[24;1H\x1b[?25h");
+        frame++;
+    }
+    return data;
+}
+
+static QByteArray scrollRegionCorpus(int size)
+{
+    QByteArray data;
+    data.reserve(size + 128);
+    data.append("\x1b[2J\x1b[3;20r\x1b[20;1H");
+    int line = 0;
+    while (data.size() < size) {
+        data.append(QByteArray::number(line++));
+        data.append(' ');
+        data.append(words[line % word_count]);
+        data.append("\r\n");
+        if (line % 10 == 0)
+            data.append("\x1b[3;1H\x1bM\x1b[20;1H");
+    }
+    data.append("\x1b[r");
+    return data;
+}
+
+static QByteArray wrappedCorpus(int size)
+{
+    QByteArray data;
+    data.reserve(size + 128);
+    int word = 0;
+    int line_length = 0;
+    while (data.size() < size) {
+        const char *w = words[word++ % word_count];
+        data.append(w);
+        data.append(' ');
+        line_length += int(strlen(w)) + 1;
+        if (line_length > 2000) {
+            data.append("\r\n");
+            line_length = 0;
+        }
+    }
+    return data;
+}
+
+static qint64 run(const QByteArray &data, bool parse_only)
+{
+    Screen screen;
+    screen.setWidth(80);
+    screen.setHeight(24);
+    screen.dispatchChanges();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int pos = 0; pos < data.size(); pos += chunk_size) {
+        screen.readData(QByteArray::fromRawData(data.constData() + pos, qMin(chunk_size, data.size() - pos)));
+        if (!parse_only)
+            screen.dispatchChanges();
+    }
+    return timer.nsecsElapsed();
+}
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser command_line;
+    command_line.setApplicationDescription("Measures the throughput of Parser::addData and Screen");
+    command_line.addHelpOption();
+    QCommandLineOption parse_only_option("parse-only", "Do not call Screen::dispatchChanges between reads");
+    QCommandLineOption size_option("size", "Size of each corpus in MiB", "size", "8");
+    QCommandLineOption iterations_option("iterations", "Number of runs per corpus, the fastest is reported", "iterations", "3");
+    QCommandLineOption corpus_option("corpus", "Only run the named corpus", "name");
+    command_line.addOption(parse_only_option);
+    command_line.addOption(size_option);
+    command_line.addOption(iterations_option);
+    command_line.addOption(corpus_option);
+    command_line.process(app);
+
+    const bool parse_only = command_line.isSet(parse_only_option);
+    const int size = command_line.value(size_option).toInt() * 1024 * 1024;
+    const int iterations = qMax(1, command_line.value(iterations_option).toInt());
+
+    const Corpus corpora[] = {
+        { "ascii", asciiCorpus },
+        { "sgr", sgrCorpus },
+        { "utf8-cjk", cjkCorpus },
+        { "tui-redraw", tuiCorpus },
+        { "scroll-region", scrollRegionCorpus },
+        { "wrapped-lines", wrappedCorpus }
+    };
+
+    QTextStream out(stdout);
+    out << qSetFieldWidth(16) << Qt::left << "corpus" << qSetFieldWidth(12) << Qt::right << "MB/s" << "ns/byte" << qSetFieldWidth(0) << Qt::endl;
+    for (const Corpus &corpus : corpora) {
+        if (command_line.isSet(corpus_option) && command_line.value(corpus_option) != QLatin1String(corpus.name))
+            continue;
+        const QByteArray data = corpus.generate(size);
+        qint64 best = std::numeric_limits<qint64>::max();
+        for (int i = 0; i < iterations; i++)
+            best = qMin(best, run(data, parse_only));
+
+        const double seconds = best / 1e9;
+        out << qSetFieldWidth(16) << Qt::left << corpus.name
+            << qSetFieldWidth(12) << Qt::right << qSetRealNumberPrecision(4)
+            << data.size() / seconds / (1024 * 1024)
+            << double(best) / data.size()
+            << qSetFieldWidth(0) << Qt::endl;
+    }
+    return 0;
+}
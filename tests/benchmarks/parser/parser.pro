@@ -0,0 +1,11 @@
+QT += quick
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = bench_parser
+
+include(../../../backend/backend.pri)
+
+SOURCES += \
+    bench_parser.cpp \
+